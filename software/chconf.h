@@ -383,8 +383,13 @@
  *          runtime measurement of the used stack.
  *
  * @note    The default is @p FALSE.
+ * @note    Enabled for the stack watermarks of the thread statistics.
  */
+#if defined(THREAD_STATS) && THREAD_STATS
+#define CH_DBG_FILL_THREADS                 TRUE
+#else
 #define CH_DBG_FILL_THREADS                 FALSE
+#endif
 
 /**
  * @brief   Debug option, threads profiling.
@@ -406,12 +411,39 @@
  */
 /*===========================================================================*/
 
+/*
+ * Per thread CPU time of source/ThreadStats.h, only with USE_THREAD_STATS.
+ */
+#if defined(THREAD_STATS) && THREAD_STATS && !defined(_FROM_ASM_)
+struct ch_thread;
+void ThreadStats_SwitchHook(struct ch_thread *ntp, struct ch_thread *otp);
+#define THREAD_STATS_EXTRA_FIELDS           uint32_t statsCycles;
+#define THREAD_STATS_INIT_HOOK(tp)          ((tp)->statsCycles = 0)
+#define THREAD_STATS_SWITCH_HOOK(ntp, otp)  ThreadStats_SwitchHook(ntp, otp)
+#else
+#define THREAD_STATS_EXTRA_FIELDS
+#define THREAD_STATS_INIT_HOOK(tp)
+#define THREAD_STATS_SWITCH_HOOK(ntp, otp)
+#endif
+
+/*
+ * Thread switch events of source/TraceRing.h, only with USE_TRACE_RING.
+ */
+#if defined(TRACE_RING) && TRACE_RING && !defined(_FROM_ASM_)
+struct ch_thread;
+void TraceRing_SwitchHook(struct ch_thread *ntp);
+#define TRACE_RING_SWITCH_HOOK(ntp)         TraceRing_SwitchHook(ntp)
+#else
+#define TRACE_RING_SWITCH_HOOK(ntp)
+#endif
+
 /**
  * @brief   Threads descriptor structure extension.
  * @details User fields added to the end of the @p thread_t structure.
  */
 #define CH_CFG_THREAD_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  /* Add threads custom fields here.*/                                      \
+  THREAD_STATS_EXTRA_FIELDS
 
 /**
  * @brief   Threads initialization hook.
@@ -422,6 +454,7 @@
  */
 #define CH_CFG_THREAD_INIT_HOOK(tp) {                                       \
   /* Add threads initialization code here.*/                                \
+  THREAD_STATS_INIT_HOOK(tp);                                               \
 }
 
 /**
@@ -442,6 +475,8 @@
  */
 #define CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
   /* Context switch code here.*/                                            \
+  THREAD_STATS_SWITCH_HOOK(ntp, otp);                                       \
+  TRACE_RING_SWITCH_HOOK(ntp);                                              \
 }
 
 /**
@@ -0,0 +1,945 @@
+/**
+ * @file FilterTuner.c
+ * @brief Parallel search of the signal chain and beeper parameters over
+ *        recorded flights.
+ * @author Molnar Zoltan
+ *
+ * Usage: flight_tuner [-P name=min:max:count]... [-e generations] [-s climb]
+ *                     [-n noise] [-w noise,lag,false] [-j jobs] [-k rows]
+ *                     [-o table] [-c config] [-V] [log...]
+ *
+ * Parameters are alpha, beta, length, lift, liftoff, sink and sinkoff,
+ * thresholds in m/s. Parameters without a -P range keep the firmware
+ * value. Without -e the full grid is evaluated, with -e the search starts
+ * from a random population inside the ranges and evolves it for the given
+ * number of generations.
+ *
+ * Every candidate runs over the recorded logs and over synthetic step
+ * flights, still air with sensor noise followed by a climb, and is scored
+ * by
+ *   noise  RMS of the vario around its own centered 1 s average, m/s,
+ *   lag    time from the climb step until the beeper is on and the vario
+ *          shows 90 % of the climb, s,
+ *   false  beeper onsets per hour without a matching climb or sink in the
+ *          reference vario, a centered regression of the raw altitude.
+ * The score is noise / 0.05 m/s + lag / 1 s + false / 10 per hour, each
+ * term weighted by -w. Lower is better.
+ *
+ * Candidates with the same regression length are evaluated together, one
+ * candidate per lane of a structure of arrays kernel that the compiler
+ * vectorizes. The regression is updated with sliding sums instead of
+ * being recomputed, so a sample costs the same for every length. The
+ * lane groups are spread over the cores with the work stealing pool. -V
+ * checks the kernel against the firmware signal chain on the logs.
+ *
+ * The ranked table goes to stdout or the -o file, -c writes the best
+ * candidate as config commands of the diagnostics shell in the stored
+ * units, the file can be pasted into the shell as it is.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ConfigStore.h"
+#include "FlightLog.h"
+#include "VarioKernels.h"
+#include "WorkPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/** Candidates evaluated together, a multiple of the SIMD width. */
+#define TUNER_LANES                                                            16
+
+/* Half window of the noise average and of the reference vario, in samples. */
+#define TUNER_NOISE_HALF_WINDOW                                                25
+#define TUNER_NOISE_WINDOW                      (2 * TUNER_NOISE_HALF_WINDOW + 1)
+#define TUNER_REFERENCE_HALF_WINDOW                                            50
+
+/* Synthetic step flights. */
+#define TUNER_STEP_FLIGHTS                                                      4
+#define TUNER_STEP_STILL_TIME                                               60000
+#define TUNER_STEP_CLIMB_TIME                                               30000
+#define TUNER_STEP_ALTITUDE                                                  1000
+#define TUNER_DEFAULT_STEP_CLIMB                                            (1.5)
+/** RMS noise of the MS5611 at OSR 4096, Pa. */
+#define TUNER_DEFAULT_SENSOR_NOISE                                          (1.2)
+/** Share of the climb the vario has to reach to end the lag. */
+#define TUNER_LAG_LEVEL                                                     (0.9)
+
+/* Score scales. */
+#define TUNER_NOISE_SCALE                                                  (0.05)
+#define TUNER_LAG_SCALE                                                     (1.0)
+#define TUNER_FALSE_BEEP_SCALE                                             (10.0)
+
+#define TUNER_DEFAULT_POPULATION                                               64
+#define TUNER_DEFAULT_TABLE_ROWS                                               20
+#define TUNER_MAX_GRID                                                   10000000
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    PARAM_ALPHA,
+    PARAM_BETA,
+    PARAM_LENGTH,
+    PARAM_LIFT,
+    PARAM_LIFT_OFF,
+    PARAM_SINK,
+    PARAM_SINK_OFF,
+    PARAM_COUNT
+} TunerParam_t;
+
+struct ParamRange_s {
+    const char *name;
+    ConfigKey_t configKey;
+    double configScale;         /**< Stored value per unit. */
+    double min;
+    double max;
+    size_t count;
+};
+
+struct Candidate_s {
+    double param[PARAM_COUNT];
+    double noise;
+    double lag;
+    double falseBeeps;
+    double score;
+};
+
+struct TunerLog_s {
+    struct FlightLog_s log;
+    float *referenceMax;        /**< Highest reference vario around each sample. */
+    float *referenceMin;
+    double hours;
+    uint32_t stepTime;          /**< ms, 0 if the log has no known climb step. */
+    float stepClimb;
+};
+
+struct Corpus_s {
+    struct TunerLog_s *logs;
+    size_t count;
+    char **paths;
+};
+
+/**
+ * Candidates of a lane group share the regression length.
+ */
+struct LaneGroup_s {
+    size_t count;
+    size_t length;
+    struct Candidate_s *candidates[TUNER_LANES];
+};
+
+/**
+ * Lane metrics summed over the logs.
+ */
+struct LaneMetrics_s {
+    double noiseSum[TUNER_LANES];
+    double noiseCount;
+    double falseBeeps[TUNER_LANES];
+    double lagSum[TUNER_LANES];
+    double lagCount;
+    double hours;
+};
+
+struct Evaluation_s {
+    const struct Corpus_s *corpus;
+    struct LaneGroup_s *groups;
+    double weight[3];
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char * const configKeyNames[CONFIG_KEY_COUNT] = {CONFIG_KEY_NAMES};
+
+static struct ParamRange_s ranges[PARAM_COUNT] = {
+    {"alpha",   CONFIG_KEY_FILTER_ALPHA,        10000,   SIGNAL_CHAIN_DEFAULT_ALPHA,         SIGNAL_CHAIN_DEFAULT_ALPHA,         1},
+    {"beta",    CONFIG_KEY_FILTER_BETA,         1000000, SIGNAL_CHAIN_DEFAULT_BETA,          SIGNAL_CHAIN_DEFAULT_BETA,          1},
+    {"length",  CONFIG_KEY_REGRESSION_LENGTH,   1,       SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH, 1},
+    {"lift",    CONFIG_KEY_LIFT_THRESHOLD,      100,     BEEP_DEFAULT_LIFT_THRESHOLD,        BEEP_DEFAULT_LIFT_THRESHOLD,        1},
+    {"liftoff", CONFIG_KEY_LIFT_OFF_THRESHOLD,  100,     BEEP_DEFAULT_LIFT_OFF_THRESHOLD,    BEEP_DEFAULT_LIFT_OFF_THRESHOLD,    1},
+    {"sink",    CONFIG_KEY_SINK_THRESHOLD,      100,     BEEP_DEFAULT_SINK_THRESHOLD,        BEEP_DEFAULT_SINK_THRESHOLD,        1},
+    {"sinkoff", CONFIG_KEY_SINK_OFF_THRESHOLD,  100,     BEEP_DEFAULT_SINK_OFF_THRESHOLD,    BEEP_DEFAULT_SINK_OFF_THRESHOLD,    1},
+};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+    *state = *state * 1664525UL + 1013904223UL;
+    return *state >> 8;
+}
+
+/**
+ * Uniform in [0, 1).
+ */
+static double uniformRandom(uint32_t *state) {
+    return nextRandom(state) / 16777216.0;
+}
+
+static double gaussianRandom(uint32_t *state) {
+    double u = uniformRandom(state) + 1e-12;
+    double v = uniformRandom(state);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * Least squares slope of the raw altitude over a centered window, then the
+ * extremes of it over the same window. Not causal, this is the truth the
+ * beeper onsets are checked against.
+ */
+static bool buildReference(struct TunerLog_s *tlog) {
+    const struct FlightLog_s *log = &tlog->log;
+    size_t w = TUNER_REFERENCE_HALF_WINDOW;
+    size_t i;
+
+    float *vario = malloc(log->count * sizeof(*vario));
+    tlog->referenceMax = malloc(log->count * sizeof(*tlog->referenceMax));
+    tlog->referenceMin = malloc(log->count * sizeof(*tlog->referenceMin));
+    if ((NULL == vario) || (NULL == tlog->referenceMax) || (NULL == tlog->referenceMin)) {
+        free(vario);
+        return false;
+    }
+
+    for (i = 0; i < log->count; i++) {
+        size_t begin = (w < i) ? i - w : 0;
+        size_t end = (i + w < log->count) ? i + w + 1 : log->count;
+        double t0 = log->time[begin] / 1000.0;
+        double st = 0, sa = 0, stt = 0, sta = 0;
+        size_t j;
+
+        for (j = begin; j < end; j++) {
+            double t = log->time[j] / 1000.0 - t0;
+            double a = VarioKernels_PressureToAltitude(log->pressure[j]);
+            st += t;
+            sa += a;
+            stt += t * t;
+            sta += t * a;
+        }
+
+        double n = end - begin;
+        double den = n * stt - st * st;
+        vario[i] = (0 < den) ? (float)((n * sta - st * sa) / den) : 0;
+    }
+
+    for (i = 0; i < log->count; i++) {
+        size_t begin = (w < i) ? i - w : 0;
+        size_t end = (i + w < log->count) ? i + w + 1 : log->count;
+        float max = vario[begin];
+        float min = vario[begin];
+        size_t j;
+
+        for (j = begin + 1; j < end; j++) {
+            max = fmaxf(max, vario[j]);
+            min = fminf(min, vario[j]);
+        }
+        tlog->referenceMax[i] = max;
+        tlog->referenceMin[i] = min;
+    }
+
+    free(vario);
+
+    if (1 < log->count)
+        tlog->hours = (log->time[log->count - 1] - log->time[0]) / 3600000.0;
+    return true;
+}
+
+/**
+ * Still air followed by a climb, with gaussian sensor noise.
+ */
+static bool generateStepFlight(struct TunerLog_s *tlog, double climb, double noise, uint32_t seed) {
+    uint32_t state = seed;
+    uint32_t t;
+
+    memset(tlog, 0, sizeof(*tlog));
+    tlog->stepTime = TUNER_STEP_STILL_TIME;
+    tlog->stepClimb = (float)climb;
+
+    for (t = 0; t <= TUNER_STEP_STILL_TIME + TUNER_STEP_CLIMB_TIME; t += FLIGHT_LOG_SAMPLE_PERIOD) {
+        double altitude = TUNER_STEP_ALTITUDE;
+        if (TUNER_STEP_STILL_TIME < t)
+            altitude += climb * (t - TUNER_STEP_STILL_TIME) / 1000.0;
+
+        double pressure = FlightLog_AltitudeToPressure(altitude) + noise * gaussianRandom(&state);
+        if (!FlightLog_Append(&tlog->log, t, (uint32_t)lround(pressure)))
+            return false;
+    }
+
+    return buildReference(tlog);
+}
+
+static void loadLog(size_t task, size_t worker, void *arg) {
+    struct Corpus_s *corpus = (struct Corpus_s *)arg;
+    struct TunerLog_s *tlog = &corpus->logs[task];
+    (void)worker;
+
+    if (!FlightLog_Read(corpus->paths[task], &tlog->log))
+        return;
+    if (!buildReference(tlog)) {
+        fprintf(stderr, "%s: out of memory\n", corpus->paths[task]);
+        FlightLog_Free(&tlog->log);
+    }
+}
+
+/**
+ * Run a lane group over one log, the signal chain and the beeper state
+ * machine of every lane in lockstep.
+ * @brief Mirrors SignalChain_Process() including its time base: the
+ *        sampling time is measured from the last output, so it grows while
+ *        the buffer fills. The lane loops have no calls and no branches
+ *        except the altitude conversion, which needs the double pow() of
+ *        the firmware to keep its rounding.
+ * @param[out] trace Vario of lane 0 per output for the verification, or NULL.
+ */
+static void runLanes(
+        const struct LaneGroup_s *group,
+        const struct TunerLog_s *tlog,
+        struct LaneMetrics_s *metrics,
+        float *trace) {
+    const struct FlightLog_s *log = &tlog->log;
+    size_t length = group->length;
+    size_t k;
+
+    float alpha[TUNER_LANES], beta[TUNER_LANES];
+    float lift[TUNER_LANES], liftOff[TUNER_LANES], sink[TUNER_LANES], sinkOff[TUNER_LANES];
+    float position[TUNER_LANES], velocity[TUNER_LANES], altitude[TUNER_LANES], scale[TUNER_LANES];
+    float earlyVario[TUNER_LANES], liftSum[TUNER_LANES], sinkSum[TUNER_LANES];
+    int32_t onset[TUNER_LANES], state[TUNER_LANES];
+    double sumY[TUNER_LANES], sumIY[TUNER_LANES];
+    float ring[SIGNAL_CHAIN_MAX_BUFFER_LENGTH][TUNER_LANES];
+    float varioRing[TUNER_NOISE_WINDOW][TUNER_LANES];
+    double varioSum[TUNER_LANES];
+    float lag[TUNER_LANES];
+
+    if (log->count <= length)
+        return;
+
+    /* Unused lanes repeat the first candidate. */
+    for (k = 0; k < TUNER_LANES; k++) {
+        const double *p = group->candidates[(k < group->count) ? k : 0]->param;
+        alpha[k] = (float)p[PARAM_ALPHA];
+        beta[k] = (float)p[PARAM_BETA];
+        lift[k] = (float)p[PARAM_LIFT];
+        liftOff[k] = (float)p[PARAM_LIFT_OFF];
+        sink[k] = (float)p[PARAM_SINK];
+        sinkOff[k] = (float)p[PARAM_SINK_OFF];
+        position[k] = log->pressure[0];
+        velocity[k] = 0;
+        earlyVario[k] = liftSum[k] = sinkSum[k] = 0;
+        onset[k] = ONSET_NONE;
+        state[k] = BEEP_DISABLED;
+        sumY[k] = sumIY[k] = varioSum[k] = 0;
+        lag[k] = -1;
+    }
+    memset(varioRing, 0, sizeof(varioRing));
+
+    double n = length;
+    double meanIndex = (n - 1) / 2;
+    double sxx = n * (n * n - 1) / 12;
+    uint32_t lastTimestamp = log->time[0];
+    size_t fill = 0;
+    size_t head = 0;
+    size_t outputs = 0;
+    size_t i;
+
+    for (i = 1; i < log->count; i++) {
+        float samplingTime = (uint32_t)(log->time[i] - lastTimestamp);
+        float measurement = log->pressure[i];
+
+        for (k = 0; k < TUNER_LANES; k++) {
+            float xk = position[k] + velocity[k] * samplingTime;
+            float rk = measurement - xk;
+            position[k] = xk + alpha[k] * rk;
+            velocity[k] += beta[k] * rk / samplingTime;
+        }
+
+        for (k = 0; k < TUNER_LANES; k++) {
+            double a = pow(position[k] / 101325.0, 0.1902);
+            altitude[k] = (float)(44330 * (1 - a));
+            scale[k] = 44330 * 0.1902f * (float)a / position[k];
+        }
+
+        if (fill < length) {
+            for (k = 0; k < TUNER_LANES; k++) {
+                sumY[k] += altitude[k];
+                sumIY[k] += fill * (double)altitude[k];
+                ring[head][k] = altitude[k];
+            }
+            head = (head + 1) % length;
+            if (++fill < length)
+                continue;
+        } else {
+            for (k = 0; k < TUNER_LANES; k++) {
+                double oldest = ring[head][k];
+                sumIY[k] += (n - 1) * altitude[k] - (sumY[k] - oldest);
+                sumY[k] += altitude[k] - oldest;
+                ring[head][k] = altitude[k];
+            }
+            head = (head + 1) % length;
+        }
+
+        lastTimestamp = log->time[i];
+
+        double inverseDen = 1000.0 / (sxx * samplingTime);
+        bool stepped = (0 != tlog->stepTime) && (tlog->stepTime <= log->time[i] - log->time[0]);
+        float lagTime = (log->time[i] - log->time[0] - tlog->stepTime) / 1000.0f;
+        float lagLevel = (float)(TUNER_LAG_LEVEL * tlog->stepClimb);
+        size_t slot = outputs % TUNER_NOISE_WINDOW;
+        size_t center = (slot + TUNER_NOISE_WINDOW - TUNER_NOISE_HALF_WINDOW) % TUNER_NOISE_WINDOW;
+        bool windowFull = (TUNER_NOISE_WINDOW <= outputs + 1);
+        float referenceMax = tlog->referenceMax[i];
+        float referenceMin = tlog->referenceMin[i];
+
+        for (k = 0; k < TUNER_LANES; k++) {
+            float vario = (float)((sumIY[k] - meanIndex * sumY[k]) * inverseDen);
+            float fastVario = -scale[k] * velocity[k] * 1000;
+
+            earlyVario[k] += ONSET_SMOOTHING * (fastVario - earlyVario[k]);
+            float lead = earlyVario[k] - vario;
+            bool active = (ONSET_NONE != onset[k]);
+            bool settled = active && (fabsf(lead) < ONSET_DRIFT);
+            float nextLift = fmaxf(0, liftSum[k] + lead - ONSET_DRIFT);
+            float nextSink = fmaxf(0, sinkSum[k] - lead - ONSET_DRIFT);
+            int32_t detected = (ONSET_THRESHOLD < nextLift) ? ONSET_LIFT :
+                               ((ONSET_THRESHOLD < nextSink) ? ONSET_SINK : ONSET_NONE);
+
+            liftSum[k] = active ? (settled ? 0 : liftSum[k]) : nextLift;
+            sinkSum[k] = active ? (settled ? 0 : sinkSum[k]) : nextSink;
+            onset[k] = active ? (settled ? ONSET_NONE : onset[k]) : detected;
+
+            bool early = ((ONSET_LIFT == onset[k]) && (vario < earlyVario[k])) ||
+                         ((ONSET_SINK == onset[k]) && (earlyVario[k] < vario));
+            float selected = early ? earlyVario[k] : vario;
+
+            int32_t previous = state[k];
+            int32_t next = previous;
+            next = ((BEEP_LIFTING == previous) && (selected < liftOff[k])) ? BEEP_DISABLED : next;
+            next = ((BEEP_SINKING == previous) && (sinkOff[k] < selected)) ? BEEP_DISABLED : next;
+            next = ((BEEP_DISABLED == previous) && (lift[k] < selected)) ? BEEP_LIFTING : next;
+            next = ((BEEP_DISABLED == previous) && (selected < sink[k])) ? BEEP_SINKING : next;
+            state[k] = next;
+
+            bool falseLift = (BEEP_DISABLED == previous) && (BEEP_LIFTING == next) && (referenceMax <= lift[k]);
+            bool falseSink = (BEEP_DISABLED == previous) && (BEEP_SINKING == next) && (sink[k] <= referenceMin);
+            metrics->falseBeeps[k] += falseLift + falseSink;
+
+            bool reached = stepped && (lag[k] < 0) && (BEEP_LIFTING == next) && (lagLevel <= selected);
+            lag[k] = reached ? lagTime : lag[k];
+
+            varioSum[k] += selected - varioRing[slot][k];
+            varioRing[slot][k] = selected;
+            float deviation = varioRing[center][k] - (float)(varioSum[k] / TUNER_NOISE_WINDOW);
+            metrics->noiseSum[k] += windowFull ? deviation * deviation : 0;
+
+            if ((NULL != trace) && (0 == k))
+                trace[outputs] = selected;
+        }
+
+        metrics->noiseCount += windowFull;
+        outputs++;
+    }
+
+    if (0 != tlog->stepTime) {
+        for (k = 0; k < TUNER_LANES; k++)
+            metrics->lagSum[k] += (0 <= lag[k]) ? lag[k] : TUNER_STEP_CLIMB_TIME / 1000.0;
+        metrics->lagCount++;
+    }
+    metrics->hours += tlog->hours;
+}
+
+static void evaluateGroup(size_t task, size_t worker, void *arg) {
+    struct Evaluation_s *evaluation = (struct Evaluation_s *)arg;
+    struct LaneGroup_s *group = &evaluation->groups[task];
+    struct LaneMetrics_s metrics;
+    size_t i;
+    (void)worker;
+
+    memset(&metrics, 0, sizeof(metrics));
+    for (i = 0; i < evaluation->corpus->count; i++)
+        runLanes(group, &evaluation->corpus->logs[i], &metrics, NULL);
+
+    for (i = 0; i < group->count; i++) {
+        struct Candidate_s *candidate = group->candidates[i];
+        candidate->noise = (0 < metrics.noiseCount) ? sqrt(metrics.noiseSum[i] / metrics.noiseCount) : 0;
+        candidate->lag = (0 < metrics.lagCount) ? metrics.lagSum[i] / metrics.lagCount : 0;
+        candidate->falseBeeps = (0 < metrics.hours) ? metrics.falseBeeps[i] / metrics.hours : 0;
+        candidate->score = evaluation->weight[0] * candidate->noise / TUNER_NOISE_SCALE +
+                           evaluation->weight[1] * candidate->lag / TUNER_LAG_SCALE +
+                           evaluation->weight[2] * candidate->falseBeeps / TUNER_FALSE_BEEP_SCALE;
+    }
+}
+
+static int compareLength(const void *a, const void *b) {
+    double lengthA = (*(struct Candidate_s * const *)a)->param[PARAM_LENGTH];
+    double lengthB = (*(struct Candidate_s * const *)b)->param[PARAM_LENGTH];
+    return (lengthB < lengthA) - (lengthA < lengthB);
+}
+
+static int compareScore(const void *a, const void *b) {
+    double scoreA = ((const struct Candidate_s *)a)->score;
+    double scoreB = ((const struct Candidate_s *)b)->score;
+    return (scoreB < scoreA) - (scoreA < scoreB);
+}
+
+/**
+ * Score the candidates, grouped by regression length into lane groups.
+ */
+static bool evaluate(
+        const struct Corpus_s *corpus,
+        struct Candidate_s *candidates,
+        size_t count,
+        const double *weight,
+        size_t workers) {
+    struct Candidate_s **sorted = malloc(count * sizeof(*sorted));
+    struct LaneGroup_s *groups = calloc(count, sizeof(*groups));
+    size_t groupCount = 0;
+    size_t i;
+
+    if ((NULL == sorted) || (NULL == groups)) {
+        free(sorted);
+        free(groups);
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+        sorted[i] = &candidates[i];
+    qsort(sorted, count, sizeof(*sorted), compareLength);
+
+    for (i = 0; i < count; i++) {
+        size_t length = (size_t)sorted[i]->param[PARAM_LENGTH];
+        struct LaneGroup_s *group = &groups[groupCount];
+
+        if ((0 != group->count) && ((TUNER_LANES == group->count) || (length != group->length)))
+            group = &groups[++groupCount];
+
+        group->length = length;
+        group->candidates[group->count++] = sorted[i];
+    }
+    groupCount++;
+
+    struct Evaluation_s evaluation = {corpus, groups, {weight[0], weight[1], weight[2]}};
+    bool result = WorkPool_Run(groupCount, workers, evaluateGroup, &evaluation);
+
+    free(sorted);
+    free(groups);
+    return result;
+}
+
+static size_t gridSize(void) {
+    size_t size = 1;
+    size_t p;
+    for (p = 0; p < PARAM_COUNT; p++) {
+        if (TUNER_MAX_GRID / ranges[p].count < size)
+            return TUNER_MAX_GRID + 1;
+        size *= ranges[p].count;
+    }
+    return size;
+}
+
+static double gridValue(TunerParam_t p, size_t index) {
+    if (1 == ranges[p].count)
+        return ranges[p].min;
+    return ranges[p].min + (ranges[p].max - ranges[p].min) * index / (ranges[p].count - 1);
+}
+
+/**
+ * Keep a candidate inside the ranges. The length stays on its grid even
+ * while evolving, candidates only share a lane group with equal lengths.
+ */
+static void clampCandidate(struct Candidate_s *candidate) {
+    const struct ParamRange_s *length = &ranges[PARAM_LENGTH];
+    size_t p;
+
+    for (p = 0; p < PARAM_COUNT; p++)
+        candidate->param[p] = fmin(ranges[p].max, fmax(ranges[p].min, candidate->param[p]));
+
+    if ((1 < length->count) && (length->min < length->max)) {
+        double index = round((candidate->param[PARAM_LENGTH] - length->min) *
+                (length->count - 1) / (length->max - length->min));
+        candidate->param[PARAM_LENGTH] = gridValue(PARAM_LENGTH, (size_t)index);
+    }
+    candidate->param[PARAM_LENGTH] = round(candidate->param[PARAM_LENGTH]);
+}
+
+/**
+ * Candidates in the order of the grid, the length varies slowest so the
+ * lane groups fill up.
+ */
+static void fillGrid(struct Candidate_s *candidates, size_t count) {
+    static const TunerParam_t order[PARAM_COUNT] = {
+        PARAM_SINK_OFF, PARAM_SINK, PARAM_LIFT_OFF, PARAM_LIFT, PARAM_BETA, PARAM_ALPHA, PARAM_LENGTH
+    };
+    size_t i, p;
+
+    for (i = 0; i < count; i++) {
+        size_t index = i;
+        memset(&candidates[i], 0, sizeof(candidates[i]));
+        for (p = 0; p < PARAM_COUNT; p++) {
+            candidates[i].param[order[p]] = gridValue(order[p], index % ranges[order[p]].count);
+            index /= ranges[order[p]].count;
+        }
+        clampCandidate(&candidates[i]);
+    }
+}
+
+/**
+ * (mu + lambda) evolution: the best quarter of the population survives and
+ * the rest is replaced by gaussian mutations of the survivors, with a step
+ * size shrinking over the generations.
+ */
+static bool evolve(
+        const struct Corpus_s *corpus,
+        struct Candidate_s *population,
+        size_t size,
+        size_t generations,
+        const double *weight,
+        size_t workers) {
+    uint32_t state = 1;
+    size_t survivors = (3 < size) ? size / 4 : 1;
+    size_t generation, i, p;
+
+    for (i = 0; i < size; i++) {
+        memset(&population[i], 0, sizeof(population[i]));
+        for (p = 0; p < PARAM_COUNT; p++)
+            population[i].param[p] = ranges[p].min + (ranges[p].max - ranges[p].min) * uniformRandom(&state);
+        clampCandidate(&population[i]);
+    }
+
+    if (!evaluate(corpus, population, size, weight, workers))
+        return false;
+
+    for (generation = 1; generation < generations; generation++) {
+        double step = 0.2 * pow(0.85, generation);
+
+        qsort(population, size, sizeof(*population), compareScore);
+        for (i = survivors; i < size; i++) {
+            const struct Candidate_s *parent = &population[nextRandom(&state) % survivors];
+            memset(&population[i], 0, sizeof(population[i]));
+            for (p = 0; p < PARAM_COUNT; p++)
+                population[i].param[p] = parent->param[p] +
+                        step * (ranges[p].max - ranges[p].min) * gaussianRandom(&state);
+            clampCandidate(&population[i]);
+        }
+
+        if (!evaluate(corpus, &population[survivors], size - survivors, weight, workers))
+            return false;
+
+        fprintf(stderr, "generation %zu, best score %.3f\n", generation, population[0].score);
+    }
+
+    qsort(population, size, sizeof(*population), compareScore);
+    return true;
+}
+
+/**
+ * Compare the lane kernel with the firmware signal chain.
+ * @return Largest vario difference over all logs, m/s.
+ */
+static double verify(const struct Corpus_s *corpus) {
+    struct Candidate_s candidate;
+    struct LaneGroup_s group = {1, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH, {&candidate}};
+    struct FlightReplayConfig_s config = {
+        {SIGNAL_CHAIN_DEFAULT_ALPHA, SIGNAL_CHAIN_DEFAULT_BETA, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH},
+        {BEEP_DEFAULT_LIFT_THRESHOLD, BEEP_DEFAULT_LIFT_OFF_THRESHOLD,
+         BEEP_DEFAULT_SINK_THRESHOLD, BEEP_DEFAULT_SINK_OFF_THRESHOLD},
+        NULL
+    };
+    double worst = 0;
+    size_t i, j;
+
+    for (j = 0; j < PARAM_COUNT; j++)
+        candidate.param[j] = ranges[j].min;
+    candidate.param[PARAM_ALPHA] = SIGNAL_CHAIN_DEFAULT_ALPHA;
+    candidate.param[PARAM_BETA] = SIGNAL_CHAIN_DEFAULT_BETA;
+    candidate.param[PARAM_LENGTH] = SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH;
+
+    for (i = 0; i < corpus->count; i++) {
+        const struct FlightLog_s *log = &corpus->logs[i].log;
+        struct LaneMetrics_s metrics;
+        struct FlightRow_s *rows = malloc((log->count + 1) * sizeof(*rows));
+        float *trace = malloc((log->count + 1) * sizeof(*trace));
+
+        if ((NULL != rows) && (NULL != trace)) {
+            memset(&metrics, 0, sizeof(metrics));
+            size_t count = FlightLog_Replay(log, &config, rows);
+            runLanes(&group, &corpus->logs[i], &metrics, trace);
+            for (j = 0; j < count; j++)
+                worst = fmax(worst, fabs(rows[j].vario - trace[j]));
+        }
+
+        free(rows);
+        free(trace);
+    }
+
+    return worst;
+}
+
+static bool parseRange(const char *text) {
+    char name[16];
+    double min, max;
+    unsigned count = 1;
+    size_t p;
+
+    int fields = sscanf(text, "%15[a-z]=%lf:%lf:%u", name, &min, &max, &count);
+    if (2 == fields) {
+        max = min;
+        count = 1;
+    } else if ((4 != fields) || (0 == count) || (max < min)) {
+        return false;
+    }
+
+    for (p = 0; p < PARAM_COUNT; p++) {
+        if (0 == strcmp(name, ranges[p].name)) {
+            ranges[p].min = min;
+            ranges[p].max = max;
+            ranges[p].count = count;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * The device limits, so every row of the table can be loaded.
+ */
+static bool checkRanges(void) {
+    if ((ranges[PARAM_ALPHA].min <= 0) || (1 < ranges[PARAM_ALPHA].max)) {
+        fprintf(stderr, "alpha has to be in (0, 1]\n");
+        return false;
+    }
+    if ((ranges[PARAM_BETA].min < 0) || (1 <= ranges[PARAM_BETA].max)) {
+        fprintf(stderr, "beta has to be in [0, 1)\n");
+        return false;
+    }
+    if ((ranges[PARAM_LENGTH].min < 2) || (SIGNAL_CHAIN_MAX_BUFFER_LENGTH < ranges[PARAM_LENGTH].max)) {
+        fprintf(stderr, "length has to be in 2 .. %d\n", SIGNAL_CHAIN_MAX_BUFFER_LENGTH);
+        return false;
+    }
+    return true;
+}
+
+static void writeTable(FILE *file, const struct Candidate_s *candidates, size_t count) {
+    size_t i;
+
+    fputs("rank,score,noise,lag_s,false_per_h,alpha,beta,length,lift,lift_off,sink,sink_off\n", file);
+    for (i = 0; i < count; i++) {
+        const struct Candidate_s *c = &candidates[i];
+        fprintf(file, "%zu,%.4f,%.4f,%.2f,%.2f,%.4f,%.6f,%.0f,%.2f,%.2f,%.2f,%.2f\n",
+                i + 1, c->score, c->noise, c->lag, c->falseBeeps,
+                c->param[PARAM_ALPHA], c->param[PARAM_BETA], c->param[PARAM_LENGTH],
+                c->param[PARAM_LIFT], c->param[PARAM_LIFT_OFF],
+                c->param[PARAM_SINK], c->param[PARAM_SINK_OFF]);
+    }
+}
+
+/**
+ * The best candidate as ConfigStore values, in the units of the keys.
+ */
+static bool writeConfig(const char *path, const struct Candidate_s *best) {
+    size_t p;
+
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        fprintf(stderr, "%s: cannot create\n", path);
+        return false;
+    }
+
+    fprintf(file, "# score %.4f, noise %.4f m/s, lag %.2f s, %.2f false beeps per hour\n",
+            best->score, best->noise, best->lag, best->falseBeeps);
+    for (p = 0; p < PARAM_COUNT; p++)
+        fprintf(file, "config %s %ld\n", configKeyNames[ranges[p].configKey], lround(best->param[p] * ranges[p].configScale));
+
+    return 0 == fclose(file);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-P name=min:max:count]... [-e generations] [-s climb] [-n noise]\n"
+            "       [-w noise,lag,false] [-j jobs] [-k rows] [-o table] [-c config] [-V] [log...]\n"
+            "  -P  search range of alpha, beta, length, lift, liftoff, sink or sinkoff,\n"
+            "      the length stays on its grid points while evolving\n"
+            "  -e  evolve a population of %d instead of the grid search\n"
+            "  -w  score weights, default 1,1,1\n"
+            "  -s  climb of the synthetic steps in m/s, default %g\n"
+            "  -n  sensor noise of the synthetic steps in Pa, default %g\n"
+            "  -j  worker threads, default one per core\n"
+            "  -k  rows of the ranked table, default %d\n"
+            "  -o  write the table to a file instead of stdout\n"
+            "  -c  write the best candidate as config commands of the shell\n"
+            "  -V  check the lane kernel against the signal chain\n",
+            name, TUNER_DEFAULT_POPULATION, TUNER_DEFAULT_STEP_CLIMB, TUNER_DEFAULT_SENSOR_NOISE,
+            TUNER_DEFAULT_TABLE_ROWS);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    struct Corpus_s corpus;
+    double weight[3] = {1, 1, 1};
+    double stepClimb = TUNER_DEFAULT_STEP_CLIMB;
+    double sensorNoise = TUNER_DEFAULT_SENSOR_NOISE;
+    size_t generations = 0;
+    size_t workers = WorkPool_DefaultWorkers();
+    size_t tableRows = TUNER_DEFAULT_TABLE_ROWS;
+    const char *tablePath = NULL;
+    const char *configPath = NULL;
+    bool check = false;
+    size_t i;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "P:e:w:s:n:j:k:o:c:V"))) {
+        switch (opt) {
+        case 'P':
+            if (!parseRange(optarg)) {
+                fprintf(stderr, "bad range %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'e':
+            generations = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            if (3 != sscanf(optarg, "%lf,%lf,%lf", &weight[0], &weight[1], &weight[2])) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            stepClimb = strtod(optarg, NULL);
+            break;
+        case 'n':
+            sensorNoise = strtod(optarg, NULL);
+            break;
+        case 'j':
+            workers = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            tableRows = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            tablePath = optarg;
+            break;
+        case 'c':
+            configPath = optarg;
+            break;
+        case 'V':
+            check = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!checkRanges())
+        return EXIT_FAILURE;
+
+    memset(&corpus, 0, sizeof(corpus));
+    size_t recorded = (size_t)(argc - optind);
+    corpus.count = recorded + TUNER_STEP_FLIGHTS;
+    corpus.paths = &argv[optind];
+    corpus.logs = calloc(corpus.count, sizeof(*corpus.logs));
+    if (NULL == corpus.logs) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    double start = now();
+    if (!WorkPool_Run(recorded, workers, loadLog, &corpus))
+        return EXIT_FAILURE;
+    for (i = 0; i < TUNER_STEP_FLIGHTS; i++) {
+        if (!generateStepFlight(&corpus.logs[recorded + i], stepClimb, sensorNoise, (uint32_t)i + 1)) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t samples = 0;
+    for (i = 0; i < corpus.count; i++)
+        samples += corpus.logs[i].log.count;
+    fprintf(stderr, "%zu logs, %zu samples loaded in %.2f s\n", corpus.count, samples, now() - start);
+
+    if (check)
+        fprintf(stderr, "largest vario difference to the signal chain %.6f m/s\n", verify(&corpus));
+
+    size_t count = generations ? TUNER_DEFAULT_POPULATION : gridSize();
+    if (TUNER_MAX_GRID < count) {
+        fprintf(stderr, "grid of more than %d candidates, use -e\n", TUNER_MAX_GRID);
+        return EXIT_FAILURE;
+    }
+
+    struct Candidate_s *candidates = calloc(count, sizeof(*candidates));
+    if (NULL == candidates) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    start = now();
+    bool evaluated;
+    if (generations) {
+        evaluated = evolve(&corpus, candidates, count, generations, weight, workers);
+    } else {
+        fillGrid(candidates, count);
+        evaluated = evaluate(&corpus, candidates, count, weight, workers);
+        qsort(candidates, count, sizeof(*candidates), compareScore);
+    }
+    if (!evaluated) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    double elapsed = now() - start;
+    size_t evaluations = generations ? count + (generations - 1) * (count - count / 4) : count;
+    fprintf(stderr, "%zu candidates in %.2f s, %.1f ns per candidate and sample\n",
+            evaluations, elapsed, elapsed * 1e9 / ((double)evaluations * samples));
+
+    FILE *table = (NULL != tablePath) ? fopen(tablePath, "w") : stdout;
+    if (NULL == table) {
+        fprintf(stderr, "%s: cannot create\n", tablePath);
+        return EXIT_FAILURE;
+    }
+    writeTable(table, candidates, (tableRows < count) ? tableRows : count);
+    if (stdout != table)
+        fclose(table);
+
+    if ((NULL != configPath) && !writeConfig(configPath, &candidates[0]))
+        return EXIT_FAILURE;
+
+    for (i = 0; i < corpus.count; i++) {
+        FlightLog_Free(&corpus.logs[i].log);
+        free(corpus.logs[i].referenceMax);
+        free(corpus.logs[i].referenceMin);
+    }
+    free(corpus.logs);
+    free(candidates);
+
+    return EXIT_SUCCESS;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,385 @@
+/**
+ * @file FlightBatch.c
+ * @brief Parallel batch processing of flight log corpora.
+ * @author Molnar Zoltan
+ *
+ * Usage: flight_batch [-j jobs] [-o outdir] [-s summary] [-l list]
+ *                     [-p profile] [-A alpha] [-B beta] [-L length]
+ *                     [-T lift,liftoff,sink,sinkoff] [log...]
+ *
+ * Every log is replayed through its own signal chain instance on a work
+ * stealing pool with one worker per core, or -j workers. The logs are
+ * taken from the command line and from the -l list file, one path per
+ * line, "-" reads the list from stdin. The filter and beeper parameters
+ * default to the firmware values and can be overridden to evaluate a
+ * change over the whole corpus.
+ *
+ * -o writes the vario series of every flight to <outdir>/<log>.csv, in the
+ * format of flight_replay. The summary, one CSV row per flight in input
+ * order, goes to the -s file or stdout:
+ *   log,samples,duration_s,min_altitude,max_altitude,max_climb,max_sink,
+ *   vario_rms,lift_s,sink_s,beeps
+ * lift_s and sink_s are the time the beeper spent in the lifting and the
+ * sinking state, beeps counts the times it left the disabled state.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "FlightLog.h"
+#include "WorkPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct FlightSummary_s {
+    bool valid;
+    size_t samples;
+    double duration;            /**< s. */
+    float minAltitude;
+    float maxAltitude;
+    float maxClimb;
+    float maxSink;
+    double varioRms;
+    double liftTime;            /**< s. */
+    double sinkTime;            /**< s. */
+    size_t beeps;
+};
+
+struct FlightJob_s {
+    const char *path;
+    size_t order;               /**< Position on the command line and in the lists. */
+    off_t size;
+    struct FlightSummary_s summary;
+};
+
+struct Batch_s {
+    struct FlightJob_s *jobs;
+    size_t jobCount;
+    size_t jobCapacity;
+    const char *outputDir;
+    struct FlightReplayConfig_s config;
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool addJob(struct Batch_s *batch, const char *path) {
+    if (batch->jobCount == batch->jobCapacity) {
+        size_t capacity = batch->jobCapacity ? 2 * batch->jobCapacity : 256;
+        struct FlightJob_s *jobs = realloc(batch->jobs, capacity * sizeof(*jobs));
+        if (NULL == jobs)
+            return false;
+        batch->jobs = jobs;
+        batch->jobCapacity = capacity;
+    }
+
+    struct FlightJob_s *job = &batch->jobs[batch->jobCount++];
+    struct stat info;
+    memset(job, 0, sizeof(*job));
+    job->path = path;
+    job->order = batch->jobCount - 1;
+    job->size = (0 == stat(path, &info)) ? info.st_size : 0;
+    return true;
+}
+
+/**
+ * Add the paths of a list file, the strings are kept for the whole run.
+ */
+static bool readList(struct Batch_s *batch, const char *listPath) {
+    FILE *file = (0 == strcmp("-", listPath)) ? stdin : fopen(listPath, "r");
+    char line[FLIGHT_LOG_PATH_LENGTH];
+
+    if (NULL == file) {
+        fprintf(stderr, "%s: cannot open\n", listPath);
+        return false;
+    }
+
+    while (NULL != fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (('\0' == line[0]) || ('#' == line[0]))
+            continue;
+
+        char *path = strdup(line);
+        if ((NULL == path) || !addJob(batch, path)) {
+            fprintf(stderr, "out of memory\n");
+            return false;
+        }
+    }
+
+    if (stdin != file)
+        fclose(file);
+    return true;
+}
+
+static void summarize(const struct FlightRow_s *rows, size_t count, struct FlightSummary_s *summary) {
+    double squareSum = 0;
+    size_t i;
+
+    if (0 == count)
+        return;
+
+    summary->duration = (rows[count - 1].time - rows[0].time) / 1000.0;
+    summary->minAltitude = summary->maxAltitude = rows[0].altitude;
+    summary->maxClimb = summary->maxSink = rows[0].vario;
+
+    for (i = 0; i < count; i++) {
+        const struct FlightRow_s *row = &rows[i];
+
+        summary->minAltitude = fminf(summary->minAltitude, row->altitude);
+        summary->maxAltitude = fmaxf(summary->maxAltitude, row->altitude);
+        summary->maxClimb = fmaxf(summary->maxClimb, row->vario);
+        summary->maxSink = fminf(summary->maxSink, row->vario);
+        squareSum += (double)row->vario * row->vario;
+
+        if (0 == i)
+            continue;
+
+        double dt = (row->time - rows[i - 1].time) / 1000.0;
+        if (BEEP_LIFTING == rows[i - 1].state)
+            summary->liftTime += dt;
+        if (BEEP_SINKING == rows[i - 1].state)
+            summary->sinkTime += dt;
+        if ((BEEP_DISABLED == rows[i - 1].state) && (BEEP_DISABLED != row->state))
+            summary->beeps++;
+    }
+
+    summary->varioRms = sqrt(squareSum / count);
+}
+
+/**
+ * Pool task, everything a log needs is owned by the task.
+ */
+static void processFlight(size_t task, size_t worker, void *arg) {
+    struct Batch_s *batch = (struct Batch_s *)arg;
+    struct FlightJob_s *job = &batch->jobs[task];
+    struct FlightLog_s log;
+    (void)worker;
+
+    if (!FlightLog_Read(job->path, &log))
+        return;
+
+    struct FlightRow_s *rows = malloc((log.count + 1) * sizeof(*rows));
+    if (NULL == rows) {
+        fprintf(stderr, "%s: out of memory\n", job->path);
+        FlightLog_Free(&log);
+        return;
+    }
+
+    size_t count = FlightLog_Replay(&log, &batch->config, rows);
+    job->summary.samples = log.count;
+    summarize(rows, count, &job->summary);
+    job->summary.valid = true;
+
+    if (NULL != batch->outputDir) {
+        char path[FLIGHT_LOG_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s/%s.csv", batch->outputDir, FlightLog_BaseName(job->path));
+        job->summary.valid = FlightLog_WriteRows(path, rows, count);
+    }
+
+    free(rows);
+    FlightLog_Free(&log);
+}
+
+static void writeSummary(FILE *file, const struct Batch_s *batch) {
+    size_t i;
+
+    fputs("log,samples,duration_s,min_altitude,max_altitude,max_climb,max_sink,"
+          "vario_rms,lift_s,sink_s,beeps\n", file);
+
+    for (i = 0; i < batch->jobCount; i++) {
+        const struct FlightJob_s *job = &batch->jobs[i];
+        const struct FlightSummary_s *s = &job->summary;
+
+        if (!s->valid)
+            continue;
+
+        fprintf(file, "%s,%zu,%.1f,%.2f,%.2f,%.3f,%.3f,%.4f,%.1f,%.1f,%zu\n",
+                job->path, s->samples, s->duration, s->minAltitude, s->maxAltitude,
+                s->maxClimb, s->maxSink, s->varioRms, s->liftTime, s->sinkTime, s->beeps);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-j jobs] [-o outdir] [-s summary] [-l list] [-p profile]\n"
+            "       [-A alpha] [-B beta] [-L length] [-T lift,liftoff,sink,sinkoff] [log...]\n"
+            "  -j  worker threads, default one per core\n"
+            "  -o  write the vario series to <outdir>/<log>.csv\n"
+            "  -s  write the summary to a file instead of stdout\n"
+            "  -l  read log paths from a file, - is stdin\n"
+            "  -p  tone profile index of the series, default 0\n"
+            "  -A, -B, -L  alpha-beta filter and regression length, default %g, %g, %d\n"
+            "  -T  beeper thresholds in m/s, default %g,%g,%g,%g\n",
+            name, SIGNAL_CHAIN_DEFAULT_ALPHA, SIGNAL_CHAIN_DEFAULT_BETA, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH,
+            BEEP_DEFAULT_LIFT_THRESHOLD, BEEP_DEFAULT_LIFT_OFF_THRESHOLD,
+            BEEP_DEFAULT_SINK_THRESHOLD, BEEP_DEFAULT_SINK_OFF_THRESHOLD);
+}
+
+/**
+ * Largest logs first, so the pool does not end on a long straggler.
+ */
+static int compareJobSize(const void *a, const void *b) {
+    off_t sizeA = ((const struct FlightJob_s *)a)->size;
+    off_t sizeB = ((const struct FlightJob_s *)b)->size;
+    return (sizeA < sizeB) - (sizeB < sizeA);
+}
+
+static int compareJobOrder(const void *a, const void *b) {
+    size_t orderA = ((const struct FlightJob_s *)a)->order;
+    size_t orderB = ((const struct FlightJob_s *)b)->order;
+    return (orderB < orderA) - (orderA < orderB);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    struct Batch_s batch;
+    size_t workers = WorkPool_DefaultWorkers();
+    const char *summaryPath = NULL;
+    size_t profileIndex = 0;
+    size_t failures = 0;
+    size_t samples = 0;
+    size_t i;
+    int opt;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.config.chain.alpha = SIGNAL_CHAIN_DEFAULT_ALPHA;
+    batch.config.chain.beta = SIGNAL_CHAIN_DEFAULT_BETA;
+    batch.config.chain.bufferLength = SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH;
+    batch.config.thresholds.lift = BEEP_DEFAULT_LIFT_THRESHOLD;
+    batch.config.thresholds.liftOff = BEEP_DEFAULT_LIFT_OFF_THRESHOLD;
+    batch.config.thresholds.sink = BEEP_DEFAULT_SINK_THRESHOLD;
+    batch.config.thresholds.sinkOff = BEEP_DEFAULT_SINK_OFF_THRESHOLD;
+
+    while (-1 != (opt = getopt(argc, argv, "j:o:s:l:p:A:B:L:T:"))) {
+        switch (opt) {
+        case 'j':
+            workers = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            batch.outputDir = optarg;
+            break;
+        case 's':
+            summaryPath = optarg;
+            break;
+        case 'l':
+            if (!readList(&batch, optarg))
+                return EXIT_FAILURE;
+            break;
+        case 'p':
+            profileIndex = strtoul(optarg, NULL, 10);
+            break;
+        case 'A':
+            batch.config.chain.alpha = strtof(optarg, NULL);
+            break;
+        case 'B':
+            batch.config.chain.beta = strtof(optarg, NULL);
+            break;
+        case 'L':
+            batch.config.chain.bufferLength = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            if (4 != sscanf(optarg, "%f,%f,%f,%f",
+                    &batch.config.thresholds.lift, &batch.config.thresholds.liftOff,
+                    &batch.config.thresholds.sink, &batch.config.thresholds.sinkOff)) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((batch.config.chain.bufferLength < 2) ||
+        (SIGNAL_CHAIN_MAX_BUFFER_LENGTH < batch.config.chain.bufferLength)) {
+        fprintf(stderr, "regression length has to be 2 .. %d\n", SIGNAL_CHAIN_MAX_BUFFER_LENGTH);
+        return EXIT_FAILURE;
+    }
+
+    batch.config.profile = ToneProfile_Get(profileIndex);
+    if (NULL == batch.config.profile) {
+        fprintf(stderr, "no tone profile %zu\n", profileIndex);
+        return EXIT_FAILURE;
+    }
+
+    for (i = (size_t)optind; i < (size_t)argc; i++) {
+        if (!addJob(&batch, argv[i])) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (0 == batch.jobCount) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    qsort(batch.jobs, batch.jobCount, sizeof(*batch.jobs), compareJobSize);
+
+    double start = now();
+    if (!WorkPool_Run(batch.jobCount, workers, processFlight, &batch)) {
+        fprintf(stderr, "cannot start the workers\n");
+        return EXIT_FAILURE;
+    }
+    double elapsed = now() - start;
+
+    qsort(batch.jobs, batch.jobCount, sizeof(*batch.jobs), compareJobOrder);
+
+    FILE *summary = (NULL != summaryPath) ? fopen(summaryPath, "w") : stdout;
+    if (NULL == summary) {
+        fprintf(stderr, "%s: cannot create\n", summaryPath);
+        return EXIT_FAILURE;
+    }
+    writeSummary(summary, &batch);
+    if (stdout != summary)
+        fclose(summary);
+
+    for (i = 0; i < batch.jobCount; i++) {
+        samples += batch.jobs[i].summary.samples;
+        if (!batch.jobs[i].summary.valid)
+            failures++;
+    }
+
+    fprintf(stderr, "%zu logs, %zu failed, %zu samples in %.2f s on %zu workers, %.0f samples/s\n",
+            batch.jobCount, failures, samples, elapsed, workers,
+            (0 < elapsed) ? samples / elapsed : 0.0);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/******************************* END OF FILE ***********************************/
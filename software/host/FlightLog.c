@@ -0,0 +1,238 @@
+/**
+ * @file FlightLog.c
+ * @brief Flight log loading and replay through the signal chain, shared by
+ *        the host tools.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "FlightLog.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/* Column of the pressure altitude in an IGC B record. */
+#define IGC_PRESSURE_ALTITUDE_OFFSET                                           25
+#define IGC_PRESSURE_ALTITUDE_LENGTH                                            5
+#define IGC_SECONDS_PER_DAY                                                 86400
+
+#define FLIGHT_LOG_INITIAL_CAPACITY                                          4096
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static bool hasSuffix(const char *name, const char *suffix) {
+    size_t nameLength = strlen(name);
+    size_t suffixLength = strlen(suffix);
+    return (suffixLength <= nameLength) &&
+           (0 == strcasecmp(name + nameLength - suffixLength, suffix));
+}
+
+static bool readTextTrace(FILE *file, struct FlightLog_s *log) {
+    char line[FLIGHT_LOG_LINE_LENGTH];
+
+    while (NULL != fgets(line, sizeof(line), file)) {
+        unsigned long time, pressure;
+        if ('#' == line[0])
+            continue;
+        if (2 != sscanf(line, "%lu %lu", &time, &pressure))
+            continue;
+        if (!FlightLog_Append(log, (uint32_t)time, (uint32_t)pressure))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Read the B records and interpolate linearly between the fixes, so the
+ * chain sees the sample rate of the sensor. Passing midnight is handled.
+ */
+static bool readIgcTrace(FILE *file, struct FlightLog_s *log) {
+    char line[FLIGHT_LOG_LINE_LENGTH];
+    bool first = true;
+    uint32_t lastTime = 0;
+    uint32_t nextTime = 0;
+    uint32_t dayOffset = 0;
+    double lastPressure = 0;
+
+    while (NULL != fgets(line, sizeof(line), file)) {
+        unsigned hours, minutes, seconds;
+        char field[IGC_PRESSURE_ALTITUDE_LENGTH + 1];
+
+        if (('B' != line[0]) ||
+            (strlen(line) < IGC_PRESSURE_ALTITUDE_OFFSET + IGC_PRESSURE_ALTITUDE_LENGTH) ||
+            (3 != sscanf(line + 1, "%2u%2u%2u", &hours, &minutes, &seconds)))
+            continue;
+
+        memcpy(field, line + IGC_PRESSURE_ALTITUDE_OFFSET, IGC_PRESSURE_ALTITUDE_LENGTH);
+        field[IGC_PRESSURE_ALTITUDE_LENGTH] = '\0';
+        double pressure = FlightLog_AltitudeToPressure(atoi(field));
+
+        uint32_t time = ((hours * 60 + minutes) * 60 + seconds + dayOffset) * 1000;
+        if (!first && (time < lastTime)) {
+            dayOffset += IGC_SECONDS_PER_DAY;
+            time += IGC_SECONDS_PER_DAY * 1000;
+        }
+
+        if (first) {
+            lastTime = nextTime = time;
+            lastPressure = pressure;
+            first = false;
+        }
+
+        /* Fixes with the same time stamp emit nothing. */
+        for (; nextTime <= time; nextTime += FLIGHT_LOG_SAMPLE_PERIOD) {
+            double p = (nextTime == lastTime) ? pressure :
+                    lastPressure + (pressure - lastPressure) * (nextTime - lastTime) / (time - lastTime);
+            if (!FlightLog_Append(log, nextTime, (uint32_t)lround(p)))
+                return false;
+        }
+
+        lastTime = time;
+        lastPressure = pressure;
+    }
+
+    return true;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+bool FlightLog_Read(const char *path, struct FlightLog_s *log) {
+    memset(log, 0, sizeof(*log));
+
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    bool result = hasSuffix(path, ".igc") ? readIgcTrace(file, log) : readTextTrace(file, log);
+    fclose(file);
+
+    if (!result) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        FlightLog_Free(log);
+    }
+    return result;
+}
+
+void FlightLog_Free(struct FlightLog_s *log) {
+    free(log->time);
+    free(log->pressure);
+    memset(log, 0, sizeof(*log));
+}
+
+size_t FlightLog_Replay(
+        const struct FlightLog_s *log,
+        const struct FlightReplayConfig_s *config,
+        struct FlightRow_s *rows) {
+    struct SignalChain_s chain;
+    BeepControlState_t state = BEEP_DISABLED;
+    size_t count = 0;
+    size_t i;
+
+    SignalChain_Init(&chain, &config->chain);
+
+    for (i = 0; i < log->count; i++) {
+        struct SignalChainOutput_s output;
+        if (!SignalChain_Process(&chain, log->pressure[i], log->time[i], &output))
+            continue;
+
+        struct FlightRow_s *row = &rows[count++];
+        row->time = log->time[i];
+        row->vario = SignalChain_SelectVario(&output);
+        row->altitude = output.baroAltitude;
+        row->state = state = SignalChain_UpdateBeepState(&config->thresholds, state, row->vario);
+        row->toneStep = SignalChain_ToneStep(row->vario);
+
+        if ((BEEP_DISABLED == state) || (NULL == config->profile))
+            memset(&row->tone, 0, sizeof(row->tone));
+        else
+            ToneProfile_Evaluate(config->profile, row->toneStep * (100 / TONE_STEPS_PER_MPS), &row->tone);
+    }
+
+    return count;
+}
+
+void FlightLog_FormatRow(char *line, size_t size, const struct FlightRow_s *row) {
+    snprintf(line, size, "%u,%.4f,%.3f,%d,%d,%u,%u,%u\n",
+            (unsigned)row->time, row->vario, row->altitude, (int)row->state, (int)row->toneStep,
+            (unsigned)row->tone.frequency, (unsigned)row->tone.beepDuration,
+            (unsigned)row->tone.silenceDuration);
+}
+
+bool FlightLog_WriteRows(const char *path, const struct FlightRow_s *rows, size_t count) {
+    char line[FLIGHT_LOG_LINE_LENGTH];
+    size_t i;
+
+    FILE *file = fopen(path, "w");
+    if (NULL == file) {
+        fprintf(stderr, "%s: cannot create\n", path);
+        return false;
+    }
+
+    fputs("time_ms,vario,altitude,beep_state,tone_step,frequency,beep_ms,silence_ms\n", file);
+    for (i = 0; i < count; i++) {
+        FlightLog_FormatRow(line, sizeof(line), &rows[i]);
+        fputs(line, file);
+    }
+
+    return 0 == fclose(file);
+}
+
+bool FlightLog_Append(struct FlightLog_s *log, uint32_t time, uint32_t pressure) {
+    if (log->count == log->capacity) {
+        size_t capacity = log->capacity ? 2 * log->capacity : FLIGHT_LOG_INITIAL_CAPACITY;
+        uint32_t *t = realloc(log->time, capacity * sizeof(*t));
+        if (NULL == t)
+            return false;
+        log->time = t;
+        uint32_t *p = realloc(log->pressure, capacity * sizeof(*p));
+        if (NULL == p)
+            return false;
+        log->pressure = p;
+        log->capacity = capacity;
+    }
+
+    log->time[log->count] = time;
+    log->pressure[log->count] = pressure;
+    log->count++;
+    return true;
+}
+
+double FlightLog_AltitudeToPressure(double altitude) {
+    return 101325.0 * pow(1.0 - altitude / 44330.0, 1.0 / 0.1902);
+}
+
+const char *FlightLog_BaseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return (NULL != slash) ? slash + 1 : path;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,115 @@
+/**
+ * @file FlightLog.h
+ * @brief Flight log loading and replay through the signal chain, shared by
+ *        the host tools.
+ * @author Molnar Zoltan
+ */
+
+#ifndef FLIGHTLOG_H
+#define FLIGHTLOG_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "SignalChain.h"
+#include "ToneProfile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/** Two OSR 4096 conversions of the MS5611 driver, in ms. */
+#define FLIGHT_LOG_SAMPLE_PERIOD                                               20
+
+#define FLIGHT_LOG_LINE_LENGTH                                                256
+#define FLIGHT_LOG_PATH_LENGTH                                               1024
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct FlightLog_s {
+    size_t count;
+    size_t capacity;
+    uint32_t *time;             /**< ms. */
+    uint32_t *pressure;         /**< Pa. */
+};
+
+struct FlightReplayConfig_s {
+    struct SignalChainConfig_s chain;
+    struct BeepThresholds_s thresholds;
+    const volatile struct ToneProfile_s *profile;   /**< NULL skips the tone columns. */
+};
+
+/**
+ * One processed sample, as the beeper and the NMEA output see it.
+ */
+struct FlightRow_s {
+    uint32_t time;
+    float vario;
+    float altitude;
+    BeepControlState_t state;
+    int32_t toneStep;
+    struct ToneCurvePoint_s tone;   /**< Zero while the beeper is disabled. */
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Load a flight log, errors are reported on stderr.
+ * @brief Files ending in .igc are read as IGC, their B record pressure
+ *        altitudes are converted back to pressure and resampled to
+ *        FLIGHT_LOG_SAMPLE_PERIOD. Anything else is a trace of
+ *        "<time_ms> <pressure_pa> [temperature]" lines with '#' comments.
+ */
+bool FlightLog_Read(const char *path, struct FlightLog_s *log);
+
+void FlightLog_Free(struct FlightLog_s *log);
+
+/**
+ * Append a sample, used to build synthetic logs.
+ * @return false if out of memory.
+ */
+bool FlightLog_Append(struct FlightLog_s *log, uint32_t time, uint32_t pressure);
+
+/**
+ * ISA pressure of an altitude, the inverse of VarioKernels_PressureToAltitude().
+ */
+double FlightLog_AltitudeToPressure(double altitude);
+
+/**
+ * Run a fresh signal chain and beeper state machine over a whole log.
+ * @param[out] rows Room for log->count rows.
+ * @return Number of rows written.
+ */
+size_t FlightLog_Replay(
+        const struct FlightLog_s *log,
+        const struct FlightReplayConfig_s *config,
+        struct FlightRow_s *rows);
+
+/**
+ * Format a row as a CSV line with the trailing newline.
+ */
+void FlightLog_FormatRow(char *line, size_t size, const struct FlightRow_s *row);
+
+/**
+ * Write rows as CSV with a header line, errors are reported on stderr.
+ */
+bool FlightLog_WriteRows(const char *path, const struct FlightRow_s *rows, size_t count);
+
+const char *FlightLog_BaseName(const char *path);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,266 @@
+/**
+ * @file FlightReplay.c
+ * @brief Deterministic flight log replay through the firmware signal chain.
+ * @author Molnar Zoltan
+ *
+ * Usage: flight_replay [-o outdir] [-g goldendir [-u]] [-p profile]
+ *                      [-v tolerance] [-a tolerance] log...
+ *
+ * Every log runs through the same SignalChain code as the firmware, from a
+ * fresh filter state, and produces one CSV row per processed sample:
+ *   time_ms,vario,altitude,beep_state,tone_step,frequency,beep_ms,silence_ms
+ * vario and altitude are the values the beeper and the NMEA output see,
+ * the tone columns are 0 while the beeper is disabled.
+ *
+ * Logs are either traces, "<time_ms> <pressure_pa> [temperature]" per line
+ * with '#' comments, or IGC files (*.igc) whose B record pressure altitudes
+ * are converted back to pressure and resampled to the sensor rate.
+ *
+ * With -g every output is compared against <goldendir>/<log>.csv. vario
+ * and altitude have to match within the tolerances, the beeper columns
+ * exactly. -u rewrites the golden files instead. The exit code is nonzero
+ * if any log fails. The time spent in the signal chain over all logs is
+ * reported at the end.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "FlightLog.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define REPLAY_DEFAULT_VARIO_TOLERANCE                                    (0.005)
+#define REPLAY_DEFAULT_ALTITUDE_TOLERANCE                                  (0.01)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct ReplayOptions_s {
+    const char *outputDir;
+    const char *goldenDir;
+    bool updateGolden;
+    size_t profileIndex;
+    double varioTolerance;
+    double altitudeTolerance;
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static struct FlightReplayConfig_s replayConfig = {
+    {
+        SIGNAL_CHAIN_DEFAULT_ALPHA,
+        SIGNAL_CHAIN_DEFAULT_BETA,
+        SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH
+    },
+    {
+        BEEP_DEFAULT_LIFT_THRESHOLD,
+        BEEP_DEFAULT_LIFT_OFF_THRESHOLD,
+        BEEP_DEFAULT_SINK_THRESHOLD,
+        BEEP_DEFAULT_SINK_OFF_THRESHOLD
+    },
+    NULL
+};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Compare the rows against a golden file, the first mismatch is reported.
+ */
+static bool compareRows(
+        const char *path,
+        const struct FlightRow_s *rows,
+        size_t count,
+        const struct ReplayOptions_s *options) {
+    char line[FLIGHT_LOG_LINE_LENGTH];
+    size_t i = 0;
+    bool header = true;
+
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "%s: no golden output\n", path);
+        return false;
+    }
+
+    while (NULL != fgets(line, sizeof(line), file)) {
+        unsigned time, frequency, beep, silence;
+        double vario, altitude;
+        int state, step;
+
+        if (header) {
+            header = false;
+            continue;
+        }
+
+        if (8 != sscanf(line, "%u,%lf,%lf,%d,%d,%u,%u,%u",
+                &time, &vario, &altitude, &state, &step, &frequency, &beep, &silence)) {
+            fprintf(stderr, "%s:%zu: malformed row\n", path, i + 2);
+            break;
+        }
+
+        if (count <= i) {
+            fprintf(stderr, "%s: output ends at row %zu\n", path, i + 2);
+            break;
+        }
+
+        const struct FlightRow_s *row = &rows[i];
+        if ((time != row->time) ||
+            (options->varioTolerance < fabs(vario - row->vario)) ||
+            (options->altitudeTolerance < fabs(altitude - row->altitude)) ||
+            (state != (int)row->state) || (step != row->toneStep) ||
+            (frequency != row->tone.frequency) || (beep != row->tone.beepDuration) ||
+            (silence != row->tone.silenceDuration)) {
+            FlightLog_FormatRow(line, sizeof(line), row);
+            fprintf(stderr, "%s:%zu: mismatch, got %s", path, i + 2, line);
+            break;
+        }
+
+        i++;
+    }
+
+    bool matched = feof(file) && (i == count);
+    if (feof(file) && (i < count))
+        fprintf(stderr, "%s: golden output ends at row %zu\n", path, i + 2);
+
+    fclose(file);
+    return matched;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-o outdir] [-g goldendir [-u]] [-p profile] [-v tolerance] [-a tolerance] log...\n"
+            "  -o  write <outdir>/<log>.csv\n"
+            "  -g  compare against <goldendir>/<log>.csv\n"
+            "  -u  rewrite the golden outputs instead of comparing\n"
+            "  -p  tone profile index, default 0\n"
+            "  -v  vario tolerance in m/s, default %g\n"
+            "  -a  altitude tolerance in m, default %g\n",
+            name, REPLAY_DEFAULT_VARIO_TOLERANCE, REPLAY_DEFAULT_ALTITUDE_TOLERANCE);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    struct ReplayOptions_s options = {
+        NULL, NULL, false, 0, REPLAY_DEFAULT_VARIO_TOLERANCE, REPLAY_DEFAULT_ALTITUDE_TOLERANCE
+    };
+    size_t totalSamples = 0;
+    size_t failures = 0;
+    double elapsed = 0;
+    int opt;
+    int i;
+
+    while (-1 != (opt = getopt(argc, argv, "o:g:up:v:a:"))) {
+        switch (opt) {
+        case 'o':
+            options.outputDir = optarg;
+            break;
+        case 'g':
+            options.goldenDir = optarg;
+            break;
+        case 'u':
+            options.updateGolden = true;
+            break;
+        case 'p':
+            options.profileIndex = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            options.varioTolerance = strtod(optarg, NULL);
+            break;
+        case 'a':
+            options.altitudeTolerance = strtod(optarg, NULL);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((optind == argc) || (options.updateGolden && (NULL == options.goldenDir))) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    replayConfig.profile = ToneProfile_Get(options.profileIndex);
+    if (NULL == replayConfig.profile) {
+        fprintf(stderr, "no tone profile %zu\n", options.profileIndex);
+        return EXIT_FAILURE;
+    }
+
+    for (i = optind; i < argc; i++) {
+        struct FlightLog_s log;
+        char path[FLIGHT_LOG_PATH_LENGTH];
+        bool passed = true;
+
+        if (!FlightLog_Read(argv[i], &log)) {
+            failures++;
+            continue;
+        }
+
+        struct FlightRow_s *rows = malloc((log.count + 1) * sizeof(*rows));
+        if (NULL == rows) {
+            fprintf(stderr, "%s: out of memory\n", argv[i]);
+            FlightLog_Free(&log);
+            failures++;
+            continue;
+        }
+
+        double start = now();
+        size_t count = FlightLog_Replay(&log, &replayConfig, rows);
+        elapsed += now() - start;
+        totalSamples += log.count;
+
+        if (NULL != options.outputDir) {
+            snprintf(path, sizeof(path), "%s/%s.csv", options.outputDir, FlightLog_BaseName(argv[i]));
+            passed = FlightLog_WriteRows(path, rows, count) && passed;
+        }
+
+        if (NULL != options.goldenDir) {
+            snprintf(path, sizeof(path), "%s/%s.csv", options.goldenDir, FlightLog_BaseName(argv[i]));
+            if (options.updateGolden)
+                passed = FlightLog_WriteRows(path, rows, count) && passed;
+            else
+                passed = compareRows(path, rows, count, &options) && passed;
+        }
+
+        printf("%-40s %8zu samples %s\n", FlightLog_BaseName(argv[i]), log.count, passed ? "ok" : "FAILED");
+        if (!passed)
+            failures++;
+
+        free(rows);
+        FlightLog_Free(&log);
+    }
+
+    printf("%d logs, %zu samples, %zu failed, %.1f ns per sample\n",
+            argc - optind, totalSamples, failures,
+            totalSamples ? elapsed / totalSamples : 0.0);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,262 @@
+/**
+ * @file KernelBenchmark.c
+ * @brief Host microbenchmark of the signal chain kernels.
+ * @author Molnar Zoltan
+ *
+ * Usage: kernel_benchmark [samples]
+ *
+ * Every kernel runs over the same synthetic flight, a slow climb with
+ * sensor noise, and the best of BENCH_ROUNDS rounds is reported in ns per
+ * sample or per sentence. The numbers are host relative, they are a
+ * regression baseline and not an estimate of the Cortex-M3 cost.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "SignalChain.h"
+#include "VarioKernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define BENCH_ROUNDS                                                            5
+#define BENCH_DEFAULT_SAMPLES                                              200000
+
+/* Sample period of the synthetic flight, ms. */
+#define SAMPLING_TIME                                                          25
+
+#define NMEA_LENGTH                                                           150
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct BenchData_s {
+    size_t count;
+    uint32_t *d1;
+    uint32_t *d2;
+    float *pressure;
+    float *altitude;
+};
+
+typedef float (*BenchKernel_t)(const struct BenchData_s *data);
+
+struct Benchmark_s {
+    const char *name;
+    const char *unit;
+    BenchKernel_t kernel;
+    size_t skipped;             /**< Leading samples without a kernel call. */
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+/* Example calibration of the MS5611 datasheet. */
+static const struct Ms5611Calibration_s calibration = {
+    40127, 36924, 23317, 23282, 33464, 28312
+};
+
+/* Keeps the compiler from dropping the benchmarked work. */
+static volatile float sink;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t nextRandom(uint32_t *state) {
+    *state = *state * 1664525UL + 1013904223UL;
+    return *state >> 8;
+}
+
+/**
+ * Raw conversion results around the datasheet example, pressure falls by
+ * 3 Pa per second with about 2 Pa of noise.
+ */
+static void generateFlight(struct BenchData_s *data) {
+    uint32_t state = 1;
+    size_t i;
+
+    for (i = 0; i < data->count; i++) {
+        int32_t trend = (int32_t)(i * SAMPLING_TIME * 3 / 1000) * 64;
+        int32_t noise = (int32_t)(nextRandom(&state) % 256) - 128;
+        data->d1[i] = (uint32_t)(9085466 - trend + noise);
+        data->d2[i] = 8569150 + nextRandom(&state) % 16;
+
+        uint32_t pressure;
+        int32_t temperature;
+        VarioKernels_CompensateMs5611(&calibration, data->d1[i], data->d2[i], &pressure, &temperature);
+        data->pressure[i] = pressure;
+        data->altitude[i] = VarioKernels_PressureToAltitude(pressure);
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static float benchCompensation(const struct BenchData_s *data) {
+    uint32_t sum = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++) {
+        uint32_t pressure;
+        int32_t temperature;
+        VarioKernels_CompensateMs5611(&calibration, data->d1[i], data->d2[i], &pressure, &temperature);
+        sum += pressure + (uint32_t)temperature;
+    }
+    return (float)sum;
+}
+
+static float benchFilter(const struct BenchData_s *data) {
+    float position = data->pressure[0];
+    float velocity = 0;
+    float sum = 0;
+    size_t i;
+    for (i = 1; i < data->count; i++)
+        sum += VarioKernels_AlphaBetaFilter(SIGNAL_CHAIN_DEFAULT_ALPHA, SIGNAL_CHAIN_DEFAULT_BETA,
+                &position, &velocity, data->pressure[i], SAMPLING_TIME);
+    return sum;
+}
+
+static float benchAltitude(const struct BenchData_s *data) {
+    float sum = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++)
+        sum += VarioKernels_PressureToAltitude(data->pressure[i]);
+    return sum;
+}
+
+static float benchPressureRate(const struct BenchData_s *data) {
+    float sum = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++)
+        sum += VarioKernels_PressureRateToVario(data->pressure[i], -0.003f);
+    return sum;
+}
+
+/**
+ * Regression over the last SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH altitudes, as
+ * done for every sample.
+ */
+static float benchSlope(const struct BenchData_s *data) {
+    const size_t length = SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH;
+    float sum = 0;
+    size_t i;
+    for (i = length; i < data->count; i++)
+        sum += VarioKernels_Slope(&data->altitude[i - length], length, 0, length, SAMPLING_TIME / 1000.0);
+    return sum;
+}
+
+static float benchLxwp0(const struct BenchData_s *data) {
+    char nmea[NMEA_LENGTH];
+    struct Lxwp0Data_s sentence = {0, 0, 5.5f, 270, true};
+    size_t length = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++) {
+        sentence.baroAltitude = data->altitude[i];
+        sentence.vario = (float)(i % 1000) / 100 - 5;
+        sentence.windValid = (0 != (i & 1));
+        length += VarioKernels_FormatLxwp0(nmea, sizeof(nmea), &sentence);
+    }
+    return (float)length;
+}
+
+/**
+ * Reference: the same sentence with the C library formatter.
+ */
+static float benchLxwp0Printf(const struct BenchData_s *data) {
+    char nmea[NMEA_LENGTH];
+    size_t length = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++) {
+        float vario = (float)(i % 1000) / 100 - 5;
+        int n = snprintf(nmea, sizeof(nmea), "$LXWP0,N,,%.2f,%.2f,,,,,,,%d,%.1f",
+                data->altitude[i], vario, 270, 5.5f * 3.6f);
+        uint8_t crc = 0;
+        int j;
+        for (j = 1; j < n; j++)
+            crc ^= (uint8_t)nmea[j];
+        length += (size_t)(n + snprintf(nmea + n, sizeof(nmea) - (size_t)n, "*%02X", crc));
+    }
+    return (float)length;
+}
+
+static float benchThermalCore(const struct BenchData_s *data) {
+    char nmea[NMEA_LENGTH];
+    size_t length = 0;
+    size_t i;
+    for (i = 0; i < data->count; i++)
+        length += VarioKernels_FormatThermalCore(nmea, sizeof(nmea), (float)(i % 360), 120, 1.5f);
+    return (float)length;
+}
+
+static const struct Benchmark_s benchmarks[] = {
+    {"compensation",   "sample",   benchCompensation, 0},
+    {"filter",         "sample",   benchFilter,       1},
+    {"altitude",       "sample",   benchAltitude,     0},
+    {"pressure rate",  "sample",   benchPressureRate, 0},
+    {"slope",          "sample",   benchSlope,        SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH},
+    {"nmea lxwp0",     "sentence", benchLxwp0,        0},
+    {"nmea lxwp0 ref", "sentence", benchLxwp0Printf,  0},
+    {"nmea pvthc",     "sentence", benchThermalCore,  0},
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    struct BenchData_s data;
+    size_t i, round;
+
+    data.count = (1 < argc) ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_SAMPLES;
+    if (data.count <= SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH) {
+        fprintf(stderr, "sample count has to be more than %d\n", SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH);
+        return EXIT_FAILURE;
+    }
+
+    data.d1 = malloc(data.count * sizeof(*data.d1));
+    data.d2 = malloc(data.count * sizeof(*data.d2));
+    data.pressure = malloc(data.count * sizeof(*data.pressure));
+    data.altitude = malloc(data.count * sizeof(*data.altitude));
+    if (!data.d1 || !data.d2 || !data.pressure || !data.altitude) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    generateFlight(&data);
+
+    printf("%-16s %12s  (best of %d rounds, %zu samples)\n", "kernel", "ns", BENCH_ROUNDS, data.count);
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        double best = 0;
+        for (round = 0; round < BENCH_ROUNDS; round++) {
+            double start = now();
+            sink = benchmarks[i].kernel(&data);
+            double elapsed = now() - start;
+            if ((0 == round) || (elapsed < best))
+                best = elapsed;
+        }
+        printf("%-16s %12.1f  per %s\n", benchmarks[i].name,
+                best / (data.count - benchmarks[i].skipped), benchmarks[i].unit);
+    }
+
+    free(data.d1);
+    free(data.d2);
+    free(data.pressure);
+    free(data.altitude);
+
+    return EXIT_SUCCESS;
+}
+
+/******************************* END OF FILE ***********************************/
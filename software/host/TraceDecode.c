@@ -0,0 +1,421 @@
+/**
+ * @file TraceDecode.c
+ * @brief Decoder of the trace ring dumps into a timeline.
+ * @author Molnar Zoltan
+ *
+ * Usage: trace_decode [-s] capture...
+ *
+ * A capture is the raw byte stream of the Kobo link of a USE_TRACE_RING
+ * build, NMEA sentences in between the frames are skipped, "-" reads stdin.
+ * Every dump is printed as a timeline, one event per line with the time
+ * since the oldest record, the running thread and the event:
+ *   <time us> <+delta us> <thread> <event> [detail]
+ * followed by a summary: the CPU share of the threads, the interrupt and
+ * event counts, the sample handoff and processing latencies and the waits
+ * on SignalProcessorMutex. -s prints only the summaries.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "TraceFormat.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define DECODE_MAX_THREADS                                                     16
+#define DECODE_MAX_RECORDS                                                  65536
+#define DECODE_NAME_LENGTH                                                     32
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct DecodeThread_s {
+    uint16_t id;
+    uint8_t priority;
+    char name[DECODE_NAME_LENGTH + 1];
+    double runTime;                         /* us */
+};
+
+/** Latency statistics of one path, us. */
+struct DecodeLatency_s {
+    size_t count;
+    double sum;
+    double max;
+};
+
+struct TraceDump_s {
+    uint32_t clockHz;
+    uint32_t overwritten;
+    size_t expected;
+    size_t threadCount;
+    struct DecodeThread_s threads[DECODE_MAX_THREADS];
+    size_t recordCount;
+    struct TraceRecord_s records[DECODE_MAX_RECORDS];
+};
+
+struct FrameReader_s {
+    FILE *file;
+    size_t badFrames;
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char * const eventNames[TRACE_EVENT_COUNT] = {
+    "?",
+    "switch",
+    "isr-beep",
+    "isr-button",
+    "serial-in",
+    "sample-send",
+    "sample-recv",
+    "calc-done",
+    "nmea-ready",
+    "mutex-wait",
+    "mutex-got"
+};
+
+static struct TraceDump_s dump;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint16_t get16(const uint8_t *buffer) {
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *buffer) {
+    return get16(buffer) | ((uint32_t)get16(buffer + 2) << 16);
+}
+
+/**
+ * Read the next valid frame, bytes outside frames are skipped.
+ * @return false at the end of the file.
+ */
+static bool readFrame(struct FrameReader_s *reader, uint8_t *type, uint8_t *payload, size_t *length) {
+    int previous = EOF;
+    int c;
+
+    while (EOF != (c = fgetc(reader->file))) {
+        if ((TRACE_SYNC_0 != previous) || (TRACE_SYNC_1 != c)) {
+            previous = c;
+            continue;
+        }
+        previous = EOF;
+
+        int frameType = fgetc(reader->file);
+        int frameLength = fgetc(reader->file);
+        if ((EOF == frameType) || (EOF == frameLength))
+            return false;
+        if (fread(payload, 1, (size_t)frameLength, reader->file) != (size_t)frameLength)
+            return false;
+        int check = fgetc(reader->file);
+        if (EOF == check)
+            return false;
+
+        uint8_t sum = (uint8_t)(frameType ^ frameLength);
+        int i;
+        for (i = 0; i < frameLength; i++)
+            sum ^= payload[i];
+        if (sum != check) {
+            reader->badFrames++;
+            continue;
+        }
+
+        *type = (uint8_t)frameType;
+        *length = (size_t)frameLength;
+        return true;
+    }
+
+    return false;
+}
+
+static struct DecodeThread_s *findThread(struct TraceDump_s *data, uint16_t id) {
+    size_t i;
+
+    for (i = 0; i < data->threadCount; i++) {
+        if (id == data->threads[i].id)
+            return &data->threads[i];
+    }
+
+    return NULL;
+}
+
+static const char *threadName(const struct DecodeThread_s *thread) {
+    return (NULL != thread) ? thread->name : "?";
+}
+
+static void addLatency(struct DecodeLatency_s *latency, double value) {
+    latency->count++;
+    latency->sum += value;
+    if (latency->max < value)
+        latency->max = value;
+}
+
+static void printLatency(const char *name, const struct DecodeLatency_s *latency) {
+    if (0 == latency->count)
+        return;
+    printf("  %-26s %6zu  mean %9.1f us  max %9.1f us\n",
+            name, latency->count, latency->sum / latency->count, latency->max);
+}
+
+static void formatDetail(const struct TraceDump_s *data, const struct TraceRecord_s *record,
+        char *buffer, size_t size) {
+    buffer[0] = '\0';
+
+    switch (record->event) {
+    case TRACE_SWITCH:
+    case TRACE_MUTEX_CONTENDED: {
+        const struct DecodeThread_s *thread = findThread((struct TraceDump_s *)data, record->value);
+        snprintf(buffer, size, "%s", threadName(thread));
+        break;
+    }
+    case TRACE_ISR_BUTTON:
+        snprintf(buffer, size, "level %u", record->arg);
+        break;
+    case TRACE_SERIAL_INPUT:
+        snprintf(buffer, size, "%u bytes", record->value);
+        break;
+    case TRACE_SAMPLE_SEND:
+    case TRACE_SAMPLE_RECEIVE:
+        snprintf(buffer, size, "%u Pa mod 65536", record->value);
+        break;
+    case TRACE_CALCULATION_FINISHED:
+        if (0 != record->arg)
+            snprintf(buffer, size, "flags 0x%02x", record->arg);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Print the timeline and the summary of a complete dump.
+ */
+static void decodeDump(struct TraceDump_s *data, size_t index, bool summaryOnly) {
+    struct DecodeLatency_s handoff = {0, 0, 0};
+    struct DecodeLatency_s processing = {0, 0, 0};
+    struct DecodeLatency_s mutexWait = {0, 0, 0};
+    size_t counts[TRACE_EVENT_COUNT] = {0};
+    struct DecodeThread_s *running = NULL;
+    double time = 0, previousTime = 0, switchTime = 0;
+    double sendTime = -1, receiveTime = -1, waitTime = -1;
+    double ticksPerUs = data->clockHz / 1e6;
+    size_t i;
+
+    printf("# dump %zu: %zu of %zu events, %u overwritten before, clock %u Hz\n",
+            index, data->recordCount, data->expected,
+            (unsigned)data->overwritten, (unsigned)data->clockHz);
+
+    for (i = 0; i < data->recordCount; i++) {
+        const struct TraceRecord_s *record = &data->records[i];
+        char detail[64];
+
+        if (0 < i)
+            time += (uint32_t)(record->time - data->records[i - 1].time) / ticksPerUs;
+        if (record->event < TRACE_EVENT_COUNT)
+            counts[record->event]++;
+
+        if (!summaryOnly) {
+            formatDetail(data, record, detail, sizeof(detail));
+            printf("%12.1f %+10.1f  %-22s %-12s %s\n",
+                    time, time - previousTime, threadName(running),
+                    (record->event < TRACE_EVENT_COUNT) ? eventNames[record->event] : "?",
+                    detail);
+        }
+        previousTime = time;
+
+        switch (record->event) {
+        case TRACE_SWITCH:
+            if (NULL != running)
+                running->runTime += time - switchTime;
+            running = findThread(data, record->value);
+            switchTime = time;
+            break;
+        case TRACE_SAMPLE_SEND:
+            sendTime = time;
+            break;
+        case TRACE_SAMPLE_RECEIVE:
+            if (0 <= sendTime)
+                addLatency(&handoff, time - sendTime);
+            receiveTime = time;
+            sendTime = -1;
+            break;
+        case TRACE_CALCULATION_FINISHED:
+            if (0 <= receiveTime)
+                addLatency(&processing, time - receiveTime);
+            receiveTime = -1;
+            break;
+        case TRACE_MUTEX_CONTENDED:
+            waitTime = time;
+            break;
+        case TRACE_MUTEX_ACQUIRED:
+            if (0 <= waitTime)
+                addLatency(&mutexWait, time - waitTime);
+            waitTime = -1;
+            break;
+        default:
+            break;
+        }
+    }
+    if (NULL != running)
+        running->runTime += time - switchTime;
+
+    printf("# summary of dump %zu, %.1f ms\n", index, time / 1000);
+    for (i = 0; i < data->threadCount; i++) {
+        const struct DecodeThread_s *thread = &data->threads[i];
+        printf("  %-26s prio %3u  %9.1f us %5.1f %%\n",
+                thread->name, thread->priority, thread->runTime,
+                (0 < time) ? 100 * thread->runTime / time : 0.0);
+    }
+    for (i = 1; i < TRACE_EVENT_COUNT; i++) {
+        if (0 < counts[i])
+            printf("  %-26s %6zu\n", eventNames[i], counts[i]);
+    }
+    printLatency("sample handoff", &handoff);
+    printLatency("sample processing", &processing);
+    printLatency("SignalProcessorMutex wait", &mutexWait);
+}
+
+/**
+ * Decode all dumps of a capture.
+ * @return Number of dumps.
+ */
+static size_t decodeCapture(FILE *file, const char *name, bool summaryOnly, size_t dumps) {
+    struct FrameReader_s reader = {file, 0};
+    uint8_t payload[256];
+    uint8_t type;
+    size_t length;
+    bool inDump = false;
+
+    while (readFrame(&reader, &type, payload, &length)) {
+        switch (type) {
+        case TRACE_FRAME_HEADER:
+            if ((11 > length) || (TRACE_FORMAT_VERSION != payload[0])) {
+                fprintf(stderr, "%s: unsupported trace version\n", name);
+                inDump = false;
+                break;
+            }
+            memset(&dump, 0, sizeof(dump) - sizeof(dump.records));
+            dump.clockHz = get32(payload + 1);
+            dump.expected = get16(payload + 5);
+            dump.overwritten = get32(payload + 7);
+            inDump = (0 < dump.clockHz);
+            break;
+        case TRACE_FRAME_THREAD:
+            if (inDump && (3 <= length) && (dump.threadCount < DECODE_MAX_THREADS)) {
+                struct DecodeThread_s *thread = &dump.threads[dump.threadCount++];
+                size_t nameLength = length - 3;
+                if (DECODE_NAME_LENGTH < nameLength)
+                    nameLength = DECODE_NAME_LENGTH;
+                thread->id = get16(payload);
+                thread->priority = payload[2];
+                memcpy(thread->name, payload + 3, nameLength);
+                thread->name[nameLength] = '\0';
+                if (0 == nameLength)
+                    snprintf(thread->name, sizeof(thread->name), "%04x", thread->id);
+            }
+            break;
+        case TRACE_FRAME_EVENTS: {
+            size_t offset;
+            for (offset = 0; inDump && (offset + TRACE_RECORD_SIZE <= length); offset += TRACE_RECORD_SIZE) {
+                if (DECODE_MAX_RECORDS == dump.recordCount)
+                    break;
+                struct TraceRecord_s *record = &dump.records[dump.recordCount++];
+                record->time = get32(payload + offset);
+                record->event = payload[offset + 4];
+                record->arg = payload[offset + 5];
+                record->value = get16(payload + offset + 6);
+            }
+            break;
+        }
+        case TRACE_FRAME_END:
+            if (inDump)
+                decodeDump(&dump, ++dumps, summaryOnly);
+            inDump = false;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (inDump)
+        fprintf(stderr, "%s: last dump is truncated\n", name);
+    if (0 < reader.badFrames)
+        fprintf(stderr, "%s: %zu frames with a bad check\n", name, reader.badFrames);
+
+    return dumps;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-s] capture...\n"
+            "  -s  print only the summaries\n"
+            "  a capture of \"-\" is read from stdin\n",
+            name);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    bool summaryOnly = false;
+    size_t dumps = 0;
+    int failures = 0;
+    int opt;
+    int i;
+
+    while (-1 != (opt = getopt(argc, argv, "s"))) {
+        switch (opt) {
+        case 's':
+            summaryOnly = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind == argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = optind; i < argc; i++) {
+        bool isStdin = (0 == strcmp(argv[i], "-"));
+        FILE *file = isStdin ? stdin : fopen(argv[i], "rb");
+
+        if (NULL == file) {
+            perror(argv[i]);
+            failures++;
+            continue;
+        }
+
+        dumps = decodeCapture(file, argv[i], summaryOnly, dumps);
+        if (!isStdin)
+            fclose(file);
+    }
+
+    if (0 == dumps)
+        fprintf(stderr, "no trace dumps found\n");
+
+    return ((0 == failures) && (0 < dumps)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,193 @@
+/**
+ * @file WorkPool.c
+ * @brief Work stealing thread pool of the host tools.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "WorkPool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Remaining task indices of a worker, [next, end). The owner takes from the
+ * front, thieves cut off the back.
+ */
+struct WorkShare_s {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+};
+
+struct WorkPool_s {
+    size_t workerCount;
+    struct WorkShare_s *shares;
+    WorkPoolTask_t task;
+    void *arg;
+};
+
+struct Worker_s {
+    struct WorkPool_s *pool;
+    size_t index;
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static bool takeTask(struct WorkShare_s *share, size_t *task) {
+    bool taken = false;
+
+    pthread_mutex_lock(&share->lock);
+    if (share->next < share->end) {
+        *task = share->next++;
+        taken = true;
+    }
+    pthread_mutex_unlock(&share->lock);
+
+    return taken;
+}
+
+/**
+ * Move the upper half of the largest other share to the own share.
+ * @return false if there is nothing left to steal.
+ */
+static bool stealTasks(struct WorkPool_s *pool, size_t self) {
+    size_t victim = self;
+    size_t largest = 0;
+    size_t i;
+
+    /* The sizes may change before the victim is locked again, they are a hint. */
+    for (i = 0; i < pool->workerCount; i++) {
+        if (i == self)
+            continue;
+        pthread_mutex_lock(&pool->shares[i].lock);
+        size_t remaining = pool->shares[i].end - pool->shares[i].next;
+        pthread_mutex_unlock(&pool->shares[i].lock);
+        if (largest < remaining) {
+            largest = remaining;
+            victim = i;
+        }
+    }
+
+    if (victim == self)
+        return false;
+
+    struct WorkShare_s *share = &pool->shares[victim];
+    size_t begin, end;
+
+    pthread_mutex_lock(&share->lock);
+    end = share->end;
+    begin = (share->next < end) ? end - (end - share->next + 1) / 2 : end;
+    share->end = begin;
+    pthread_mutex_unlock(&share->lock);
+
+    if (begin == end)
+        return true;
+
+    share = &pool->shares[self];
+    pthread_mutex_lock(&share->lock);
+    share->next = begin;
+    share->end = end;
+    pthread_mutex_unlock(&share->lock);
+
+    return true;
+}
+
+static void *workerThread(void *arg) {
+    struct Worker_s *worker = (struct Worker_s *)arg;
+    struct WorkPool_s *pool = worker->pool;
+    size_t task;
+
+    do {
+        while (takeTask(&pool->shares[worker->index], &task))
+            pool->task(task, worker->index, pool->arg);
+    } while (stealTasks(pool, worker->index));
+
+    return NULL;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+size_t WorkPool_DefaultWorkers(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (0 < count) ? (size_t)count : 1;
+}
+
+bool WorkPool_Run(size_t taskCount, size_t workerCount, WorkPoolTask_t task, void *arg) {
+    struct WorkPool_s pool = {workerCount, NULL, task, arg};
+    size_t started = 0;
+    size_t i;
+
+    if (0 == taskCount)
+        return true;
+    if (0 == workerCount)
+        workerCount = pool.workerCount = 1;
+    if (taskCount < workerCount)
+        workerCount = pool.workerCount = taskCount;
+
+    pthread_t *threads = calloc(workerCount, sizeof(*threads));
+    struct Worker_s *workers = calloc(workerCount, sizeof(*workers));
+    pool.shares = calloc(workerCount, sizeof(*pool.shares));
+    if ((NULL == threads) || (NULL == workers) || (NULL == pool.shares)) {
+        free(threads);
+        free(workers);
+        free(pool.shares);
+        return false;
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        pthread_mutex_init(&pool.shares[i].lock, NULL);
+        pool.shares[i].next = taskCount * i / workerCount;
+        pool.shares[i].end = taskCount * (i + 1) / workerCount;
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+
+    /* Worker 0 is the calling thread. */
+    for (i = 1; i < workerCount; i++) {
+        if (0 != pthread_create(&threads[i], NULL, workerThread, &workers[i]))
+            break;
+        started++;
+    }
+
+    /* Tasks of workers that could not be started are stolen by the others. */
+    workerThread(&workers[0]);
+
+    for (i = 1; i <= started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < workerCount; i++)
+        pthread_mutex_destroy(&pool.shares[i].lock);
+
+    free(threads);
+    free(workers);
+    free(pool.shares);
+
+    return true;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,58 @@
+/**
+ * @file WorkPool.h
+ * @brief Work stealing thread pool of the host tools.
+ * @author Molnar Zoltan
+ */
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Task callback.
+ * @param[in] task Index of the task, 0 .. taskCount - 1.
+ * @param[in] worker Index of the worker running it, for per worker scratch.
+ */
+typedef void (*WorkPoolTask_t)(size_t task, size_t worker, void *arg);
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Number of online processors, at least 1.
+ */
+size_t WorkPool_DefaultWorkers(void);
+
+/**
+ * Run every task once and return when all of them are finished.
+ * @brief Each worker starts with a contiguous share of the task indices and
+ *        takes them in order. A worker that runs dry steals the upper half
+ *        of the largest remaining share, so uneven tasks still keep every
+ *        core busy. Putting the expensive tasks first helps the balance.
+ * @return false if the pool could not be allocated, no task has run then.
+ */
+bool WorkPool_Run(size_t taskCount, size_t workerCount, WorkPoolTask_t task, void *arg);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,88 @@
+##############################################################################
+# Host build of the RTOS independent signal chain.
+#
+# Builds the signal chain sources with the native compiler into a static
+# library and links the kernel benchmark and the flight log tools against
+# it, and the decoder of the firmware trace dumps. Invoked through the
+# host goals of the firmware Makefile, or directly with
+#   make -f host/host.mk [host|host-bench|host-replay|host-clean]
+# from the software directory.
+
+HOSTCC       ?= gcc
+HOSTAR       ?= ar
+HOSTBUILDDIR  = build/host
+
+HOSTCFLAGS   ?= -O2 -g
+HOSTCFLAGS   += -std=gnu99 -Wall -Wextra -Wundef -Wstrict-prototypes -Isource
+HOSTLDLIBS    = -lm
+
+HOSTLIBSRC    = source/VarioKernels.c source/SignalChain.c source/ToneProfile.c
+HOSTLIB       = $(HOSTBUILDDIR)/libvariokernels.a
+HOSTBENCH     = $(HOSTBUILDDIR)/kernel_benchmark
+HOSTREPLAY    = $(HOSTBUILDDIR)/flight_replay
+HOSTBATCH     = $(HOSTBUILDDIR)/flight_batch
+HOSTTUNER     = $(HOSTBUILDDIR)/flight_tuner
+HOSTTRACE     = $(HOSTBUILDDIR)/trace_decode
+
+# Code shared by the flight log tools.
+HOSTTOOLSRC   = host/FlightLog.c host/WorkPool.c
+HOSTTOOLOBJS  = $(addprefix $(HOSTBUILDDIR)/, $(notdir $(HOSTTOOLSRC:.c=.o)))
+
+# Benchmark sample count, can be overridden on the command line.
+BENCH_SAMPLES ?= 200000
+
+# Flight log corpus of host-replay, compared against the golden outputs.
+# replay/logs holds short synthetic traces and an IGC file covering still
+# air, climb, sink and gusts. The goldens were written with -u by the first
+# version of the replay, update them with
+#   make -f host/host.mk host-replay REPLAY_FLAGS=-u
+# only for intended changes of the chain or the beeper.
+REPLAY_LOGS   ?= $(wildcard replay/logs/*)
+REPLAY_GOLDEN ?= replay/golden
+REPLAY_FLAGS  ?=
+
+HOSTLIBOBJS   = $(addprefix $(HOSTBUILDDIR)/, $(notdir $(HOSTLIBSRC:.c=.o)))
+
+.PHONY: host host-bench host-replay host-clean
+
+host: $(HOSTBENCH) $(HOSTREPLAY) $(HOSTBATCH) $(HOSTTUNER) $(HOSTTRACE)
+
+host-bench: $(HOSTBENCH)
+	@$(HOSTBENCH) $(BENCH_SAMPLES)
+
+host-replay: $(HOSTREPLAY)
+ifeq ($(strip $(REPLAY_LOGS)),)
+	$(error host-replay: no flight logs, REPLAY_LOGS is empty and replay/logs has none)
+endif
+	@$(HOSTREPLAY) -g $(REPLAY_GOLDEN) $(REPLAY_FLAGS) $(REPLAY_LOGS)
+
+host-clean:
+	rm -rf $(HOSTBUILDDIR)
+
+$(HOSTBUILDDIR):
+	@mkdir -p $@
+
+$(HOSTBUILDDIR)/%.o: source/%.c source/%.h | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) -c $< -o $@
+
+$(HOSTBUILDDIR)/%.o: host/%.c host/%.h | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) -pthread -c $< -o $@
+
+$(HOSTLIB): $(HOSTLIBOBJS)
+	$(HOSTAR) rcs $@ $^
+
+$(HOSTBENCH): host/KernelBenchmark.c $(HOSTLIB) | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) $< $(HOSTLIB) $(HOSTLDLIBS) -o $@
+
+$(HOSTREPLAY): host/FlightReplay.c $(HOSTTOOLOBJS) $(HOSTLIB) | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) -pthread $< $(HOSTTOOLOBJS) $(HOSTLIB) $(HOSTLDLIBS) -o $@
+
+$(HOSTBATCH): host/FlightBatch.c $(HOSTTOOLOBJS) $(HOSTLIB) | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) -pthread $< $(HOSTTOOLOBJS) $(HOSTLIB) $(HOSTLDLIBS) -o $@
+
+# -O3 vectorizes the lane loops of the tuner.
+$(HOSTTUNER): host/FilterTuner.c $(HOSTTOOLOBJS) $(HOSTLIB) | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) -O3 -pthread $< $(HOSTTOOLOBJS) $(HOSTLIB) $(HOSTLDLIBS) -o $@
+
+$(HOSTTRACE): host/TraceDecode.c source/TraceFormat.h | $(HOSTBUILDDIR)
+	$(HOSTCC) $(HOSTCFLAGS) $< -o $@
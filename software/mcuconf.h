@@ -84,12 +84,26 @@
 #define STM32_EXT_EXTI18_IRQ_PRIORITY       6
 #define STM32_EXT_EXTI19_IRQ_PRIORITY       6
 
+/*
+ * Beeper cadence timer, TIM3 is a GPT unless it gates the TIM4 tone timer.
+ */
+#if !defined(BEEP_HW_GATE)
+#define BEEP_HW_GATE                        FALSE
+#endif
+
+/*
+ * DMA fed beeper, TIM4 update DMA on DMA1 channel 7.
+ */
+#if !defined(BEEP_SYNTH)
+#define BEEP_SYNTH                          FALSE
+#endif
+
 /*
  * GPT driver system settings.
  */
 #define STM32_GPT_USE_TIM1                  FALSE
 #define STM32_GPT_USE_TIM2                  FALSE
-#define STM32_GPT_USE_TIM3                  TRUE
+#define STM32_GPT_USE_TIM3                  !BEEP_HW_GATE
 #define STM32_GPT_USE_TIM4                  FALSE
 #define STM32_GPT_USE_TIM5                  FALSE
 #define STM32_GPT_USE_TIM8                  FALSE
@@ -134,7 +148,7 @@
 #define STM32_PWM_USE_ADVANCED              FALSE
 #define STM32_PWM_USE_TIM1                  FALSE
 #define STM32_PWM_USE_TIM2                  FALSE
-#define STM32_PWM_USE_TIM3                  FALSE
+#define STM32_PWM_USE_TIM3                  BEEP_HW_GATE
 #define STM32_PWM_USE_TIM4                  TRUE
 #define STM32_PWM_USE_TIM5                  FALSE
 #define STM32_PWM_USE_TIM8                  FALSE
@@ -0,0 +1,79 @@
+/**
+ * @file SimConfigStore.c
+ * @brief Settings store of the POSIX simulator build.
+ * @author Molnar Zoltan
+ *
+ * The flash log of ConfigStore.c needs the STM32 flash controller, the
+ * simulator keeps the values in RAM for the lifetime of the process.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ConfigStore.h"
+#include "ch.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static MUTEX_DECL(configMutex);
+
+static int32_t configValues[CONFIG_KEY_COUNT];
+static bool configValid[CONFIG_KEY_COUNT];
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void ConfigStore_Init(void)
+{
+}
+
+bool ConfigStore_Get(ConfigKey_t key, int32_t *value)
+{
+    if (CONFIG_KEY_COUNT <= key)
+        return false;
+
+    chMtxLock(&configMutex);
+    bool valid = configValid[key];
+    if (valid)
+        *value = configValues[key];
+    chMtxUnlock(&configMutex);
+
+    return valid;
+}
+
+bool ConfigStore_Set(ConfigKey_t key, int32_t value)
+{
+    if (CONFIG_KEY_COUNT <= key)
+        return false;
+
+    chMtxLock(&configMutex);
+    configValues[key] = value;
+    configValid[key] = true;
+    chMtxUnlock(&configMutex);
+
+    SimHal_Log("config %d %d", (int)key, (int)value);
+    return true;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,135 @@
+/**
+ * @file SimGps.c
+ * @brief GPS receiver emulation replaying an NMEA log into SD2.
+ * @author Molnar Zoltan
+ *
+ * Sentences are injected into the SD2 input queue the way the UART
+ * interrupt would, each line taking its wire time at GPS_BAUDRATE. The
+ * replay is paced by the UTC time field of GGA and RMC sentences, so a
+ * log recorded at any rate plays back in real time. UBX commands sent by
+ * the firmware are not answered, GPS_Start() falls back to its timeouts.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "gps.h"
+#include "ch.h"
+#include "hal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define SIM_GPS_LINE_LENGTH                                                   128
+/** Pause used when consecutive fixes are not in order, in ms. */
+#define SIM_GPS_DEFAULT_PERIOD                                               1000
+#define SIM_GPS_MAX_PERIOD                                                  10000
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static THD_WORKING_AREA(waSimGps, 1024);
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Get the UTC time of day of a GGA or RMC sentence in ms.
+ * @return -1 for other sentences and empty time fields.
+ */
+static int32_t parseFixTime(const char *line) {
+    if ((strlen(line) < 7) ||
+        ((0 != strncmp(line + 3, "GGA,", 4)) && (0 != strncmp(line + 3, "RMC,", 4))))
+        return -1;
+
+    const char *time = line + 7;
+    if (',' == time[0])
+        return -1;
+
+    double hhmmss = atof(time);
+    int32_t hours = (int32_t)(hhmmss / 10000);
+    int32_t minutes = (int32_t)(hhmmss / 100) % 100;
+    double seconds = hhmmss - hours * 10000 - minutes * 100;
+
+    return (hours * 3600 + minutes * 60) * 1000 + (int32_t)(seconds * 1000 + 0.5);
+}
+
+static void injectLine(const char *line) {
+    size_t i;
+
+    chSysLock();
+    for (i = 0; '\0' != line[i]; i++)
+        sdIncomingDataI(&SD2, (uint8_t)line[i]);
+    chSysUnlock();
+
+    /* 10 bits per character on the wire. */
+    chThdSleepMilliseconds(1 + i * 10 * 1000 / GPS_BAUDRATE);
+}
+
+static THD_FUNCTION(SimGpsThread, arg) {
+    FILE *replay = (FILE *)arg;
+    char line[SIM_GPS_LINE_LENGTH + 2];
+    int32_t lastFixTime = -1;
+
+    chRegSetThreadName("SimGps");
+
+    while (true) {
+        if (NULL == fgets(line, SIM_GPS_LINE_LENGTH, replay)) {
+            rewind(replay);
+            lastFixTime = -1;
+            chThdSleepMilliseconds(SIM_GPS_DEFAULT_PERIOD);
+            continue;
+        }
+
+        if ('$' != line[0])
+            continue;
+
+        /* Wait for the epoch of a new fix, sentences of one epoch are sent together. */
+        int32_t fixTime = parseFixTime(line);
+        if ((0 <= fixTime) && (fixTime != lastFixTime)) {
+            if (0 <= lastFixTime) {
+                int32_t period = fixTime - lastFixTime;
+                if ((period <= 0) || (SIM_GPS_MAX_PERIOD < period))
+                    period = SIM_GPS_DEFAULT_PERIOD;
+                chThdSleepMilliseconds(period);
+            }
+            lastFixTime = fixTime;
+        }
+
+        /* Replay files may have lost their carriage returns. */
+        size_t length = strcspn(line, "\r\n");
+        strcpy(line + length, "\r\n");
+        injectLine(line);
+    }
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void SimGps_Start(FILE *replay)
+{
+    chThdCreateStatic(
+            waSimGps,
+            sizeof(waSimGps),
+            NORMALPRIO + 10,
+            SimGpsThread,
+            replay);
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,292 @@
+/**
+ * @file SimHal.c
+ * @brief Emulated drivers and replay feeders of the POSIX simulator build.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "SimHal.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define SIM_COMMAND_LENGTH                                                     64
+#define SIM_COMMAND_POLL_PERIOD                                                20
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+PWMDriver PWMD3 = {"cadence", NULL, 0, {0}, 0};
+PWMDriver PWMD4 = {"beep", NULL, 0, {0}, 0};
+GPTDriver GPTD3;
+EXTDriver EXTD1;
+WDGDriver WDGD1;
+
+static THD_WORKING_AREA(waSimCommand, 1024);
+
+static FILE *baroReplay;
+static FILE *gpsReplay;
+static FILE *eventLog;
+static struct timespec startTime;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static FILE *openReplay(const char *variable) {
+    const char *path = getenv(variable);
+    if (NULL == path)
+        return NULL;
+
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "%s: cannot open %s\n", variable, path);
+        exit(EXIT_FAILURE);
+    }
+    return file;
+}
+
+/**
+ * Log the audible state of a PWM, only changes are written.
+ */
+static void logPwm(PWMDriver *pwmp) {
+    uint32_t frequency = 0;
+    uint32_t duty = 0;
+
+    /* A disabled channel is logged as silence. */
+    if ((NULL != pwmp->config) && (0 != pwmp->period) && (pwmp->enabled & 1)) {
+        frequency = pwmp->config->frequency / pwmp->period;
+        duty = pwmp->width[0] * 10000 / pwmp->period;
+    }
+
+    static uint32_t lastFrequency[2], lastDuty[2];
+    size_t i = (&PWMD4 == pwmp) ? 1 : 0;
+    if ((lastFrequency[i] == frequency) && (lastDuty[i] == duty))
+        return;
+
+    lastFrequency[i] = frequency;
+    lastDuty[i] = duty;
+    SimHal_Log("%s %u %u", pwmp->name, (unsigned)frequency, (unsigned)duty);
+}
+
+static void gptTimerCallback(void *arg) {
+    GPTDriver *gptp = (GPTDriver *)arg;
+    gptp->config->callback(gptp);
+}
+
+static void wdgTimeoutCallback(void *arg) {
+    (void)arg;
+    SimHal_Halt("watchdog timeout");
+}
+
+/**
+ * Drive the button pad and raise its external interrupt.
+ */
+static void setButton(bool pressed) {
+    if (pressed)
+        GPIOB->pin |= (1U << GPIOB_BUTTON);
+    else
+        GPIOB->pin &= ~(1U << GPIOB_BUTTON);
+
+    SimHal_Log("button %d", pressed ? 1 : 0);
+
+    if ((NULL == EXTD1.config) || !(EXTD1.enabled & (1U << GPIOB_BUTTON)))
+        return;
+
+    extcallback_t callback = EXTD1.config->channels[GPIOB_BUTTON].cb;
+    if (NULL != callback)
+        callback(&EXTD1, GPIOB_BUTTON);
+}
+
+static void executeCommand(const char *command) {
+    unsigned duration;
+
+    if (1 == sscanf(command, "press %u", &duration)) {
+        setButton(true);
+        chThdSleepMilliseconds(duration);
+        setButton(false);
+    } else if ('\0' != command[0]) {
+        fprintf(stderr, "unknown command: %s\n", command);
+    }
+}
+
+/**
+ * Collect stdin lines without blocking the simulated system, the whole
+ * simulation runs in a single host thread.
+ */
+static THD_FUNCTION(SimCommandThread, arg) {
+    (void)arg;
+    char line[SIM_COMMAND_LENGTH];
+    size_t length = 0;
+
+    chRegSetThreadName("SimCommand");
+
+    while (true) {
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        char c;
+
+        while ((0 < poll(&input, 1, 0)) && (input.revents & POLLIN) &&
+               (1 == read(STDIN_FILENO, &c, 1))) {
+            if ('\n' != c) {
+                if (length + 1 < sizeof(line))
+                    line[length++] = c;
+                continue;
+            }
+
+            line[length] = '\0';
+            length = 0;
+            executeCommand(line);
+        }
+
+        chThdSleepMilliseconds(SIM_COMMAND_POLL_PERIOD);
+    }
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void pwmStart(PWMDriver *pwmp, const PWMConfig *config) {
+    pwmp->config = config;
+    pwmp->period = config->period;
+    pwmp->enabled = 0;
+}
+
+void pwmChangePeriodI(PWMDriver *pwmp, pwmcnt_t period) {
+    pwmp->period = period;
+    logPwm(pwmp);
+}
+
+void pwmEnableChannelI(PWMDriver *pwmp, pwmchannel_t channel, pwmcnt_t width) {
+    pwmp->width[channel] = width;
+    pwmp->enabled |= (1U << channel);
+    logPwm(pwmp);
+}
+
+void pwmDisableChannelI(PWMDriver *pwmp, pwmchannel_t channel) {
+    pwmp->enabled &= ~(1U << channel);
+    logPwm(pwmp);
+}
+
+void gptStart(GPTDriver *gptp, const GPTConfig *config) {
+    gptp->config = config;
+    chVTObjectInit(&gptp->timer);
+}
+
+void gptStartOneShotI(GPTDriver *gptp, gptcnt_t interval) {
+    systime_t ticks = (systime_t)(((uint64_t)interval * CH_CFG_ST_FREQUENCY +
+            gptp->config->frequency - 1) / gptp->config->frequency);
+    chVTSetI(&gptp->timer, (0 == ticks) ? 1 : ticks, gptTimerCallback, gptp);
+}
+
+void gptStopTimerI(GPTDriver *gptp) {
+    chVTResetI(&gptp->timer);
+}
+
+void extStart(EXTDriver *extp, const EXTConfig *config) {
+    extp->config = config;
+    extp->enabled = 0;
+}
+
+void extChannelEnable(EXTDriver *extp, expchannel_t channel) {
+    extp->enabled |= (1U << channel);
+}
+
+void extChannelDisableI(EXTDriver *extp, expchannel_t channel) {
+    extp->enabled &= ~(1U << channel);
+}
+
+void wdgStart(WDGDriver *wdgp, const WDGConfig *config) {
+    uint32_t prescaler = 4U << (config->pr & STM32_IWDG_PR_MASK);
+    uint32_t timeout = (uint32_t)(((uint64_t)prescaler * (config->rlr + 1) * CH_CFG_ST_FREQUENCY) / SIM_WDG_CLOCK);
+
+    wdgp->config = config;
+    wdgp->timeout = (systime_t)timeout;
+    chVTObjectInit(&wdgp->timer);
+    wdgReset(wdgp);
+}
+
+void wdgReset(WDGDriver *wdgp) {
+    chVTSet(&wdgp->timer, wdgp->timeout, wdgTimeoutCallback, NULL);
+}
+
+void SimHal_Init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    baroReplay = openReplay("VARIO_SIM_BARO");
+    gpsReplay = openReplay("VARIO_SIM_GPS");
+
+    const char *logPath = getenv("VARIO_SIM_LOG");
+    eventLog = (NULL != logPath) ? fopen(logPath, "w") : stdout;
+    if (NULL == eventLog) {
+        fprintf(stderr, "VARIO_SIM_LOG: cannot open %s\n", logPath);
+        exit(EXIT_FAILURE);
+    }
+
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+}
+
+void SimHal_Start(void) {
+    if (NULL != gpsReplay)
+        SimGps_Start(gpsReplay);
+
+    chThdCreateStatic(
+            waSimCommand,
+            sizeof(waSimCommand),
+            NORMALPRIO + 10,
+            SimCommandThread,
+            NULL);
+}
+
+void SimHal_Log(const char *format, ...) {
+    struct timespec now;
+    va_list args;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ms = (now.tv_sec - startTime.tv_sec) * 1e3 + (now.tv_nsec - startTime.tv_nsec) / 1e6;
+
+    fprintf(eventLog, "%.3f ", ms);
+    va_start(args, format);
+    vfprintf(eventLog, format, args);
+    va_end(args);
+    fputc('\n', eventLog);
+    fflush(eventLog);
+}
+
+uint32_t SimHal_Microseconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - startTime.tv_sec) * 1000000LL + (now.tv_nsec - startTime.tv_nsec) / 1000);
+}
+
+void SimHal_Halt(const char *reason) {
+    SimHal_Log("halt %s", reason);
+    fprintf(stderr, "system halted: %s\n", reason);
+    exit(EXIT_FAILURE);
+}
+
+FILE *SimHal_BaroReplay(void) {
+    return baroReplay;
+}
+
+/******************************* END OF FILE ***********************************/
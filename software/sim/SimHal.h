@@ -0,0 +1,214 @@
+/**
+ * @file SimHal.h
+ * @brief Emulated drivers and replay feeders of the POSIX simulator build.
+ * @author Molnar Zoltan
+ *
+ * The simulator HAL only provides PAL and SERIAL. This header is force
+ * included into every simulator translation unit and supplies the subset
+ * of the PWM, GPT, EXT and WDG drivers the firmware uses, with the STM32
+ * specific configuration fields kept so the firmware initializers compile
+ * unchanged.
+ */
+
+#ifndef SIMHAL_H
+#define SIMHAL_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+#include <stdio.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/* Only the GPT driven beeper cadence can be simulated. */
+#define BEEP_HW_GATE                                                        FALSE
+#define BEEP_SYNTH                                                          FALSE
+
+#define PWM_CHANNELS                                                            4
+#define PWM_OUTPUT_DISABLED                                                  0x00
+#define PWM_OUTPUT_ACTIVE_HIGH                                               0x01
+#define PWM_OUTPUT_ACTIVE_LOW                                                0x02
+
+#define EXT_MAX_CHANNELS                                                       16
+#define EXT_CH_MODE_DISABLED                                                    0
+#define EXT_CH_MODE_RISING_EDGE                                                 1
+#define EXT_CH_MODE_FALLING_EDGE                                                2
+#define EXT_CH_MODE_BOTH_EDGES                                                  3
+#define EXT_MODE_GPIOA                                                       0x00
+#define EXT_MODE_GPIOB                                                       0x10
+
+#define STM32_IWDG_PR_MASK                                                 (7 << 0)
+#define STM32_IWDG_PR_4                                                    (0 << 0)
+#define STM32_IWDG_PR_8                                                    (1 << 0)
+/** Nominal frequency of the watchdog clock in Hz. */
+#define SIM_WDG_CLOCK                                                       40000
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#define PWM_PERCENTAGE_TO_WIDTH(pwmp, percentage)                                \
+    ((pwmcnt_t)((((pwmcnt_t)(pwmp)->period) * (pwmcnt_t)(percentage)) / 10000U))
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef uint32_t pwmcnt_t;
+typedef uint8_t pwmchannel_t;
+typedef uint32_t pwmmode_t;
+typedef struct PWMDriver PWMDriver;
+typedef void (*pwmcallback_t)(PWMDriver *pwmp);
+
+typedef struct {
+    pwmmode_t mode;
+    pwmcallback_t callback;
+} PWMChannelConfig;
+
+typedef struct {
+    uint32_t frequency;
+    pwmcnt_t period;
+    pwmcallback_t callback;
+    PWMChannelConfig channels[PWM_CHANNELS];
+    uint32_t cr2;
+    uint32_t dier;
+} PWMConfig;
+
+struct PWMDriver {
+    const char *name;
+    const PWMConfig *config;
+    pwmcnt_t period;
+    pwmcnt_t width[PWM_CHANNELS];
+    uint32_t enabled;           /**< Bit mask of the enabled channels. */
+};
+
+typedef uint32_t gptfreq_t;
+typedef uint32_t gptcnt_t;
+typedef struct GPTDriver GPTDriver;
+typedef void (*gptcallback_t)(GPTDriver *gptp);
+
+typedef struct {
+    gptfreq_t frequency;
+    gptcallback_t callback;
+    uint32_t cr2;
+    uint32_t dier;
+} GPTConfig;
+
+/**
+ * One-shot timer on a virtual timer, intervals are rounded up to ticks.
+ */
+struct GPTDriver {
+    const GPTConfig *config;
+    virtual_timer_t timer;
+};
+
+typedef uint32_t expchannel_t;
+typedef struct EXTDriver EXTDriver;
+typedef void (*extcallback_t)(EXTDriver *extp, expchannel_t channel);
+
+typedef struct {
+    uint32_t mode;
+    extcallback_t cb;
+} EXTChannelConfig;
+
+typedef struct {
+    EXTChannelConfig channels[EXT_MAX_CHANNELS];
+} EXTConfig;
+
+struct EXTDriver {
+    const EXTConfig *config;
+    uint32_t enabled;           /**< Bit mask of the enabled channels. */
+};
+
+typedef struct {
+    uint32_t pr;
+    uint32_t rlr;
+} WDGConfig;
+
+/**
+ * Watchdog on a virtual timer, an expiry halts the simulation.
+ */
+typedef struct {
+    const WDGConfig *config;
+    virtual_timer_t timer;
+    systime_t timeout;
+} WDGDriver;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+extern PWMDriver PWMD3;
+extern PWMDriver PWMD4;
+extern GPTDriver GPTD3;
+extern EXTDriver EXTD1;
+extern WDGDriver WDGD1;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+#ifdef __cplusplus
+extern "C" {
+#endif
+void pwmStart(PWMDriver *pwmp, const PWMConfig *config);
+void pwmChangePeriodI(PWMDriver *pwmp, pwmcnt_t period);
+void pwmEnableChannelI(PWMDriver *pwmp, pwmchannel_t channel, pwmcnt_t width);
+void pwmDisableChannelI(PWMDriver *pwmp, pwmchannel_t channel);
+
+void gptStart(GPTDriver *gptp, const GPTConfig *config);
+void gptStartOneShotI(GPTDriver *gptp, gptcnt_t interval);
+void gptStopTimerI(GPTDriver *gptp);
+
+void extStart(EXTDriver *extp, const EXTConfig *config);
+void extChannelEnable(EXTDriver *extp, expchannel_t channel);
+void extChannelDisableI(EXTDriver *extp, expchannel_t channel);
+
+void wdgStart(WDGDriver *wdgp, const WDGConfig *config);
+void wdgReset(WDGDriver *wdgp);
+
+/**
+ * Open the replay files and the event log named by the environment:
+ * VARIO_SIM_BARO, VARIO_SIM_GPS and VARIO_SIM_LOG (default stdout).
+ * @brief Called from boardInit(), before the kernel is started.
+ */
+void SimHal_Init(void);
+
+/**
+ * Start the GPS replay and the stdin command threads.
+ * @brief Lines "press <ms>" on stdin hold the button down for the given time.
+ */
+void SimHal_Start(void);
+
+/**
+ * Append a line to the event log, prefixed with the host time in ms since
+ * the start of the simulation.
+ */
+void SimHal_Log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Host time in us since the start of the simulation, wraps after 71 minutes.
+ */
+uint32_t SimHal_Microseconds(void);
+
+/**
+ * Report a kernel halt or watchdog timeout and terminate the process.
+ */
+void SimHal_Halt(const char *reason) __attribute__((noreturn));
+
+/**
+ * Replay file of the MS5611 emulation, NULL if not given.
+ */
+FILE *SimHal_BaroReplay(void);
+
+/**
+ * Start feeding the NMEA replay into SD2, see SimGps.c.
+ */
+void SimGps_Start(FILE *replay);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,130 @@
+/**
+ * @file SimMs5611.c
+ * @brief MS5611 emulation replaying raw conversion results.
+ * @author Molnar Zoltan
+ *
+ * Replay file format, one sample per line:
+ *   <D1> <D2>               raw pressure and temperature conversion
+ *   calibration <C1> .. <C6> PROM words used from then on
+ * Lines starting with '#' are ignored, the file is replayed in a loop.
+ * Without a replay file the datasheet example conversion is repeated.
+ * VARIO_SIM_BARO_PERIOD overrides the conversion time in ms, to compare the
+ * signal chain at other sample rates.
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ms5611.h"
+#include "VarioKernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/** Time of the two OSR 4096 conversions of the real driver in ms. */
+#define SIM_MS5611_CONVERSION_TIME                                             20
+#define SIM_MS5611_LINE_LENGTH                                                128
+
+/* Example conversion results of the MS5611 datasheet. */
+#define SIM_MS5611_DEFAULT_D1                                             9085466
+#define SIM_MS5611_DEFAULT_D2                                             8569150
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITIONS OF GLOBAL CONSTANTS AND VARIABLES                               */
+/*******************************************************************************/
+/* Example calibration of the MS5611 datasheet. */
+static struct Ms5611Calibration_s calibration = {
+    40127, 36924, 23317, 23282, 33464, 28312
+};
+
+static FILE *replay;
+static uint32_t sampleCount;
+static uint32_t conversionTime = SIM_MS5611_CONVERSION_TIME;
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Read the next conversion pair, calibration lines are applied on the way.
+ * @return false if the file has no samples at all.
+ */
+static bool readSample(uint32_t *d1, uint32_t *d2) {
+    char line[SIM_MS5611_LINE_LENGTH];
+    bool rewound = false;
+
+    while (true) {
+        if (NULL == fgets(line, sizeof(line), replay)) {
+            if (rewound)
+                return false;
+            rewind(replay);
+            rewound = true;
+            continue;
+        }
+
+        unsigned c[6];
+        if (6 == sscanf(line, "calibration %u %u %u %u %u %u", &c[0], &c[1], &c[2], &c[3], &c[4], &c[5])) {
+            calibration.c1 = (uint16_t)c[0];
+            calibration.c2 = (uint16_t)c[1];
+            calibration.c3 = (uint16_t)c[2];
+            calibration.c4 = (uint16_t)c[3];
+            calibration.c5 = (uint16_t)c[4];
+            calibration.c6 = (uint16_t)c[5];
+            continue;
+        }
+
+        unsigned raw1, raw2;
+        if (('#' != line[0]) && (2 == sscanf(line, "%u %u", &raw1, &raw2))) {
+            *d1 = raw1;
+            *d2 = raw2;
+            return true;
+        }
+    }
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void MS5611_Init(void)
+{
+    replay = SimHal_BaroReplay();
+
+    const char *period = getenv("VARIO_SIM_BARO_PERIOD");
+    if ((NULL != period) && (0 < atoi(period)))
+        conversionTime = (uint32_t)atoi(period);
+}
+
+void MS5611_Start(void)
+{
+    chThdSleepMilliseconds(250);
+}
+
+void MS5611_Measure(uint32_t *pP, int32_t *pT)
+{
+    uint32_t d1 = SIM_MS5611_DEFAULT_D1;
+    uint32_t d2 = SIM_MS5611_DEFAULT_D2;
+
+    chThdSleepMilliseconds(conversionTime);
+    if ((NULL != replay) && !readSample(&d1, &d2))
+        replay = NULL;
+
+    VarioKernels_CompensateMs5611(&calibration, d1, d2, pP, pT);
+    SimHal_Log("baro %u %u %d", (unsigned)sampleCount++, (unsigned)*pP, (int)*pT);
+}
+
+const struct Ms5611Calibration_s *MS5611_GetCalibration(void)
+{
+    return &calibration;
+}
+
+/******************************* END OF FILE ***********************************/
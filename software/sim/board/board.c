@@ -0,0 +1,25 @@
+/**
+ * @file board.c
+ * @brief Board initialization of the POSIX simulator build.
+ * @author Molnar Zoltan
+ */
+
+#include "hal.h"
+
+/**
+ * @brief   PAL setup, all virtual pads start low.
+ */
+#if HAL_USE_PAL || defined(__DOXYGEN__)
+const PALConfig pal_default_config = {
+  {0, 0, 0},
+  {0, 0, 0}
+};
+#endif
+
+/*
+ * Board-specific initialization code, runs from halInit() before the kernel
+ * is started, so only the replay files are opened here.
+ */
+void boardInit(void) {
+  SimHal_Init();
+}
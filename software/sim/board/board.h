@@ -0,0 +1,47 @@
+/**
+ * @file board.h
+ * @brief Board definitions of the POSIX simulator build.
+ * @author Molnar Zoltan
+ */
+
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+/*
+ * Board identifier.
+ */
+#define BOARD_SIMULATOR
+#define BOARD_NAME              "Variometer simulator"
+
+/*
+ * The two virtual ports of the simulator PAL driver stand in for GPIOA and
+ * GPIOB, pad numbers are the same as on the real board.
+ */
+#define GPIOA                   IOPORT1
+#define GPIOB                   IOPORT2
+
+#define GPIOA_GPS_TX             2
+#define GPIOA_GPS_RX             3
+#define GPIOA_MS5611_SPI_NSS     4
+#define GPIOA_MS5611_SPI_SCK     5
+#define GPIOA_MS5611_SPI_MISO    6
+#define GPIOA_MS5611_SPI_MOSI    7
+#define GPIOA_SHUTDOWN           8
+#define GPIOA_KOBO_TX            9
+#define GPIOA_KOBO_RX           10
+
+#define GPIOB_BUZZER             6
+#define GPIOB_BUTTON             8
+#define GPIOB_LED               12
+
+#if !defined(_FROM_ASM_)
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void boardInit(void);
+#ifdef __cplusplus
+}
+#endif
+#endif /* _FROM_ASM_ */
+
+#endif /* _BOARD_H_ */
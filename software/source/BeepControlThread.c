@@ -9,7 +9,15 @@
 /*******************************************************************************/
 #include "BeepControlThread.h"
 #include "ButtonHandlerThread.h"
+#include "ConfigStore.h"
+#include "CycleProbe.h"
+#include "LatencyBench.h"
+#include "PipelineMonitor.h"
+#include "SignalChain.h"
 #include "SignalProcessorThread.h"
+#include "ToneProfile.h"
+#include "ToneSynth.h"
+#include "TraceRing.h"
 #include "ch.h"
 #include "hal.h"
 
@@ -17,15 +25,52 @@
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
 #define BEEP_TIMER                                                         &GPTD3
+#define BEEP_CADENCE_PWM                                                   &PWMD3
 #define BEEP_PWM                                                           &PWMD4
 
+#if BEEP_HW_GATE && BEEP_SYNTH
+#error "BEEP_HW_GATE and BEEP_SYNTH are mutually exclusive"
+#endif
+
+/* The GPT one-shot cadence is used unless a hardware driven one is selected. */
+#define BEEP_GPT_CADENCE                           (!BEEP_HW_GATE && !BEEP_SYNTH)
+
+/*
+ * Beeper update policies: reprogram the tone on every processed sample, only
+ * when the quantized tone or the beeper state changes, or pull the latest
+ * vario at a fixed rate independent of the sample rate.
+ */
+#define BEEP_UPDATE_EVERY_SAMPLE                                                0
+#define BEEP_UPDATE_ON_TONE_CHANGE                                              1
+#define BEEP_UPDATE_FIXED_RATE                                                  2
+
+#if !defined(BEEP_UPDATE_POLICY)
+#define BEEP_UPDATE_POLICY                             BEEP_UPDATE_ON_TONE_CHANGE
+#endif
+
+/* Update period of BEEP_UPDATE_FIXED_RATE in ms. */
+#define BEEP_UPDATE_PERIOD                                                     50
+
+#if BEEP_UPDATE_POLICY == BEEP_UPDATE_FIXED_RATE
+/* Only climb onsets are pushed, everything else is pulled by the timer. */
+#define BEEP_UPDATE_FLAGS                                 (EARLY_LIFT | EARLY_SINK)
+#else
+#define BEEP_UPDATE_FLAGS                                    CALCULATION_FINISHED
+#endif
+
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
 /*******************************************************************************/
 #define PWM_TIM_BASE_CLK                                                (1000000)
 #define FREQ_TO_TICK(freq)             ((freq) ? (PWM_TIM_BASE_CLK / (freq)) : 0)
-#define BEEP_TIM_BASE_CLK                                                (200000)
+#define BEEP_TIM_BASE_CLK                                                (100000)
 #define MS2TIMTICK(x)                            ((x) * BEEP_TIM_BASE_CLK / 1000)
+#define TIMTICK2US(x)                       ((x) * (1000000 / BEEP_TIM_BASE_CLK))
+
+#define NOTE_VOLUME_ACTUAL                                                (0xFFFF)
+
+#define TONE_TABLE_ZERO_INDEX                                       TONE_MAX_STEP
+#define TONE_TABLE_SIZE                               (2 * TONE_TABLE_ZERO_INDEX + 1)
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
@@ -37,12 +82,6 @@ typedef enum {
     VOLUME_HIGH = 5000
 } BeepVolume_t;
 
-typedef enum {
-    BEEP_LIFTING,
-    BEEP_SINKING,
-    BEEP_DISABLED
-} BeepControlState_t;
-
 typedef enum {
     BEEP_ON,
     BEEP_OFF
@@ -53,9 +92,52 @@ typedef enum {
     TIMER_RUNNING
 } TimerState_t;
 
+/**
+ * Tone parameters of a quantized vario value in timer ticks, so the beep
+ * timer interrupt does not need any arithmetic.
+ */
+struct ToneTableEntry_s {
+    uint16_t period;            /**< PWM period, 0 is silence. */
+    uint16_t beepTicks;         /**< Beep timer ticks of the tone. */
+    uint16_t silenceTicks;      /**< Beep timer ticks of the pause, 0 is continuous. */
+};
+
+/**
+ * Note of a signal sequence, a sequence ends with a zero duration note.
+ */
+struct SoundNote_s {
+    uint16_t frequency;         /**< Hz, 0 is a rest. */
+    uint16_t duration;          /**< ms. */
+    uint16_t volume;            /**< BeepVolume_t or NOTE_VOLUME_ACTUAL. */
+};
+
 /*******************************************************************************/
 /* DEFINITIONS OF GLOBAL CONSTANTS AND VARIABLES                               */
 /*******************************************************************************/
+static const struct SoundNote_s startupSignal[] = {
+        {0,    50,  VOLUME_ZERO},
+        {1000, 100, VOLUME_HIGH},
+        {1500, 100, VOLUME_HIGH},
+        {2000, 100, VOLUME_HIGH},
+        {0,    100, VOLUME_ZERO},
+        {0,    0,   VOLUME_ZERO}
+};
+
+static const struct SoundNote_s shutdownSignal[] = {
+        {2000, 100, VOLUME_HIGH},
+        {1500, 100, VOLUME_HIGH},
+        {1000, 100, VOLUME_HIGH},
+        {0,    0,   VOLUME_ZERO}
+};
+
+static const struct SoundNote_s volumeSetSignal[] = {
+        {0,    50,  VOLUME_ZERO},
+        {2000, 200, NOTE_VOLUME_ACTUAL},
+        {0,    50,  VOLUME_ZERO},
+        {0,    0,   VOLUME_ZERO}
+};
+
+#if !BEEP_SYNTH
 static PWMConfig pwmcfg = {
         PWM_TIM_BASE_CLK,
         0,
@@ -70,7 +152,38 @@ static PWMConfig pwmcfg = {
         0,
         0,
 };
-
+#endif
+
+#if BEEP_HW_GATE
+static void cadencePeriodCallback(PWMDriver *pwmp);
+static void cadenceCompareCallback(PWMDriver *pwmp);
+
+/*
+ * TIM3 runs one beep + silence cycle per period, its OC1REF is high during
+ * the beep and drives TRGO, which gates the TIM4 tone timer through ITR2.
+ * OC1REF needs no output, PA6 is the MISO of the MS5611 SPI. A gated TIM4
+ * freezes with its output at any level, so the CPU is still involved twice
+ * per beep cycle: the compare interrupt forces the buzzer inactive for the
+ * silence and the update interrupt gives it back to the PWM. The callbacks
+ * only switch the output mode, the timing of the cycle and of the tone
+ * stays in the timers, unlike the GPT cadence which reloads the one-shot
+ * timer and the tone on every edge.
+ */
+static PWMConfig cadencePwmConfig = {
+        BEEP_TIM_BASE_CLK,
+        0,
+        cadencePeriodCallback,
+        {
+                {PWM_OUTPUT_DISABLED, cadenceCompareCallback},
+                {PWM_OUTPUT_DISABLED, NULL},
+                {PWM_OUTPUT_DISABLED, NULL},
+                {PWM_OUTPUT_DISABLED, NULL}
+        },
+        /* HW dependent part.*/
+        STM32_TIM_CR2_MMS(4),        /* OC1REF as TRGO.*/
+        0,
+};
+#elif BEEP_GPT_CADENCE
 static void timerCallback(GPTDriver *gptp);
 
 static GPTConfig beepTimerConfig =
@@ -81,137 +194,260 @@ static GPTConfig beepTimerConfig =
         0,
         0
 };
+#endif
 
 EVENTSOURCE_DECL(beeperEvent);
 
-static float liftThreshold = 0.4;
-static float liftOffThreshold = 0;
-static float sinkThreshold = -1.2;
-static float sinkOffThreshold = -1;
-
-static float maximumLift = 6;
-static float liftFreqBase = 600;
-static float liftFreqMax = 1500;
-static float maximumSink = (-6);
-static float sinkFreqBase = 400;
-static float sinkFreqMin = 150;
+static struct BeepThresholds_s thresholds = {
+    BEEP_DEFAULT_LIFT_THRESHOLD,
+    BEEP_DEFAULT_LIFT_OFF_THRESHOLD,
+    BEEP_DEFAULT_SINK_THRESHOLD,
+    BEEP_DEFAULT_SINK_OFF_THRESHOLD
+};
 
-static float beepDurationMinLift = 350;
-static float beepDurationMaxLift = 100;
-static float silenceDurationMinLift = 230;
-static float silenceDurationMaxLift = 60;
+static size_t toneProfileIndex = 0;
 
 static BeepControlState_t beepControlState = BEEP_DISABLED;
-static BeepState_t beepState = BEEP_OFF;
 static BeepVolume_t beepVolume = VOLUME_MED;
+#if BEEP_GPT_CADENCE
+static BeepState_t beepState = BEEP_OFF;
 static TimerState_t timerState = TIMER_STOPPED;
+#endif
 
-static uint32_t beepFrequency;
-static uint32_t beepDuration;
-static uint32_t silenceDuration;
+static struct ToneTableEntry_s toneTable[TONE_TABLE_SIZE];
+static volatile uint8_t toneIndex = TONE_TABLE_ZERO_INDEX;
 static float actualVario;
 
+static virtual_timer_t sequencerTimer;
+static const struct SoundNote_s *sequenceNote;
+static semaphore_t *sequenceFinished;
+
+#if BEEP_UPDATE_POLICY == BEEP_UPDATE_FIXED_RATE
+static virtual_timer_t updateTimer;
+#endif
+
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
+static void sequencerCallback(void *arg);
 
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
-static void setPwmFreqAndDutyCycleI(uint32_t freq, BeepVolume_t volume)
+#if BEEP_SYNTH
+/* The synthesizer runs at PWM_TIM_BASE_CLK as well, periods are shared. */
+static void setSignalToneI(uint32_t freq, BeepVolume_t volume)
+{
+    ToneSynth_SetVolumeI(volume);
+    ToneSynth_SetToneI(FREQ_TO_TICK(freq), 0, 0, true);
+}
+#else
+static void setPwmPeriodAndDutyCycleI(uint16_t period, BeepVolume_t volume)
 {
-    pwmChangePeriodI(BEEP_PWM, FREQ_TO_TICK(freq));
+    pwmChangePeriodI(BEEP_PWM, period);
     pwmEnableChannelI(BEEP_PWM, 0, PWM_PERCENTAGE_TO_WIDTH(BEEP_PWM, volume));
 }
 
-static void setPwmFreqAndDutyCycle(uint32_t freq, BeepVolume_t volume)
+static void setSignalToneI(uint32_t freq, BeepVolume_t volume)
 {
-    pwmChangePeriod(BEEP_PWM, FREQ_TO_TICK(freq));
-    pwmEnableChannel(BEEP_PWM, 0, PWM_PERCENTAGE_TO_WIDTH(BEEP_PWM, volume));
+    setPwmPeriodAndDutyCycleI(FREQ_TO_TICK(freq), volume);
 }
+#endif
 
+#if BEEP_GPT_CADENCE
 static void enableBeepI(void) {
-    setPwmFreqAndDutyCycleI(beepFrequency, beepVolume);
+    setPwmPeriodAndDutyCycleI(toneTable[toneIndex].period, beepVolume);
     beepState = BEEP_ON;
+#if LATENCY_BENCH
+    LatencyBench_MarkI(LATENCY_STAGE_TONE);
+#endif
 }
 
 static void disableBeepI(void) {
-    setPwmFreqAndDutyCycleI(0, VOLUME_ZERO);
+    setPwmPeriodAndDutyCycleI(0, VOLUME_ZERO);
     beepState = BEEP_OFF;
 }
+#endif
 
 static void readMeasurementData(void) {
-    chMtxLock(&SignalProcessorMutex);
-    actualVario = SignalProcessingOutputData.vario;
+    struct SignalChainOutput_s output;
+
+    TRACE_RING_MUTEX_LOCK(&SignalProcessorMutex);
+    output.vario = SignalProcessingOutputData.vario;
+    output.earlyVario = SignalProcessingOutputData.earlyVario;
+    output.onset = SignalProcessingOutputData.onset;
     chMtxUnlock(&SignalProcessorMutex);
+
+    actualVario = SignalChain_SelectVario(&output);
 }
 
-static void calculateLiftFrequency(void) {
-    float vario = actualVario;
-    if (maximumLift < vario)
-        vario = maximumLift;
+/**
+ * Compile a tone profile into the tone table.
+ * @brief Entries are replaced one by one under lock, so the beep timer
+ *        interrupt never sees a half written entry and the profile can be
+ *        switched while beeping. The gated cadence counts the beep and the
+ *        silence in one period, a longer cycle is shortened keeping the
+ *        ratio of the two.
+ */
+static void buildToneTable(const volatile struct ToneProfile_s *profile) {
+    int32_t i;
+    for (i = 0; i < TONE_TABLE_SIZE; i++) {
+        struct ToneCurvePoint_s point;
+        ToneProfile_Evaluate(profile, (i - TONE_TABLE_ZERO_INDEX) * (100 / TONE_STEPS_PER_MPS), &point);
+#if BEEP_HW_GATE
+        uint32_t cycle = (uint32_t)point.beepDuration + point.silenceDuration;
+        if (TONE_PROFILE_MAX_DURATION < cycle) {
+            point.beepDuration = (uint16_t)(point.beepDuration * TONE_PROFILE_MAX_DURATION / cycle);
+            point.silenceDuration = (uint16_t)(TONE_PROFILE_MAX_DURATION - point.beepDuration);
+        }
+#endif
 
-    float range = liftFreqMax - liftFreqBase;
-    float unit = range / maximumLift;
-    float offset = vario * unit;
-    beepFrequency = (uint32_t)(liftFreqBase + offset);
+        struct ToneTableEntry_s entry;
+        entry.period = (uint16_t)FREQ_TO_TICK(point.frequency);
+        entry.beepTicks = (uint16_t)MS2TIMTICK((uint32_t)point.beepDuration);
+        entry.silenceTicks = (uint16_t)MS2TIMTICK((uint32_t)point.silenceDuration);
+
+        chSysLock();
+        toneTable[i] = entry;
+        chSysUnlock();
+    }
+}
+
+/**
+ * Quantize vario to the nearest tone table entry.
+ */
+static uint8_t calculateToneIndex(float vario) {
+    return (uint8_t)(SignalChain_ToneStep(vario) + TONE_TABLE_ZERO_INDEX);
 }
 
-static void calculateSinkFrequency(void) {
-    float vario = actualVario;
-    if (vario < maximumSink) vario = maximumSink;
+#if BEEP_HW_GATE
+/**
+ * Drive the buzzer from the TIM4 compare or force it inactive.
+ */
+static void setBuzzerOutputI(bool enabled) {
+    uint32_t ccmr1 = (BEEP_PWM)->tim->CCMR1 & ~STM32_TIM_CCMR1_OC1M_MASK;
 
-    float range = sinkFreqBase - sinkFreqMin;
-    float unit = range / maximumSink;
-    float offset = vario * unit;
-    beepFrequency = (uint32_t)(sinkFreqBase - offset);
+    (BEEP_PWM)->tim->CCMR1 = ccmr1 | STM32_TIM_CCMR1_OC1M(enabled ? 6 : 4);
 }
 
-static void calculateBeepFrequency(void) {
-    if (0 < actualVario)
-        calculateLiftFrequency();
-    else
-        calculateSinkFrequency();
+/**
+ * Start of a beep, runs from the TIM3 update interrupt.
+ */
+static void cadencePeriodCallback(PWMDriver *pwmp) {
+    (void)pwmp;
+
+    if (BEEP_DISABLED != beepControlState)
+        setBuzzerOutputI(true);
 }
 
-static void calculateBeepDuration(void) {
-    float vario = actualVario;
-    if (vario < 0) vario *= (-1);
+/**
+ * End of a beep, runs from the TIM3 compare interrupt. Without silence the
+ * compare value is above the period and never matches.
+ */
+static void cadenceCompareCallback(PWMDriver *pwmp) {
+    (void)pwmp;
 
-    float range = beepDurationMaxLift - beepDurationMinLift;
-    float unit = range / maximumLift;
-    float offset = vario * unit;
-    beepDuration = (uint32_t)(beepDurationMinLift + offset);
+    setBuzzerOutputI(false);
 }
 
-static void calculateSilenceDuration(void) {
-    if (0 < actualVario) {
-        float vario = actualVario;
-        if (maximumLift < vario)
-            vario = maximumLift;
+/**
+ * Let TIM4 count only while the TIM3 trigger output is high.
+ */
+static void engageGate(void) {
+    (BEEP_PWM)->tim->SMCR = STM32_TIM_SMCR_TS(2) | STM32_TIM_SMCR_SMS(5);
+}
 
-        float range = silenceDurationMaxLift - silenceDurationMinLift;
-        float unit = range / maximumLift;
-        float offset = vario * unit;
-        silenceDuration = (uint32_t)(silenceDurationMinLift + offset);
+/**
+ * Let TIM4 run freely, used by the fixed signals.
+ */
+static void releaseGate(void) {
+    chSysLock();
+    (BEEP_PWM)->tim->SMCR = 0;
+    setBuzzerOutputI(true);
+    chSysUnlock();
+}
+
+/**
+ * Load the cadence and tone of the current table entry.
+ * @brief Both timers have preloaded period and compare registers, so the
+ *        new values take effect at the end of the running cycle and tone
+ *        period without glitches.
+ * @param[in] restart Load the new values at once and start a new cycle.
+ */
+static void updateCadence(bool restart) {
+    const struct ToneTableEntry_s *tone = &toneTable[toneIndex];
+
+    chSysLock();
+    if (BEEP_DISABLED == beepControlState) {
+        pwmDisableChannelI(BEEP_CADENCE_PWM, 0);
+        setBuzzerOutputI(false);
     } else {
-        silenceDuration = 0;
+        /* Without silence the compare value equals the period, TRGO stays high. */
+        pwmChangePeriodI(BEEP_CADENCE_PWM, tone->beepTicks + tone->silenceTicks);
+        pwmEnableChannelI(BEEP_CADENCE_PWM, 0, tone->beepTicks);
+        pwmEnableChannelNotificationI(BEEP_CADENCE_PWM, 0);
+        pwmEnablePeriodicNotificationI(BEEP_CADENCE_PWM);
+        setPwmPeriodAndDutyCycleI(tone->period, beepVolume);
+#if LATENCY_BENCH
+        LatencyBench_MarkI(LATENCY_STAGE_TONE);
+#endif
+        if (restart) {
+            (BEEP_PWM)->tim->EGR = STM32_TIM_EGR_UG;
+            (BEEP_CADENCE_PWM)->tim->EGR = STM32_TIM_EGR_UG;
+        }
+    }
+    chSysUnlock();
+}
+
+static void silenceBeeper(void) {
+    chSysLock();
+    pwmDisableChannelI(BEEP_CADENCE_PWM, 0);
+    beepControlState = BEEP_DISABLED;
+    chSysUnlock();
+    releaseGate();
+}
+#elif BEEP_SYNTH
+/**
+ * Pass the cadence and tone of the current table entry to the synthesizer,
+ * which ramps, glides and times them without further CPU involvement.
+ * @param[in] restart Start the cadence with a new beep.
+ */
+static void updateCadence(bool restart) {
+    const struct ToneTableEntry_s *tone = &toneTable[toneIndex];
+
+    if (BEEP_DISABLED == beepControlState) {
+        ToneSynth_SetTone(0, 0, 0, false);
+        return;
     }
+
+    ToneSynth_SetVolume(beepVolume);
+    ToneSynth_SetTone(
+            tone->period,
+            TIMTICK2US(tone->beepTicks),
+            TIMTICK2US(tone->silenceTicks),
+            restart);
+#if LATENCY_BENCH
+    LatencyBench_Mark(LATENCY_STAGE_TONE);
+#endif
 }
 
+static void silenceBeeper(void) {
+    beepControlState = BEEP_DISABLED;
+    ToneSynth_SetTone(0, 0, 0, false);
+}
+#else
 static void startBeep(void) {
-    calculateBeepDuration();
     chSysLock();
-    gptStartOneShotI(BEEP_TIMER, MS2TIMTICK(beepDuration));
+    gptStartOneShotI(BEEP_TIMER, toneTable[toneIndex].beepTicks);
     timerState = TIMER_RUNNING;
     enableBeepI();
     chSysUnlock();
 }
 
-static void timerCallback(GPTDriver *gptp) {
-
-    (void)gptp;
-
+/**
+ * Advance the beep cadence, runs from the beep timer interrupt.
+ */
+static void advanceCadence(void) {
     if(BEEP_DISABLED == beepControlState) {
         chSysLockFromISR();
         disableBeepI();
@@ -220,26 +456,25 @@ static void timerCallback(GPTDriver *gptp) {
         return;
     }
 
-    calculateSilenceDuration();
-    calculateBeepDuration();
+    const struct ToneTableEntry_s *tone = &toneTable[toneIndex];
 
     switch(beepState) {
     case BEEP_ON:
-        if(0 == silenceDuration) {
+        if(0 == tone->silenceTicks) {
             chSysLockFromISR();
-            gptStartOneShotI(BEEP_TIMER, MS2TIMTICK(beepDuration));
+            gptStartOneShotI(BEEP_TIMER, tone->beepTicks);
             chSysUnlockFromISR();
         } else {
             chSysLockFromISR();
             disableBeepI();
-            gptStartOneShotI(BEEP_TIMER, MS2TIMTICK(silenceDuration));
+            gptStartOneShotI(BEEP_TIMER, tone->silenceTicks);
             chSysUnlockFromISR();
         }
         break;
     case BEEP_OFF:
         chSysLockFromISR();
         enableBeepI();
-        gptStartOneShotI(BEEP_TIMER, MS2TIMTICK(beepDuration));
+        gptStartOneShotI(BEEP_TIMER, tone->beepTicks);
         chSysUnlockFromISR();
         break;
     default:
@@ -247,29 +482,43 @@ static void timerCallback(GPTDriver *gptp) {
     }
 }
 
-static void updateBeeperStateMachine(void) {
-    switch(beepControlState) {
-    case BEEP_LIFTING:
-        if (actualVario < liftOffThreshold)
-            beepControlState = BEEP_DISABLED;
-        break;
-    case BEEP_SINKING:
-        if (sinkOffThreshold < actualVario)
-            beepControlState = BEEP_DISABLED;
-        break;
-    case BEEP_DISABLED:
-        if (liftThreshold < actualVario)
-            beepControlState = BEEP_LIFTING;
-        if (actualVario < sinkThreshold)
-            beepControlState = BEEP_SINKING;
+static void timerCallback(GPTDriver *gptp) {
+    (void)gptp;
 
-        if((BEEP_DISABLED != beepControlState) && (TIMER_STOPPED == timerState))
-            startBeep();
+    TRACE_RING_RECORD(TRACE_ISR_BEEP_TIMER, 0, 0);
+    CYCLE_PROBE_BEGIN(PROBE_BEEP_TIMER);
+    advanceCadence();
+    CYCLE_PROBE_END(PROBE_BEEP_TIMER);
+}
 
-        break;
-    default:
-        break;
-    }
+static void silenceBeeper(void) {
+    chSysLock();
+    if (TIMER_RUNNING == timerState)
+        gptStopTimerI(BEEP_TIMER);
+    timerState = TIMER_STOPPED;
+    disableBeepI();
+    beepControlState = BEEP_DISABLED;
+    chSysUnlock();
+}
+#endif
+
+static void updateBeeperStateMachine(void) {
+#if BEEP_GPT_CADENCE || LATENCY_BENCH
+    BeepControlState_t previousState = beepControlState;
+#endif
+
+    beepControlState = SignalChain_UpdateBeepState(&thresholds, beepControlState, actualVario);
+
+#if LATENCY_BENCH
+    if ((BEEP_DISABLED == previousState) && (BEEP_LIFTING == beepControlState))
+        LatencyBench_Mark(LATENCY_STAGE_STATE);
+#endif
+
+#if BEEP_GPT_CADENCE
+    if ((BEEP_DISABLED == previousState) && (BEEP_DISABLED != beepControlState) &&
+        (TIMER_STOPPED == timerState))
+        startBeep();
+#endif
 }
 
 static void stepVolume(void) {
@@ -292,85 +541,178 @@ static void stepVolume(void) {
     }
 }
 
-static void playStartupSignal(void) {
-    chThdSleepMilliseconds(50);
-
-    setPwmFreqAndDutyCycle(1000, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
-
-    setPwmFreqAndDutyCycle(1500, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
-
-    setPwmFreqAndDutyCycle(2000, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
-    setPwmFreqAndDutyCycle(0, VOLUME_ZERO);
+/**
+ * Apply the stored settings, values out of range are ignored.
+ */
+static void loadSettings(void) {
+    int32_t value;
+
+    if (ConfigStore_Get(CONFIG_KEY_VOLUME, &value)) {
+        switch (value) {
+        case VOLUME_ZERO:
+        case VOLUME_LOW:
+        case VOLUME_MED:
+        case VOLUME_HIGH:
+            beepVolume = (BeepVolume_t)value;
+            break;
+        default:
+            break;
+        }
+    }
 
-    chThdSleepMilliseconds(100);
+    if (ConfigStore_Get(CONFIG_KEY_TONE_PROFILE, &value) &&
+        (0 <= value) && (NULL != ToneProfile_Get((size_t)value)))
+        toneProfileIndex = (size_t)value;
+
+    if (ConfigStore_Get(CONFIG_KEY_LIFT_THRESHOLD, &value))
+        thresholds.lift = value / 100.0f;
+    if (ConfigStore_Get(CONFIG_KEY_LIFT_OFF_THRESHOLD, &value))
+        thresholds.liftOff = value / 100.0f;
+    if (ConfigStore_Get(CONFIG_KEY_SINK_THRESHOLD, &value))
+        thresholds.sink = value / 100.0f;
+    if (ConfigStore_Get(CONFIG_KEY_SINK_OFF_THRESHOLD, &value))
+        thresholds.sinkOff = value / 100.0f;
 }
 
-static void playShutdownSignal(void) {
-    chThdSleepMicroseconds(500);
+static void playNoteI(const struct SoundNote_s *note) {
+    BeepVolume_t volume = (NOTE_VOLUME_ACTUAL == note->volume) ?
+            beepVolume : (BeepVolume_t)note->volume;
+    setSignalToneI(note->frequency, volume);
+    chVTSetI(&sequencerTimer, MS2ST(note->duration), sequencerCallback, NULL);
+}
 
-    setPwmFreqAndDutyCycle(2000, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
+/**
+ * Step to the next note of the sequence, runs from the system tick.
+ */
+static void sequencerCallback(void *arg) {
+    (void)arg;
 
-    setPwmFreqAndDutyCycle(1500, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
+    chSysLockFromISR();
+    sequenceNote++;
+    if (0 != sequenceNote->duration) {
+        playNoteI(sequenceNote);
+    } else {
+        setSignalToneI(0, VOLUME_ZERO);
+        sequenceNote = NULL;
+#if BEEP_HW_GATE
+        engageGate();
+#endif
+        if (NULL != sequenceFinished)
+            chSemSignalI(sequenceFinished);
+    }
+    chSysUnlockFromISR();
+}
 
-    setPwmFreqAndDutyCycle(1000, VOLUME_HIGH);
-    chThdSleepMilliseconds(100);
-    setPwmFreqAndDutyCycle(0, VOLUME_ZERO);
+static bool isSequencePlaying(void) {
+    return NULL != sequenceNote;
 }
 
-static void playVolumeSetSignal(void) {
-    setPwmFreqAndDutyCycle(0, VOLUME_ZERO);
-    chThdSleepMilliseconds(50);
+/**
+ * Start playing a note sequence, pre-empting the vario tone and any
+ * sequence still playing. The vario tone resumes when the sequence ends.
+ * A sequence with a waiter, the shutdown beep, is never pre-empted, the new
+ * sequence is dropped so the waiter is always signalled.
+ * @param[in] finished Signalled at the end of the sequence, can be NULL.
+ */
+static void playSequence(const struct SoundNote_s *sequence, semaphore_t *finished) {
+    chSysLock();
+    bool awaited = (NULL != sequenceNote) && (NULL != sequenceFinished);
+    chSysUnlock();
+    if (awaited)
+        return;
 
-    setPwmFreqAndDutyCycle(2000, beepVolume);
-    chThdSleepMilliseconds(200);
+    silenceBeeper();
 
-    setPwmFreqAndDutyCycle(0, VOLUME_ZERO);
-    chThdSleepMilliseconds(50);
+    chSysLock();
+    sequenceNote = sequence;
+    sequenceFinished = finished;
+    playNoteI(sequenceNote);
+    chSysUnlock();
 }
 
+#if BEEP_GPT_CADENCE
 static void updateBeepFrequency(void) {
     if ((BEEP_ON == beepState) && (BEEP_DISABLED != beepControlState)) {
         chSysLock();
-        setPwmFreqAndDutyCycleI(beepFrequency, beepVolume);
+        setPwmPeriodAndDutyCycleI(toneTable[toneIndex].period, beepVolume);
         chSysUnlock();
     }
 }
+#endif
 
 static void handleStepVolumeEvent(void)
 {
-    chSysLock();
-    if (TIMER_RUNNING == timerState)
-        gptStopTimerI(BEEP_TIMER);
-    disableBeepI();
-    beepControlState = BEEP_DISABLED;
-    chSysUnlock();
     stepVolume();
-    playVolumeSetSignal();
+    playSequence(volumeSetSignal, NULL);
+    ConfigStore_Set(CONFIG_KEY_VOLUME, beepVolume);
+}
+
+/**
+ * Switch to the next valid tone profile and apply it to the running tone.
+ */
+static void handleStepProfileEvent(void)
+{
+    size_t i;
+    for (i = 1; i <= TONE_PROFILE_COUNT; i++) {
+        size_t index = (toneProfileIndex + i) % TONE_PROFILE_COUNT;
+        const volatile struct ToneProfile_s *profile = ToneProfile_Get(index);
+        if (NULL != profile) {
+            toneProfileIndex = index;
+            buildToneTable(profile);
+            ConfigStore_Set(CONFIG_KEY_TONE_PROFILE, (int32_t)index);
+            break;
+        }
+    }
+
+    if (isSequencePlaying())
+        return;
+
+#if BEEP_GPT_CADENCE
+    updateBeepFrequency();
+#else
+    updateCadence(false);
+#endif
 }
 
 static void handleSystemShutdownEvent(void)
 {
-    chSysLock();
-    if (TIMER_RUNNING == timerState)
-        gptStopTimerI(BEEP_TIMER);
-    disableBeepI();
-    beepControlState = BEEP_DISABLED;
-    chSysUnlock();
-    playShutdownSignal();
-    chSemSignal(&shutdownBeepFinishedSemaphore);
+    playSequence(shutdownSignal, &shutdownBeepFinishedSemaphore);
 }
 
+#if BEEP_UPDATE_POLICY == BEEP_UPDATE_FIXED_RATE
+/**
+ * Wake up the beeper thread to pull the latest vario.
+ */
+static void updateTimerCallback(void *arg) {
+    chSysLockFromISR();
+    chEvtSignalI((thread_t *)arg, EVENT_MASK(2));
+    chVTSetI(&updateTimer, MS2ST(BEEP_UPDATE_PERIOD), updateTimerCallback, arg);
+    chSysUnlockFromISR();
+}
+#endif
+
 static void handleSignalProcessorEvent(void)
 {
+    uint8_t previousToneIndex = toneIndex;
+    BeepControlState_t previousState = beepControlState;
+
     readMeasurementData();
-    calculateBeepFrequency();
+    PipelineMonitor_Progress(PIPELINE_BEEPER_UPDATED);
+    toneIndex = calculateToneIndex(actualVario);
+    if (isSequencePlaying())
+        return;
+
     updateBeeperStateMachine();
+
+    bool toneChanged = (previousToneIndex != toneIndex) || (previousState != beepControlState);
+    if (!toneChanged && (BEEP_UPDATE_EVERY_SAMPLE != BEEP_UPDATE_POLICY))
+        return;
+
+#if BEEP_GPT_CADENCE
     updateBeepFrequency();
+#else
+    updateCadence(BEEP_DISABLED == previousState);
+#endif
 }
 
 /*******************************************************************************/
@@ -381,9 +723,18 @@ THD_FUNCTION(BeepControlThread, arg)
     (void)arg;
 
     chEvtObjectInit(&beeperEvent);
-
+    chVTObjectInit(&sequencerTimer);
+    loadSettings();
+    buildToneTable(ToneProfile_Get(toneProfileIndex));
+#if LATENCY_BENCH
+    LatencyBench_SetBeeperConfig(thresholds.lift, BEEP_UPDATE_POLICY);
+#endif
+
+#if BEEP_SYNTH
+    ToneSynth_Start();
+#else
     pwmStart(BEEP_PWM, &pwmcfg);
-    playStartupSignal();
+#endif
 
     event_listener_t beeperListener;
     chEvtRegisterMaskWithFlags(
@@ -391,6 +742,7 @@ THD_FUNCTION(BeepControlThread, arg)
             &beeperListener,
             EVENT_MASK(0),
             STEP_VOLUME  |
+            STEP_PROFILE |
             SYSTEM_SHUTDOWN);
 
     event_listener_t signalProcessorListener;
@@ -398,9 +750,19 @@ THD_FUNCTION(BeepControlThread, arg)
             &signalProcessorEvent,
             &signalProcessorListener,
             EVENT_MASK(1),
-            CALCULATION_FINISHED);
+            BEEP_UPDATE_FLAGS);
 
+#if BEEP_HW_GATE
+    pwmStart(BEEP_CADENCE_PWM, &cadencePwmConfig);
+#elif BEEP_GPT_CADENCE
     gptStart(BEEP_TIMER, &beepTimerConfig);
+#endif
+    playSequence(startupSignal, NULL);
+
+#if BEEP_UPDATE_POLICY == BEEP_UPDATE_FIXED_RATE
+    chVTObjectInit(&updateTimer);
+    chVTSet(&updateTimer, MS2ST(BEEP_UPDATE_PERIOD), updateTimerCallback, chThdGetSelfX());
+#endif
 
     while (1) {
         eventmask_t event = chEvtWaitAny(ALL_EVENTS);
@@ -410,15 +772,22 @@ THD_FUNCTION(BeepControlThread, arg)
             if (flags & STEP_VOLUME)
                 handleStepVolumeEvent();
 
+            if (flags & STEP_PROFILE)
+                handleStepProfileEvent();
+
             if (flags & SYSTEM_SHUTDOWN)
                 handleSystemShutdownEvent();
         }
         if (event & EVENT_MASK(1)) {
             eventflags_t flags = chEvtGetAndClearFlags(&signalProcessorListener);
 
-            if (flags & CALCULATION_FINISHED)
+            if (flags & BEEP_UPDATE_FLAGS)
                 handleSignalProcessorEvent();
         }
+#if BEEP_UPDATE_POLICY == BEEP_UPDATE_FIXED_RATE
+        if (event & EVENT_MASK(2))
+            handleSignalProcessorEvent();
+#endif
     }
 }
 
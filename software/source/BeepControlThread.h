@@ -26,7 +26,8 @@
 typedef enum {
         START_BEEP            = (1 << 0),
         STEP_VOLUME           = (1 << 1),
-        SYSTEM_SHUTDOWN       = (1 << 2)
+        SYSTEM_SHUTDOWN       = (1 << 2),
+        STEP_PROFILE          = (1 << 3)
 } BeeperEvent_t;
 
 /*******************************************************************************/
@@ -10,6 +10,7 @@
 #include "ch.h"
 #include "hal.h"
 #include "BeepControlThread.h"
+#include "TraceRing.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
@@ -50,6 +51,7 @@ static void buttonInterruptCallback(EXTDriver *extp, expchannel_t channel)
     (void)extp;
     (void)channel;
 
+    TRACE_RING_RECORD(TRACE_ISR_BUTTON, (uint8_t)palReadPad(GPIOB,GPIOB_BUTTON), 0);
     if (PAL_HIGH == palReadPad(GPIOB,GPIOB_BUTTON)) {
         start = chVTGetSystemTimeX();
         chSysLockFromISR();
@@ -111,6 +113,8 @@ THD_FUNCTION(ButtonHandlerThread, arg)
 
         if ((STEP_VOLUME_MIN <= pressDuration) && (pressDuration < STEP_VOLUME_MAX)) {
             chEvtBroadcastFlags(&beeperEvent, STEP_VOLUME);
+        } else if ((STEP_VOLUME_MAX <= pressDuration) && (pressDuration < SHUTDOWN_TIMEOUT)) {
+            chEvtBroadcastFlags(&beeperEvent, STEP_PROFILE);
         } else if (SHUTDOWN_TIMEOUT <= pressDuration) {
                 chEvtBroadcastFlags(&beeperEvent, SYSTEM_SHUTDOWN);
                 chSemWait(&shutdownBeepFinishedSemaphore);
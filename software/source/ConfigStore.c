@@ -0,0 +1,336 @@
+/**
+ * @file ConfigStore.c
+ * @brief Persistent settings in a log structured flash store.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ConfigStore.h"
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define CONFIG_PAGE_MAGIC                                             0x43464731UL
+#define CONFIG_RECORD_COUNT     ((CONFIG_STORE_PAGE_SIZE - 8) / sizeof(struct ConfigRecord_s))
+#define CONFIG_ERASED_KEY                                                  0xFFFF
+#define CONFIG_NO_PAGE                                                         -1
+
+#define FLASH_UNLOCK_KEY1                                             0x45670123UL
+#define FLASH_UNLOCK_KEY2                                             0xCDEF89ABUL
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct ConfigRecord_s {
+    uint16_t key;
+    uint16_t crc;               /**< CRC16-CCITT of key and value. */
+    uint32_t value;
+};
+
+/**
+ * The page with a valid magic and the highest sequence number is active.
+ * The header of a compacted page is written last, so an interrupted
+ * compaction leaves the old page active.
+ */
+struct ConfigPage_s {
+    uint32_t magic;
+    uint32_t sequence;
+    struct ConfigRecord_s records[CONFIG_RECORD_COUNT];
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+/*
+ * Volatile, the content is changed by flash programming. The linker script
+ * of the board reserves two pages for the .config_store section outside of
+ * the image, so a firmware update keeps the settings.
+ */
+static const volatile struct ConfigPage_s configPages[2]
+        __attribute__((section(".config_store")));
+
+static MUTEX_DECL(configMutex);
+
+static int32_t configValues[CONFIG_KEY_COUNT];
+static bool configValid[CONFIG_KEY_COUNT];
+static int32_t activePage = CONFIG_NO_PAGE;
+static uint32_t activeSequence;
+static size_t nextRecord;
+/* A failed write may have left a partial record, the next write compacts. */
+static bool compactionNeeded;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint16_t calculateCrc(uint16_t key, uint32_t value)
+{
+    uint8_t data[6] = {
+        (uint8_t)key, (uint8_t)(key >> 8),
+        (uint8_t)value, (uint8_t)(value >> 8),
+        (uint8_t)(value >> 16), (uint8_t)(value >> 24)
+    };
+    uint16_t crc = 0xFFFF;
+    size_t i, bit;
+
+    for (i = 0; i < sizeof(data); i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static bool isRecordErased(const volatile struct ConfigRecord_s *record)
+{
+    return (CONFIG_ERASED_KEY == record->key) &&
+           (0xFFFF == record->crc) &&
+           (0xFFFFFFFF == record->value);
+}
+
+static bool isPageErased(const volatile struct ConfigPage_s *page)
+{
+    const volatile uint32_t *word = (const volatile uint32_t *)page;
+    size_t i;
+    for (i = 0; i < CONFIG_STORE_PAGE_SIZE / sizeof(uint32_t); i++) {
+        if (0xFFFFFFFF != word[i])
+            return false;
+    }
+    return true;
+}
+
+static bool isPageValid(const volatile struct ConfigPage_s *page)
+{
+    return CONFIG_PAGE_MAGIC == page->magic;
+}
+
+/**
+ * Pick the active page, sequence numbers are compared wrap safe.
+ */
+static int32_t findActivePage(void)
+{
+    bool valid0 = isPageValid(&configPages[0]);
+    bool valid1 = isPageValid(&configPages[1]);
+
+    if (valid0 && valid1)
+        return ((int32_t)(configPages[1].sequence - configPages[0].sequence) > 0) ? 1 : 0;
+    if (valid0)
+        return 0;
+    if (valid1)
+        return 1;
+    return CONFIG_NO_PAGE;
+}
+
+/**
+ * Replay the records of the active page into the value cache.
+ */
+static void scanActivePage(void)
+{
+    const volatile struct ConfigPage_s *page = &configPages[activePage];
+    size_t i;
+
+    activeSequence = page->sequence;
+    nextRecord = 0;
+
+    for (i = 0; i < CONFIG_RECORD_COUNT; i++) {
+        const volatile struct ConfigRecord_s *record = &page->records[i];
+        if (isRecordErased(record))
+            continue;
+
+        /* Partially written records are skipped but not overwritten. */
+        nextRecord = i + 1;
+        if ((CONFIG_KEY_COUNT <= record->key) ||
+            (calculateCrc(record->key, record->value) != record->crc))
+            continue;
+
+        configValues[record->key] = (int32_t)record->value;
+        configValid[record->key] = true;
+    }
+}
+
+static void unlockFlash(void)
+{
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_UNLOCK_KEY1;
+        FLASH->KEYR = FLASH_UNLOCK_KEY2;
+    }
+}
+
+static void lockFlash(void)
+{
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+static bool waitForFlash(void)
+{
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+
+    bool success = !(FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR));
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+    return success;
+}
+
+static bool programHalfWord(const volatile void *address, uint16_t data)
+{
+    volatile uint16_t *target = (volatile uint16_t *)address;
+
+    FLASH->CR |= FLASH_CR_PG;
+    *target = data;
+    bool success = waitForFlash();
+    FLASH->CR &= ~FLASH_CR_PG;
+
+    return success && (*target == data);
+}
+
+static bool programWord(const volatile void *address, uint32_t data)
+{
+    const volatile uint16_t *target = (const volatile uint16_t *)address;
+    return programHalfWord(&target[0], (uint16_t)data) &&
+           programHalfWord(&target[1], (uint16_t)(data >> 16));
+}
+
+static bool erasePage(const volatile struct ConfigPage_s *page)
+{
+    if (isPageErased(page))
+        return true;
+
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = (uint32_t)(uintptr_t)page;
+    FLASH->CR |= FLASH_CR_STRT;
+    bool success = waitForFlash();
+    FLASH->CR &= ~FLASH_CR_PER;
+
+    return success && isPageErased(page);
+}
+
+/**
+ * Append a record, the key is written last to commit it.
+ */
+static bool programRecord(const volatile struct ConfigRecord_s *record, uint16_t key, int32_t value)
+{
+    return programWord(&record->value, (uint32_t)value) &&
+           programHalfWord(&record->crc, calculateCrc(key, (uint32_t)value)) &&
+           programHalfWord(&record->key, key);
+}
+
+static bool programHeader(const volatile struct ConfigPage_s *page, uint32_t sequence)
+{
+    return programWord(&page->sequence, sequence) &&
+           programWord(&page->magic, CONFIG_PAGE_MAGIC);
+}
+
+/**
+ * Copy the latest value of every key and the new value into the other page
+ * and make it active. The state only changes when the page is complete.
+ */
+static bool compact(ConfigKey_t newKey, int32_t newValue)
+{
+    int32_t target = (CONFIG_NO_PAGE == activePage) ? 0 : 1 - activePage;
+    const volatile struct ConfigPage_s *page = &configPages[target];
+    size_t record = 0;
+    size_t key;
+
+    if (!erasePage(page))
+        return false;
+
+    for (key = 0; key < CONFIG_KEY_COUNT; key++) {
+        int32_t value = configValues[key];
+        if (newKey == key)
+            value = newValue;
+        else if (!configValid[key])
+            continue;
+        if (!programRecord(&page->records[record], (uint16_t)key, value))
+            return false;
+        record++;
+    }
+
+    if (!programHeader(page, activeSequence + 1))
+        return false;
+
+    int32_t oldPage = activePage;
+    activePage = target;
+    activeSequence++;
+    nextRecord = record;
+
+    /* A leftover old page is harmless, its sequence number is lower. */
+    if (CONFIG_NO_PAGE != oldPage)
+        erasePage(&configPages[oldPage]);
+
+    return true;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void ConfigStore_Init(void)
+{
+    activePage = findActivePage();
+    if (CONFIG_NO_PAGE != activePage)
+        scanActivePage();
+}
+
+bool ConfigStore_Get(ConfigKey_t key, int32_t *value)
+{
+    if (CONFIG_KEY_COUNT <= key)
+        return false;
+
+    chMtxLock(&configMutex);
+    bool valid = configValid[key];
+    if (valid)
+        *value = configValues[key];
+    chMtxUnlock(&configMutex);
+
+    return valid;
+}
+
+bool ConfigStore_Set(ConfigKey_t key, int32_t value)
+{
+    if (CONFIG_KEY_COUNT <= key)
+        return false;
+
+    chMtxLock(&configMutex);
+
+    if (configValid[key] && (configValues[key] == value)) {
+        chMtxUnlock(&configMutex);
+        return true;
+    }
+
+    unlockFlash();
+    bool success;
+    if (compactionNeeded || (CONFIG_NO_PAGE == activePage) || (CONFIG_RECORD_COUNT <= nextRecord)) {
+        /* Compaction also writes the new value. */
+        success = compact(key, value);
+    } else {
+        success = programRecord(
+                &configPages[activePage].records[nextRecord],
+                (uint16_t)key,
+                value);
+        if (success)
+            nextRecord++;
+    }
+    lockFlash();
+
+    compactionNeeded = !success;
+    if (success) {
+        configValues[key] = value;
+        configValid[key] = true;
+    }
+
+    chMtxUnlock(&configMutex);
+    return success;
+}
+
+/******************************* END OF FILE ***********************************/
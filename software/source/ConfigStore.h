@@ -0,0 +1,83 @@
+/**
+ * @file ConfigStore.h
+ * @brief Persistent settings in a log structured flash store.
+ * @author Molnar Zoltan
+ */
+
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define CONFIG_STORE_PAGE_SIZE                                               1024
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+/**
+ * Key names of the shell config command and the tuner output, in the order
+ * of ConfigKey_t.
+ */
+#define CONFIG_KEY_NAMES                                                        \
+    "volume", "profile", "lift", "liftoff", "sink", "sinkoff", "alpha", "beta", "length"
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Keys of the stored settings, new keys have to be appended.
+ */
+typedef enum {
+    CONFIG_KEY_VOLUME,
+    CONFIG_KEY_TONE_PROFILE,
+    CONFIG_KEY_LIFT_THRESHOLD,          /**< cm/s. */
+    CONFIG_KEY_LIFT_OFF_THRESHOLD,      /**< cm/s. */
+    CONFIG_KEY_SINK_THRESHOLD,          /**< cm/s. */
+    CONFIG_KEY_SINK_OFF_THRESHOLD,      /**< cm/s. */
+    CONFIG_KEY_FILTER_ALPHA,            /**< 1e-4. */
+    CONFIG_KEY_FILTER_BETA,             /**< 1e-6. */
+    CONFIG_KEY_REGRESSION_LENGTH,       /**< Samples. */
+    CONFIG_KEY_COUNT
+} ConfigKey_t;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Load the latest value of every key.
+ * @brief The active page is scanned once from the start, later records
+ *        override earlier ones and records with a bad CRC are skipped.
+ *        Nothing is written, so this is safe to call early at boot.
+ */
+void ConfigStore_Init(void);
+
+/**
+ * Get the stored value of a key.
+ * @return false if the key was never stored.
+ */
+bool ConfigStore_Get(ConfigKey_t key, int32_t *value);
+
+/**
+ * Store a new value of a key.
+ * @brief Unchanged values are not written. The record is appended to the
+ *        active page, a full page is compacted into the other page by
+ *        copying only the latest value of each key. Erasing a page stalls
+ *        code execution from flash for tens of ms.
+ * @return false if the flash could not be programmed.
+ */
+bool ConfigStore_Set(ConfigKey_t key, int32_t value);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,103 @@
+/**
+ * @file CycleProbe.c
+ * @brief Cycle counter probes around the hot paths, with per probe
+ *        statistics and log2 histograms in RAM.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "CycleProbe.h"
+
+#if CYCLE_PROBES
+#include "ch.h"
+
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char * const probeNames[PROBE_COUNT] = {
+    "ms5611",
+    "alphabeta",
+    "altitude",
+    "slope",
+    "nmea",
+    "beeptimer",
+    "interval",
+    "jitter"
+};
+
+struct CycleProbe_s cycleProbes[PROBE_COUNT];
+
+static uint32_t lastSample;
+static uint32_t lastInterval;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void CycleProbe_Init(void) {
+#if !defined(VARIO_SIM)
+    /* The RT port enables it as well, the probes must not depend on that. */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    CycleProbe_Reset();
+}
+
+void CycleProbe_Reset(void) {
+    size_t i;
+
+    chSysLock();
+    memset(cycleProbes, 0, sizeof(cycleProbes));
+    for (i = 0; i < PROBE_COUNT; i++)
+        cycleProbes[i].min = UINT32_MAX;
+    lastSample = 0;
+    lastInterval = 0;
+    chSysUnlock();
+}
+
+const char *CycleProbe_Name(CycleProbe_t probe) {
+    return (probe < PROBE_COUNT) ? probeNames[probe] : "";
+}
+
+/**
+ * The jitter is the change of the interval from one sample to the next, so
+ * a slow drift of the clocks does not show up as jitter.
+ */
+void CycleProbe_Sample(uint32_t now) {
+    if (0 != lastSample) {
+        uint32_t interval = now - lastSample;
+        if (0 != lastInterval) {
+            uint32_t jitter = (lastInterval < interval) ? interval - lastInterval : lastInterval - interval;
+            CycleProbe_Record(&cycleProbes[PROBE_SAMPLE_JITTER], jitter);
+        }
+        CycleProbe_Record(&cycleProbes[PROBE_SAMPLE_INTERVAL], interval);
+        lastInterval = interval;
+    }
+    lastSample = now;
+}
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,134 @@
+/**
+ * @file CycleProbe.h
+ * @brief Cycle counter probes around the hot paths, with per probe
+ *        statistics and log2 histograms in RAM.
+ * @author Molnar Zoltan
+ *
+ * Probes are only compiled with CYCLE_PROBES (USE_CYCLE_PROBES=yes), in
+ * other builds the macros expand to nothing and no RAM is used. The clock
+ * is the DWT cycle counter, in the simulator the host clock in us. A probe
+ * costs two counter reads and an inline update of a few instructions, the
+ * bucket index is a single CLZ.
+ *
+ * The statistics are read from cycleProbes with the debugger or the shell.
+ */
+
+#ifndef CYCLEPROBE_H
+#define CYCLEPROBE_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/*
+ * Also included by the host build of the signal chain, which has no hal.h,
+ * the flag is only set by the firmware build where TRUE comes from hal.h.
+ */
+#if defined(CYCLE_PROBES)
+#include "hal.h"
+#else
+#define CYCLE_PROBES                                                            0
+#endif
+
+/** Bucket n counts durations of 2^n .. 2^(n+1) - 1 cycles, the last one the rest. */
+#define CYCLE_PROBE_BUCKETS                                                    24
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    PROBE_MS5611_MEASURE,       /**< Conversions including the waits. */
+    PROBE_ALPHA_BETA,
+    PROBE_ALTITUDE,
+    PROBE_SLOPE,
+    PROBE_NMEA_MESSAGE,         /**< Formatting of the LXWP0 sentence. */
+    PROBE_BEEP_TIMER,           /**< Beep timer interrupt of the GPT cadence. */
+    PROBE_SAMPLE_INTERVAL,      /**< Time between pressure samples. */
+    PROBE_SAMPLE_JITTER,        /**< Change of the sample interval. */
+    PROBE_COUNT
+} CycleProbe_t;
+
+struct CycleProbe_s {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t histogram[CYCLE_PROBE_BUCKETS];
+};
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#if CYCLE_PROBES
+#if defined(VARIO_SIM)
+#define CYCLE_PROBE_CLOCK()                               SimHal_Microseconds()
+#else
+#define CYCLE_PROBE_CLOCK()                                         DWT->CYCCNT
+#endif
+
+/** Start timing a probe, opens a declaration in the current block. */
+#define CYCLE_PROBE_BEGIN(probe)                                                 \
+    uint32_t cycleProbeStart_##probe = CYCLE_PROBE_CLOCK()
+
+/** Stop timing a probe started in the same block. */
+#define CYCLE_PROBE_END(probe)                                                   \
+    CycleProbe_Record(&cycleProbes[probe], CYCLE_PROBE_CLOCK() - cycleProbeStart_##probe)
+
+/** Record the interval and jitter of the pressure samples. */
+#define CYCLE_PROBE_SAMPLE()                       CycleProbe_Sample(CYCLE_PROBE_CLOCK())
+#else
+#define CYCLE_PROBE_BEGIN(probe)
+#define CYCLE_PROBE_END(probe)
+#define CYCLE_PROBE_SAMPLE()
+#endif
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+#if CYCLE_PROBES
+extern struct CycleProbe_s cycleProbes[PROBE_COUNT];
+#endif
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+#if CYCLE_PROBES
+/**
+ * Enable the cycle counter and clear the statistics.
+ */
+void CycleProbe_Init(void);
+
+/**
+ * Clear the statistics, the probes keep running.
+ */
+void CycleProbe_Reset(void);
+
+const char *CycleProbe_Name(CycleProbe_t probe);
+
+void CycleProbe_Sample(uint32_t now);
+
+/**
+ * Add a duration to a probe, inline to keep the probe cheap.
+ * @brief Probes in threads of different priority never share an entry,
+ *        so no lock is needed.
+ */
+static inline void CycleProbe_Record(struct CycleProbe_s *probe, uint32_t cycles) {
+    uint32_t bucket = 31 - (uint32_t)__builtin_clz(cycles | 1);
+
+    probe->count++;
+    probe->sum += cycles;
+    if (cycles < probe->min)
+        probe->min = cycles;
+    if (probe->max < cycles)
+        probe->max = cycles;
+    probe->histogram[(bucket < CYCLE_PROBE_BUCKETS) ? bucket : CYCLE_PROBE_BUCKETS - 1]++;
+}
+#endif
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,502 @@
+/**
+ * @file DiagShell.c
+ * @brief Diagnostics command shell on the Kobo link.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "DiagShell.h"
+
+#if DIAG_SHELL
+#include "ConfigStore.h"
+#include "CycleProbe.h"
+#include "NmeaGeneratorThread.h"
+#include "PipelineMonitor.h"
+#include "SerialHandlerThread.h"
+#include "SignalProcessorThread.h"
+#include "SimulatorThread.h"
+#include "ThreadStats.h"
+#include "VarioKernels.h"
+#include "chprintf.h"
+#include "hal.h"
+#include "ms5611.h"
+#if !defined(VARIO_SIM)
+#include "test.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define SHELL_SERIAL                                      ((BaseChannel *)&SD1)
+#define SHELL_LINE_LENGTH                                                      64
+#define SHELL_MAX_ARGS                                                          4
+
+/* Wait for the thread report requested from the NMEA generator, in 100 ms. */
+#define THREADS_REPORT_TIMEOUT                                                 30
+
+/* Samples printed by stream without a count. */
+#define STREAM_DEFAULT_COUNT                                                  100
+
+/* Calls per round and rounds of the kernel benchmarks, the best round counts. */
+#define BENCH_CALLS                                                           100
+#define BENCH_ROUNDS                                                            5
+
+#if defined(VARIO_SIM)
+/* The simulator clock counts us of host time. */
+#define BENCH_UNIT                                                           "ns"
+#define BENCH_TICK_SCALE                                                     1000
+#else
+#define BENCH_UNIT                                                       "cycles"
+#define BENCH_TICK_SCALE                                                        1
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef void (*ShellFunction_t)(BaseSequentialStream *chp, int argc, char *argv[]);
+
+struct ShellCommand_s {
+    const char *name;
+    ShellFunction_t function;
+    const char *help;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+static void cmdHelp(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdStream(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdCounters(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdDeadlines(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdThreads(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdProm(BaseSequentialStream *chp, int argc, char *argv[]);
+static void cmdBench(BaseSequentialStream *chp, int argc, char *argv[]);
+#if !defined(VARIO_SIM)
+static void cmdRtBench(BaseSequentialStream *chp, int argc, char *argv[]);
+#endif
+static void cmdConfig(BaseSequentialStream *chp, int argc, char *argv[]);
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const struct ShellCommand_s commands[] = {
+    {"help",      cmdHelp,      "list the commands"},
+    {"stream",    cmdStream,    "[count] raw and filtered samples, any key stops"},
+    {"counters",  cmdCounters,  "[reset] pipeline and traffic counters"},
+    {"deadlines", cmdDeadlines, "pipeline progress and deadline misses"},
+    {"threads",   cmdThreads,   "thread table, CPU and stack of the next report with USE_THREAD_STATS"},
+    {"prom",      cmdProm,      "MS5611 PROM coefficients"},
+    {"bench",     cmdBench,     "cost of the signal chain kernels per call"},
+#if !defined(VARIO_SIM)
+    {"rtbench",   cmdRtBench,   "ChibiOS test suite and benchmarks"},
+#endif
+    {"config",    cmdConfig,    "[key value] list or store a setting"},
+    {"exit",      NULL,         "back to NMEA"},
+    {NULL,        NULL,         NULL}
+};
+
+static const char * const configKeyNames[CONFIG_KEY_COUNT] = {CONFIG_KEY_NAMES};
+
+#if THREAD_STATS
+static struct ThreadStatsReport_s threadReport;
+#endif
+
+/* Input of the slope benchmark, too large for the shell stack. */
+static float benchBuffer[SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH];
+static volatile float benchSink;
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t readClock(void) {
+#if defined(VARIO_SIM)
+    return SimHal_Microseconds();
+#else
+    return chSysGetRealtimeCounterX();
+#endif
+}
+
+static bool isKeyPressed(void) {
+    return STM_TIMEOUT != chnGetTimeout(SHELL_SERIAL, TIME_IMMEDIATE);
+}
+
+static void waitForMagic(void) {
+    const char *magic = DIAG_SHELL_MAGIC;
+    size_t matched = 0;
+
+    while ('\0' != magic[matched]) {
+        msg_t c = chnGetTimeout(SHELL_SERIAL, TIME_INFINITE);
+        if (magic[matched] == c)
+            matched++;
+        else
+            matched = (magic[0] == c) ? 1 : 0;
+    }
+}
+
+/**
+ * Read a line with echo and backspace.
+ * @return false after DIAG_SHELL_IDLE_TIMEOUT seconds without input.
+ */
+static bool readLine(BaseSequentialStream *chp, char *line, size_t size) {
+    unsigned idle = 0;
+    size_t length = 0;
+
+    while (idle < DIAG_SHELL_IDLE_TIMEOUT) {
+        msg_t c = chnGetTimeout(SHELL_SERIAL, S2ST(1));
+        if (STM_TIMEOUT == c) {
+            idle++;
+            continue;
+        }
+        idle = 0;
+
+        if (('\r' == c) || ('\n' == c)) {
+            if (0 == length)
+                continue;
+            chprintf(chp, "\r\n");
+            line[length] = '\0';
+            return true;
+        }
+        if ((('\b' == c) || (0x7f == c)) && (0 < length)) {
+            length--;
+            chprintf(chp, "\b \b");
+        } else if ((' ' <= c) && (c < 0x7f) && (length < size - 1)) {
+            line[length++] = (char)c;
+            streamPut(chp, (uint8_t)c);
+        }
+    }
+
+    return false;
+}
+
+static int splitLine(char *line, char *argv[]) {
+    int argc = 0;
+    char *token = strtok(line, " \t");
+
+    while ((NULL != token) && (argc < SHELL_MAX_ARGS)) {
+        argv[argc++] = token;
+        token = strtok(NULL, " \t");
+    }
+
+    return argc;
+}
+
+static void cmdHelp(BaseSequentialStream *chp, int argc, char *argv[]) {
+    const struct ShellCommand_s *command;
+
+    (void)argc;
+    (void)argv;
+
+    for (command = commands; NULL != command->name; command++)
+        chprintf(chp, "  %-9s %s\r\n", command->name, command->help);
+}
+
+static void cmdStream(BaseSequentialStream *chp, int argc, char *argv[]) {
+    uint32_t count = (0 < argc) ? (uint32_t)atoi(argv[0]) : STREAM_DEFAULT_COUNT;
+    event_listener_t listener;
+    uint32_t i;
+
+    chEvtRegisterMaskWithFlags(&signalProcessorEvent, &listener, EVENT_MASK(0), CALCULATION_FINISHED);
+    chprintf(chp, "time_ms pressure_pa filtered_pa altitude_m vario_ms early_ms\r\n");
+
+    for (i = 0; (i < count) && !isKeyPressed(); ) {
+        struct SignalProcessingOutputData_s data;
+
+        if (0 == chEvtWaitAnyTimeout(EVENT_MASK(0), S2ST(1)))
+            continue;
+        if (0 == (chEvtGetAndClearFlags(&listener) & CALCULATION_FINISHED))
+            continue;
+
+        chMtxLock(&SignalProcessorMutex);
+        data = SignalProcessingOutputData;
+        chMtxUnlock(&SignalProcessorMutex);
+
+        chprintf(chp, "%u %u %.2f %.2f %.2f %.2f\r\n",
+                (unsigned)ST2MS(chVTGetSystemTime()),
+                (unsigned)data.pressure,
+                data.filteredPressure,
+                data.baroAltitude,
+                data.vario,
+                data.earlyVario);
+        i++;
+    }
+
+    chEvtUnregister(&signalProcessorEvent, &listener);
+}
+
+static void cmdCounters(BaseSequentialStream *chp, int argc, char *argv[]) {
+    size_t i;
+
+    (void)argv;
+
+    chprintf(chp, "gps     received sentences/bytes  forwarded sentences/bytes\r\n");
+    for (i = 0; i < nmeaFilterRuleCount; i++) {
+        const struct NmeaFilterStatistics_s *stat = &nmeaFilterStatistics[i];
+        chprintf(chp, "  %-4s %10u %10u %10u %10u\r\n",
+                ('\0' != stat->type[0]) ? stat->type : "*",
+                (unsigned)stat->receivedSentences, (unsigned)stat->receivedBytes,
+                (unsigned)stat->forwardedSentences, (unsigned)stat->forwardedBytes);
+    }
+    chprintf(chp, "nmea late messages %u\r\n", (unsigned)nmeaLateMessages);
+
+#ifdef USE_SIMULATED_DATA
+    chprintf(chp, "simulator samples %u overruns %u loops %u\r\n",
+            (unsigned)SimulatorStatistics.samples,
+            (unsigned)SimulatorStatistics.overruns,
+            (unsigned)SimulatorStatistics.scriptLoops);
+#endif
+
+#if CYCLE_PROBES
+    chprintf(chp, "probe          count        min       mean        max\r\n");
+    for (i = 0; i < PROBE_COUNT; i++) {
+        const struct CycleProbe_s *probe = &cycleProbes[i];
+        if (0 == probe->count)
+            continue;
+        chprintf(chp, "  %-10s %8u %10u %10u %10u\r\n",
+                CycleProbe_Name((CycleProbe_t)i), (unsigned)probe->count, (unsigned)probe->min,
+                (unsigned)(probe->sum / probe->count), (unsigned)probe->max);
+    }
+    if (0 < argc)
+        CycleProbe_Reset();
+#else
+    (void)argc;
+#endif
+}
+
+static void cmdDeadlines(BaseSequentialStream *chp, int argc, char *argv[]) {
+    size_t i;
+
+    (void)argc;
+    (void)argv;
+
+    chprintf(chp, "uptime %u ms, last reset %s\r\n", (unsigned)PipelineMonitor_Uptime(),
+            pipelineWatchdogReset ? "by the watchdog" : "normal");
+    chprintf(chp, "stage       progress deadline  max gap   misses  last miss\r\n");
+    for (i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        const struct PipelineStage_s *stage = &pipelineStages[i];
+        chprintf(chp, "  %-9s %8u %8u %8u %8u %10u\r\n",
+                PipelineMonitor_Name((PipelineStage_t)i), (unsigned)stage->progress,
+                (unsigned)stage->deadline, (unsigned)stage->maxGap,
+                (unsigned)stage->misses, (unsigned)stage->lastMissTime);
+    }
+}
+
+static void cmdThreads(BaseSequentialStream *chp, int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+#if THREAD_STATS
+    uint32_t sequence = ThreadStats_ReportSequence();
+    uint32_t share;
+    size_t i;
+
+    /* Taking a report restarts the period, so the report of the NMEA
+     * output is requested and printed instead. */
+    ThreadStats_Request();
+    for (i = 0; (i < THREADS_REPORT_TIMEOUT) && (sequence == ThreadStats_ReportSequence()); i++)
+        chThdSleepMilliseconds(100);
+    if (sequence == ThreadStats_ReportSequence()) {
+        chprintf(chp, "no report from the NMEA generator\r\n");
+        return;
+    }
+
+    ThreadStats_GetReport(&threadReport);
+    chprintf(chp, "name                   prio   cpu %%  stack free\r\n");
+    for (i = 0; i < threadReport.threadCount; i++) {
+        const struct ThreadStatsEntry_s *entry = &threadReport.threads[i];
+        share = ThreadStats_Permille(entry->cycles, threadReport.cycles);
+        chprintf(chp, "  %-20s %4u %4u.%u %11d\r\n",
+                (NULL != entry->name) ? entry->name : "",
+                (unsigned)entry->priority, (unsigned)(share / 10), (unsigned)(share % 10),
+                (SIZE_MAX != entry->stackUnused) ? (int)entry->stackUnused : -1);
+    }
+    share = ThreadStats_Permille(threadReport.idleCycles, threadReport.cycles);
+    chprintf(chp, "idle %u.%u %%, %u switches, irq stack free %d\r\n",
+            (unsigned)(share / 10), (unsigned)(share % 10), (unsigned)threadReport.switches,
+            (SIZE_MAX != threadReport.irqStackUnused) ? (int)threadReport.irqStackUnused : -1);
+#else
+    static const char * const states[] = {CH_STATE_NAMES};
+    thread_t *tp = chRegFirstThread();
+
+    chprintf(chp, "name                   prio state\r\n");
+    do {
+        chprintf(chp, "  %-20s %4u %s\r\n",
+                (NULL != tp->p_name) ? tp->p_name : "",
+                (unsigned)tp->p_prio, states[tp->p_state]);
+        tp = chRegNextThread(tp);
+    } while (NULL != tp);
+#endif
+}
+
+static void cmdProm(BaseSequentialStream *chp, int argc, char *argv[]) {
+    const struct Ms5611Calibration_s *calibration = MS5611_GetCalibration();
+
+    (void)argc;
+    (void)argv;
+
+    chprintf(chp, "C1 %u C2 %u C3 %u C4 %u C5 %u C6 %u\r\n",
+            calibration->c1, calibration->c2, calibration->c3,
+            calibration->c4, calibration->c5, calibration->c6);
+}
+
+/**
+ * Best time of BENCH_ROUNDS rounds per call, the shell runs at low
+ * priority and a round may be preempted.
+ */
+static uint32_t benchKernel(int kernel) {
+    uint32_t best = UINT32_MAX;
+    int round, i;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        float position = 95000, velocity = 0;
+        struct Lxwp0Data_s lxwp0 = {1234.5f, 1.2f, 3.4f, 270.0f, true};
+        char nmea[80];
+        uint32_t start = readClock();
+
+        for (i = 0; i < BENCH_CALLS; i++) {
+            switch (kernel) {
+            case 0:
+                benchSink = VarioKernels_AlphaBetaFilter(0.2f, 0.004f, &position, &velocity, 95000.0f + (i & 7), 20);
+                break;
+            case 1:
+                benchSink = VarioKernels_PressureToAltitude(95000.0f + i);
+                break;
+            case 2:
+                benchSink = VarioKernels_Slope(benchBuffer, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH,
+                        (size_t)i % SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH, SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH, 0.02f);
+                break;
+            default:
+                lxwp0.vario = i * 0.01f;
+                benchSink = (float)VarioKernels_FormatLxwp0(nmea, sizeof(nmea), &lxwp0);
+                break;
+            }
+        }
+
+        uint32_t elapsed = readClock() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best * BENCH_TICK_SCALE / BENCH_CALLS;
+}
+
+static void cmdBench(BaseSequentialStream *chp, int argc, char *argv[]) {
+    static const char * const kernelNames[] = {"alphabeta", "altitude", "slope", "lxwp0"};
+    size_t i;
+
+    (void)argc;
+    (void)argv;
+
+    for (i = 0; i < SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH; i++)
+        benchBuffer[i] = 500.0f + i * 0.02f;
+
+    for (i = 0; i < sizeof(kernelNames) / sizeof(kernelNames[0]); i++)
+        chprintf(chp, "  %-10s %8u %s per call\r\n", kernelNames[i], (unsigned)benchKernel((int)i), BENCH_UNIT);
+}
+
+#if !defined(VARIO_SIM)
+/**
+ * The test threads run relative to the shell priority, below the vario
+ * threads, so the measured costs include their interference.
+ */
+static void cmdRtBench(BaseSequentialStream *chp, int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    chprintf(chp, "running the ChibiOS test suite, the benchmarks come last\r\n");
+    TestThread(chp);
+}
+#endif
+
+static void cmdConfig(BaseSequentialStream *chp, int argc, char *argv[]) {
+    size_t key;
+    int32_t value;
+
+    if (2 == argc) {
+        for (key = 0; key < CONFIG_KEY_COUNT; key++) {
+            if (0 == strcmp(argv[0], configKeyNames[key]))
+                break;
+        }
+        if (CONFIG_KEY_COUNT == key) {
+            chprintf(chp, "unknown key %s\r\n", argv[0]);
+            return;
+        }
+        if (ConfigStore_Set((ConfigKey_t)key, atoi(argv[1])))
+            chprintf(chp, "stored, active after restart\r\n");
+        else
+            chprintf(chp, "flash write failed\r\n");
+        return;
+    }
+
+    for (key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (ConfigStore_Get((ConfigKey_t)key, &value))
+            chprintf(chp, "  %-8s %d\r\n", configKeyNames[key], (int)value);
+        else
+            chprintf(chp, "  %-8s default\r\n", configKeyNames[key]);
+    }
+}
+
+/**
+ * Run commands until exit or the idle timeout.
+ */
+static void runShell(BaseSequentialStream *chp) {
+    char line[SHELL_LINE_LENGTH];
+    char *argv[SHELL_MAX_ARGS];
+
+    chprintf(chp, "\r\nvario diagnostics, help lists the commands\r\n");
+
+    while (1) {
+        const struct ShellCommand_s *command;
+
+        chprintf(chp, "> ");
+        if (!readLine(chp, line, sizeof(line)))
+            break;
+
+        /* Comments, config files of the tuner can be pasted. */
+        int argc = splitLine(line, argv);
+        if ((0 == argc) || ('#' == argv[0][0]))
+            continue;
+
+        for (command = commands; NULL != command->name; command++) {
+            if (0 == strcmp(argv[0], command->name))
+                break;
+        }
+
+        if (NULL == command->name)
+            chprintf(chp, "unknown command %s\r\n", argv[0]);
+        else if (NULL == command->function)
+            break;
+        else
+            command->function(chp, argc - 1, argv + 1);
+    }
+
+    chprintf(chp, "back to NMEA\r\n");
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+THD_FUNCTION(DiagShellThread, arg)
+{
+    (void)arg;
+
+    chRegSetThreadName("DiagShellThread");
+
+    while (1) {
+        waitForMagic();
+        SerialHandler_AcquireKobo();
+        runShell((BaseSequentialStream *)&SD1);
+        SerialHandler_ReleaseKobo();
+    }
+}
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,62 @@
+/**
+ * @file DiagShell.h
+ * @brief Diagnostics command shell on the Kobo link.
+ * @author Molnar Zoltan
+ *
+ * Built with DIAG_SHELL (USE_DIAG_SHELL=yes). The shell thread reads SD1,
+ * which carries nothing else towards the vario, and waits for
+ * DIAG_SHELL_MAGIC. '~' is a reserved character of NMEA 0183, so the
+ * sequence never shows up in the traffic of XCSoar. Once it is received
+ * the serial handler hands the link over between two sentences, the NMEA
+ * and GPS output is dropped until "exit" or DIAG_SHELL_IDLE_TIMEOUT
+ * seconds without input. "help" lists the commands.
+ */
+
+#ifndef DIAGSHELL_H
+#define DIAGSHELL_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if !defined(DIAG_SHELL)
+#define DIAG_SHELL                                                          FALSE
+#endif
+
+#define DIAG_SHELL_MAGIC                                                    "~~~"
+
+/** Seconds without input after which the link goes back to NMEA. */
+#if !defined(DIAG_SHELL_IDLE_TIMEOUT)
+#define DIAG_SHELL_IDLE_TIMEOUT                                               120
+#endif
+
+/**
+ * Below the main thread, the RTOS benchmarks run their threads relative to
+ * the shell and the watchdog has to be fed meanwhile.
+ */
+#define DIAG_SHELL_PRIORITY                                      (NORMALPRIO - 10)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(DiagShellThread, arg);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
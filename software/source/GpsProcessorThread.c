@@ -0,0 +1,277 @@
+/**
+ * @file GpsProcessorThread.c
+ * @brief Thread to combine GPS fixes with barometric data.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "GpsProcessorThread.h"
+#include "SerialHandlerThread.h"
+#include "SignalProcessorThread.h"
+#include "ThermalMap.h"
+#include "TraceRing.h"
+#include "WindEstimator.h"
+
+#include <math.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define STANDARD_PRESSURE                                               (101325.0f)
+#define ATMOSPHERE_HEIGHT                                                 (44330.0f)
+#define ATMOSPHERE_EXPONENT                                                (0.1902f)
+
+#define QNH_INITIAL_VARIANCE                                     (2000.0f * 2000.0f)
+#define QNH_PROCESS_NOISE                                                   (1.0f)
+#define QNH_INNOVATION_GATE                                                 (5.0f)
+#define QNH_MAX_REJECTED_FIXES                                                 10
+#define QNH_VALID_VARIANCE                                         (50.0f * 50.0f)
+
+#define GPS_UERE                                                            (5.0f)
+#define GPS_VERTICAL_FACTOR                                                 (2.0f)
+#define GPS_MIN_SATELLITES                                                      5
+#define GPS_MAX_HDOP                                                        (3.0f)
+#define MS_PER_DAY                                                      86400000UL
+#define WIND_MAX_AGE                                                      1800000UL
+#define THERMAL_CORE_PERIOD                                                   1000
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Scalar Kalman filter estimating the sea level pressure.
+ */
+struct QnhEstimator_s {
+    float qnh;
+    float variance;
+    uint32_t lastTime;
+    uint32_t rejectedFixes;
+    bool initialized;
+};
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+MUTEX_DECL(GpsProcessorMutex);
+
+struct GpsProcessingOutputData_s GpsProcessingOutputData = {
+    STANDARD_PRESSURE,
+    1.0f,
+    0.0f,
+    0.0f,
+    false,
+    0.0f,
+    0.0f,
+    false,
+    {0.0f, 0.0f, 0.0f, false}
+};
+
+static struct QnhEstimator_s qnhEstimator;
+static struct WindEstimator_s windEstimator;
+static struct ThermalMap_s thermalMap;
+static uint32_t thermalCoreTime;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static bool isFixUsable(const struct GpsFix_s *fix)
+{
+    return (0 < fix->quality) &&
+           (GPS_MIN_SATELLITES <= fix->satellites) &&
+           (fix->hdop <= GPS_MAX_HDOP);
+}
+
+static float calculateElapsedTimeInSec(uint32_t t1, uint32_t t2)
+{
+    /* GPS time of day wraps at midnight. */
+    if (t2 < t1)
+        t2 += MS_PER_DAY;
+
+    return (t2 - t1) / 1000.0f;
+}
+
+static void resetQnhEstimate(struct QnhEstimator_s *estimator, float qnh, uint32_t time)
+{
+    estimator->qnh = qnh;
+    estimator->variance = QNH_INITIAL_VARIANCE;
+    estimator->lastTime = time;
+    estimator->rejectedFixes = 0;
+    estimator->initialized = true;
+}
+
+/**
+ * Update QNH estimate with a GPS altitude measurement.
+ * @brief The measurement is the sea level pressure that makes the standard
+ *        atmosphere altitude of the current pressure equal to the GPS
+ *        altitude. Its variance follows from the GPS vertical error.
+ */
+static void updateQnhEstimate(
+        struct QnhEstimator_s *estimator,
+        const struct GpsFix_s *fix,
+        float pressure) {
+    float heightRatio = 1 - fix->altitude / ATMOSPHERE_HEIGHT;
+    float measuredQnh = pressure * powf(heightRatio, -1 / ATMOSPHERE_EXPONENT);
+
+    if (!estimator->initialized) {
+        resetQnhEstimate(estimator, measuredQnh, fix->time);
+        return;
+    }
+
+    float dt = calculateElapsedTimeInSec(estimator->lastTime, fix->time);
+    estimator->lastTime = fix->time;
+    estimator->variance += QNH_PROCESS_NOISE * dt;
+
+    float altitudeError = GPS_VERTICAL_FACTOR * GPS_UERE * fix->hdop;
+    float qnhPerMeter = measuredQnh / (ATMOSPHERE_EXPONENT * ATMOSPHERE_HEIGHT * heightRatio);
+    float measurementVariance = altitudeError * altitudeError * qnhPerMeter * qnhPerMeter;
+
+    float innovation = measuredQnh - estimator->qnh;
+    float innovationVariance = estimator->variance + measurementVariance;
+
+    if (innovation * innovation >
+            QNH_INNOVATION_GATE * QNH_INNOVATION_GATE * innovationVariance) {
+        if (QNH_MAX_REJECTED_FIXES < ++estimator->rejectedFixes)
+            resetQnhEstimate(estimator, measuredQnh, fix->time);
+        return;
+    }
+
+    float gain = estimator->variance / innovationVariance;
+    estimator->qnh += gain * innovation;
+    estimator->variance *= (1 - gain);
+    estimator->rejectedFixes = 0;
+}
+
+static void readGpsData(struct GpsFix_s *fix)
+{
+    chMtxLock(&GpsDataMutex);
+    *fix = GpsData;
+    chMtxUnlock(&GpsDataMutex);
+}
+
+static void readMeasurementData(struct SignalProcessingOutputData_s *data)
+{
+    TRACE_RING_MUTEX_LOCK(&SignalProcessorMutex);
+    *data = SignalProcessingOutputData;
+    chMtxUnlock(&SignalProcessorMutex);
+}
+
+static void publishQnh(const struct QnhEstimator_s *estimator, float baroAltitude)
+{
+    float scale = powf(STANDARD_PRESSURE / estimator->qnh, ATMOSPHERE_EXPONENT);
+    float offset = ATMOSPHERE_HEIGHT * (1 - scale);
+
+    chMtxLock(&GpsProcessorMutex);
+    GpsProcessingOutputData.qnh = estimator->qnh;
+    GpsProcessingOutputData.altitudeScale = scale;
+    GpsProcessingOutputData.altitudeOffset = offset;
+    GpsProcessingOutputData.fusedAltitude = baroAltitude * scale + offset;
+    GpsProcessingOutputData.qnhValid = estimator->variance < QNH_VALID_VARIANCE;
+    chMtxUnlock(&GpsProcessorMutex);
+}
+
+/**
+ * Re-estimate the thermal core once per THERMAL_CORE_PERIOD, the map itself
+ * is updated on every fix.
+ */
+static void updateThermalCore(uint32_t time)
+{
+    if (calculateElapsedTimeInSec(thermalCoreTime, time) * 1000 < THERMAL_CORE_PERIOD)
+        return;
+
+    struct ThermalCore_s core;
+    ThermalMap_FindCore(&thermalMap, &core);
+    thermalCoreTime = time;
+
+    chMtxLock(&GpsProcessorMutex);
+    GpsProcessingOutputData.thermalCore = core;
+    chMtxUnlock(&GpsProcessorMutex);
+}
+
+static void handlePositionUpdate(void)
+{
+    struct GpsFix_s fix;
+    struct SignalProcessingOutputData_s measurement;
+
+    readGpsData(&fix);
+    if (!isFixUsable(&fix))
+        return;
+
+    readMeasurementData(&measurement);
+    if (measurement.filteredPressure <= 0)
+        return;
+
+    updateQnhEstimate(&qnhEstimator, &fix, measurement.filteredPressure);
+    publishQnh(&qnhEstimator, measurement.baroAltitude);
+
+    ThermalMap_Update(&thermalMap, fix.latitude, fix.longitude, measurement.vario);
+    updateThermalCore(fix.time);
+}
+
+static void publishWind(const struct WindEstimator_s *estimator, uint32_t time)
+{
+    uint32_t age = (time >= estimator->windTime) ?
+            time - estimator->windTime :
+            time + MS_PER_DAY - estimator->windTime;
+
+    chMtxLock(&GpsProcessorMutex);
+    GpsProcessingOutputData.windSpeed = WindEstimator_GetSpeed(estimator);
+    GpsProcessingOutputData.windDirection = WindEstimator_GetDirection(estimator);
+    GpsProcessingOutputData.windValid = estimator->valid && (age < WIND_MAX_AGE);
+    chMtxUnlock(&GpsProcessorMutex);
+}
+
+static void handleVelocityUpdate(void)
+{
+    struct GpsFix_s fix;
+
+    readGpsData(&fix);
+    if (!fix.velocityValid)
+        return;
+
+    WindEstimator_Update(&windEstimator, fix.time, fix.groundSpeed, fix.track);
+    publishWind(&windEstimator, fix.time);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+THD_FUNCTION(GpsProcessorThread, arg)
+{
+    (void)arg;
+
+    chRegSetThreadName("GpsProcessorThread");
+
+    WindEstimator_Init(&windEstimator);
+    ThermalMap_Init(&thermalMap);
+
+    event_listener_t gpsListener;
+    chEvtRegisterMaskWithFlags(
+            &gpsEvent,
+            &gpsListener,
+            EVENT_MASK(0),
+            GPS_POSITION_UPDATED |
+            GPS_VELOCITY_UPDATED);
+
+    while (1) {
+        chEvtWaitAny(ALL_EVENTS);
+        eventflags_t flags = chEvtGetAndClearFlags(&gpsListener);
+
+        if (flags & GPS_POSITION_UPDATED)
+            handlePositionUpdate();
+
+        if (flags & GPS_VELOCITY_UPDATED)
+            handleVelocityUpdate();
+    }
+}
+
+/******************************* END OF FILE ***********************************/
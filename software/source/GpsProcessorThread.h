@@ -0,0 +1,57 @@
+/**
+ * @file GpsProcessorThread.h
+ * @brief Thread to combine GPS fixes with barometric data.
+ * @author Molnar Zoltan
+ */
+
+#ifndef GPSPROCESSORTHREAD_H
+#define GPSPROCESSORTHREAD_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "ThermalMap.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Results of the GPS processing.
+ * @brief QNH altitude is calculated from the standard atmosphere altitude
+ *        as baroAltitude * altitudeScale + altitudeOffset.
+ */
+struct GpsProcessingOutputData_s {
+    float qnh;
+    float altitudeScale;
+    float altitudeOffset;
+    float fusedAltitude;
+    bool qnhValid;
+    float windSpeed;
+    float windDirection;
+    bool windValid;
+    struct ThermalCore_s thermalCore;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+extern mutex_t GpsProcessorMutex;
+extern struct GpsProcessingOutputData_s GpsProcessingOutputData;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+THD_FUNCTION(GpsProcessorThread, arg);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,384 @@
+/**
+ * @file LatencyBench.c
+ * @brief Step response latency benchmark of the vario to audio path.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "LatencyBench.h"
+
+#if LATENCY_BENCH
+#include "chprintf.h"
+#include "hal.h"
+
+#include <math.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/* Still air before a stimulus, long enough for the beeper to go quiet. */
+#define LATENCY_BENCH_SETTLE_TIME                                        10000000
+/* Duration of a stimulus, a stage not reached by then is missed. */
+#define LATENCY_BENCH_STIMULUS_TIME                                      10000000
+/* Climb of the ramp stimulus, m/s. */
+#define LATENCY_BENCH_CLIMB                                                (2.0f)
+/* Altitude jump of the step stimulus, m. */
+#define LATENCY_BENCH_STEP                                                 (3.0f)
+
+/* Summary sentences of a batch, the configuration and one per stage plus the whole path. */
+#define LATENCY_SUMMARY_LINES                               (LATENCY_STAGE_COUNT + 2)
+#define LATENCY_TOTAL                                             LATENCY_STAGE_COUNT
+
+#if defined(VARIO_SIM)
+/* The simulator clock counts us of host time. */
+#define LATENCY_CLOCK_TICKS_PER_US                                              1
+#else
+/* DWT cycle counter, wraps after a minute, longer than any stimulus. */
+#define LATENCY_CLOCK_TICKS_PER_US                          (STM32_HCLK / 1000000)
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    STIMULUS_RAMP,
+    STIMULUS_STEP,
+    STIMULUS_COUNT
+} LatencyStimulus_t;
+
+/**
+ * Timestamps of the running stimulus, written from the marks.
+ */
+struct LatencyCycle_s {
+    uint32_t start;                         /**< Clock of the first stimulus sample. */
+    uint32_t mark[LATENCY_STAGE_COUNT];
+    uint32_t reached;                       /**< Bit mask of the marked stages. */
+    bool armed;
+};
+
+/**
+ * Latencies of a stage and of the whole path over a batch in us.
+ */
+struct LatencyBatch_s {
+    uint32_t latency[LATENCY_STAGE_COUNT + 1][LATENCY_BENCH_BATCH];
+    size_t count[LATENCY_STAGE_COUNT + 1];
+    size_t stimuli;
+};
+
+struct LatencyResult_s {
+    LatencyStimulus_t stimulus;
+    uint32_t cycle;
+    uint32_t latency[LATENCY_STAGE_COUNT];
+    uint32_t reached;
+};
+
+struct LatencySummary_s {
+    LatencyStimulus_t stimulus;
+    uint32_t samplePeriod;                  /**< Mean over the batch, us. */
+    size_t count[LATENCY_STAGE_COUNT + 1];
+    uint32_t min[LATENCY_STAGE_COUNT + 1];
+    uint32_t median[LATENCY_STAGE_COUNT + 1];
+    uint32_t p90[LATENCY_STAGE_COUNT + 1];
+    uint32_t max[LATENCY_STAGE_COUNT + 1];
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char stimulusNames[STIMULUS_COUNT] = {'R', 'S'};
+static const char stageNames[LATENCY_STAGE_COUNT + 1] = {'V', 'S', 'T', 'A'};
+
+static struct SignalChainConfig_s chainConfig;
+static float liftThreshold = BEEP_DEFAULT_LIFT_THRESHOLD;
+static uint32_t updatePolicy;
+
+/* Stimulus generator, only used by the pressure reader. */
+static uint32_t lastClock;
+static uint32_t elapsed;
+static bool stimulusActive;
+static uint32_t cycleCount;
+static float altitudeOffset;
+static uint32_t periodSum;
+static uint32_t periodCount;
+static struct LatencyBatch_s batches[STIMULUS_COUNT];
+
+/* Shared with the marks and the report, under the system lock. */
+static struct LatencyCycle_s cycle;
+static struct LatencyResult_s result;
+static bool resultPending;
+static struct LatencySummary_s summary;
+static size_t summaryPending;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t readClock(void) {
+#if defined(VARIO_SIM)
+    return SimHal_Microseconds();
+#else
+    return chSysGetRealtimeCounterX();
+#endif
+}
+
+/**
+ * Pressure of the altitude offset above a measured pressure, ISA.
+ */
+static uint32_t offsetPressure(uint32_t pressure, float offset) {
+    float ratio = powf(pressure / 101325.0f, 0.1902f) - offset / 44330.0f;
+    return (uint32_t)(101325.0f * powf(ratio, 1 / 0.1902f) + 0.5f);
+}
+
+static void sortLatencies(uint32_t *latency, size_t count) {
+    size_t i;
+    for (i = 1; i < count; i++) {
+        uint32_t value = latency[i];
+        size_t j = i;
+        for (; (0 < j) && (value < latency[j - 1]); j--)
+            latency[j] = latency[j - 1];
+        latency[j] = value;
+    }
+}
+
+/**
+ * Close a full batch into the distribution summary, replacing an unsent one.
+ */
+static void summarizeBatch(LatencyStimulus_t stimulus) {
+    struct LatencyBatch_s *batch = &batches[stimulus];
+    struct LatencySummary_s next;
+    size_t stage;
+
+    next.stimulus = stimulus;
+    next.samplePeriod = periodCount ? periodSum / periodCount : 0;
+
+    for (stage = 0; stage <= LATENCY_TOTAL; stage++) {
+        size_t count = batch->count[stage];
+        uint32_t *latency = batch->latency[stage];
+
+        sortLatencies(latency, count);
+        next.count[stage] = count;
+        next.min[stage] = count ? latency[0] : 0;
+        next.median[stage] = count ? latency[count / 2] : 0;
+        next.p90[stage] = count ? latency[(count * 9) / 10] : 0;
+        next.max[stage] = count ? latency[count - 1] : 0;
+        batch->count[stage] = 0;
+    }
+    batch->stimuli = 0;
+    periodSum = 0;
+    periodCount = 0;
+
+    chSysLock();
+    summary = next;
+    summaryPending = LATENCY_SUMMARY_LINES;
+    chSysUnlock();
+}
+
+static void startStimulus(uint32_t now) {
+    stimulusActive = true;
+    elapsed = 0;
+    if (STIMULUS_STEP == cycleCount % STIMULUS_COUNT)
+        altitudeOffset += LATENCY_BENCH_STEP;
+
+    chSysLock();
+    cycle.start = now;
+    cycle.reached = 0;
+    cycle.armed = true;
+    chSysUnlock();
+}
+
+/**
+ * Convert the marks of the finished stimulus to stage latencies.
+ */
+static void finishStimulus(void) {
+    LatencyStimulus_t stimulus = (LatencyStimulus_t)(cycleCount % STIMULUS_COUNT);
+    struct LatencyBatch_s *batch = &batches[stimulus];
+    struct LatencyResult_s next;
+    uint32_t previous;
+    size_t stage;
+
+    chSysLock();
+    struct LatencyCycle_s finished = cycle;
+    cycle.armed = false;
+    chSysUnlock();
+
+    next.stimulus = stimulus;
+    next.cycle = cycleCount;
+    next.reached = 0;
+
+    /* A stage only counts if the one before it was reached as well. */
+    previous = finished.start;
+    for (stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        if (!(finished.reached & (1U << stage)))
+            break;
+        next.latency[stage] = (finished.mark[stage] - previous) / LATENCY_CLOCK_TICKS_PER_US;
+        next.reached |= (1U << stage);
+        batch->latency[stage][batch->count[stage]++] = next.latency[stage];
+        previous = finished.mark[stage];
+    }
+    if (LATENCY_STAGE_COUNT == stage)
+        batch->latency[LATENCY_TOTAL][batch->count[LATENCY_TOTAL]++] =
+                (previous - finished.start) / LATENCY_CLOCK_TICKS_PER_US;
+
+    stimulusActive = false;
+    elapsed = 0;
+    altitudeOffset = 0;
+    cycleCount++;
+
+    chSysLock();
+    result = next;
+    resultPending = true;
+    chSysUnlock();
+
+    if (LATENCY_BENCH_BATCH == ++batch->stimuli)
+        summarizeBatch(stimulus);
+}
+
+/**
+ * Terminate a sentence with its checksum.
+ */
+static void appendChecksum(char *buffer, size_t size) {
+    uint8_t crc = 0;
+    size_t length;
+
+    for (length = 1; ('\0' != buffer[length]) && (length < size); length++)
+        crc ^= (uint8_t)buffer[length];
+
+    chsnprintf(buffer + length, size - length, "*%02X", crc);
+}
+
+static void formatResult(char *buffer, size_t size, const struct LatencyResult_s *data) {
+    size_t length = (size_t)chsnprintf(buffer, size, "$PVLAT,%c,%u",
+            stimulusNames[data->stimulus], (unsigned)data->cycle);
+    size_t stage;
+
+    for (stage = 0; (stage < LATENCY_STAGE_COUNT) && (length < size); stage++) {
+        if (data->reached & (1U << stage))
+            length += (size_t)chsnprintf(buffer + length, size - length, ",%u", (unsigned)data->latency[stage]);
+        else
+            length += (size_t)chsnprintf(buffer + length, size - length, ",");
+    }
+}
+
+static void formatSummary(char *buffer, size_t size, const struct LatencySummary_s *data, size_t line) {
+    if (0 == line) {
+        chsnprintf(buffer, size, "$PVLAC,%u,%d,%d,%u,%d,%u,%c",
+                (unsigned)data->samplePeriod,
+                (int)(chainConfig.alpha * 10000 + 0.5f),
+                (int)(chainConfig.beta * 1000000 + 0.5f),
+                (unsigned)chainConfig.bufferLength,
+                (int)(liftThreshold * 100 + ((0 < liftThreshold) ? 0.5f : -0.5f)),
+                (unsigned)updatePolicy,
+                BEEP_HW_GATE ? 'H' : (BEEP_SYNTH ? 'S' : 'G'));
+        return;
+    }
+
+    size_t stage = line - 1;
+    chsnprintf(buffer, size, "$PVLAS,%c,%c,%u,%u,%u,%u,%u",
+            stimulusNames[data->stimulus],
+            stageNames[stage],
+            (unsigned)data->count[stage],
+            (unsigned)data->min[stage],
+            (unsigned)data->median[stage],
+            (unsigned)data->p90[stage],
+            (unsigned)data->max[stage]);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void LatencyBench_Inject(struct PressureData_s *data) {
+    uint32_t now = readClock();
+    uint32_t interval = 0;
+
+    if (0 != lastClock) {
+        interval = (now - lastClock) / LATENCY_CLOCK_TICKS_PER_US;
+        elapsed += interval;
+        periodSum += interval;
+        periodCount++;
+    }
+    lastClock = now;
+
+    if (!stimulusActive) {
+        if (LATENCY_BENCH_SETTLE_TIME <= elapsed)
+            startStimulus(now);
+    } else {
+        if (STIMULUS_RAMP == cycleCount % STIMULUS_COUNT)
+            altitudeOffset += LATENCY_BENCH_CLIMB * interval / 1000000.0f;
+        if (LATENCY_BENCH_STIMULUS_TIME <= elapsed)
+            finishStimulus();
+    }
+
+    data->pressure = offsetPressure(data->pressure, altitudeOffset);
+}
+
+void LatencyBench_MarkVario(float vario) {
+    if (liftThreshold < vario)
+        LatencyBench_Mark(LATENCY_STAGE_VARIO);
+}
+
+void LatencyBench_Mark(LatencyStage_t stage) {
+    chSysLock();
+    LatencyBench_MarkI(stage);
+    chSysUnlock();
+}
+
+void LatencyBench_MarkI(LatencyStage_t stage) {
+    if (cycle.armed && !(cycle.reached & (1U << stage))) {
+        cycle.mark[stage] = readClock();
+        cycle.reached |= (1U << stage);
+    }
+}
+
+void LatencyBench_SetChainConfig(const struct SignalChainConfig_s *config) {
+    chainConfig = *config;
+}
+
+void LatencyBench_SetBeeperConfig(float threshold, uint32_t policy) {
+    liftThreshold = threshold;
+    updatePolicy = policy;
+}
+
+bool LatencyBench_FormatReport(char *buffer, size_t size) {
+    struct LatencyResult_s pendingResult;
+    struct LatencySummary_s pendingSummary;
+    bool hasResult;
+    bool hasSummary = false;
+    size_t line = 0;
+
+    /* The result of a stimulus goes first, it completes the batch. */
+    chSysLock();
+    hasResult = resultPending;
+    pendingResult = result;
+    resultPending = false;
+    if (!hasResult && (0 != summaryPending)) {
+        hasSummary = true;
+        line = LATENCY_SUMMARY_LINES - summaryPending--;
+        pendingSummary = summary;
+    }
+    chSysUnlock();
+
+    if (hasResult)
+        formatResult(buffer, size, &pendingResult);
+    else if (hasSummary)
+        formatSummary(buffer, size, &pendingSummary, line);
+    else
+        return false;
+
+    appendChecksum(buffer, size);
+#if defined(VARIO_SIM)
+    SimHal_Log("latency %s", buffer);
+#endif
+    return true;
+}
+#endif
+
+/******************************* END OF FILE ***********************************/
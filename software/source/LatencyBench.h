@@ -0,0 +1,110 @@
+/**
+ * @file LatencyBench.h
+ * @brief Step response latency benchmark of the vario to audio path.
+ * @author Molnar Zoltan
+ *
+ * Built with LATENCY_BENCH (USE_LATENCY_BENCH=yes), the pressure reader
+ * adds synthetic climbs to the measured pressure and the path is
+ * timestamped at three points: the first CALCULATION_FINISHED with a vario
+ * above the lift threshold, the switch to BEEP_LIFTING and the first
+ * enabled tone. Results are sent as proprietary sentences with the NMEA
+ * output:
+ *   $PVLAT,<stimulus>,<cycle>,<vario us>,<state us>,<tone us>*CS
+ *       one stimulus, a stage not reached in time is left empty,
+ *   $PVLAS,<stimulus>,<stage>,<count>,<min>,<median>,<p90>,<max>*CS
+ *       distribution of a stage over the last LATENCY_BENCH_BATCH stimuli
+ *       in us, stage V, S and T as above and A for the whole path,
+ *   $PVLAC,<sample period us>,<alpha 1e-4>,<beta 1e-6>,<length>,
+ *          <lift cm/s>,<update policy>,<cadence>*CS
+ *       the configuration the distributions belong to, cadence G for the
+ *       GPT one-shot, H for the hardware gate and S for the synthesizer.
+ * Stimulus R is a climb ramp, S an altitude step. The altitude returns to
+ * the measured one when a stimulus finishes, the settle time absorbs the
+ * jump back. Each stage is measured from the previous one, V from the
+ * first sample carrying the stimulus.
+ */
+
+#ifndef LATENCYBENCH_H
+#define LATENCYBENCH_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "PressureReaderThread.h"
+#include "SignalChain.h"
+#include "ch.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if !defined(LATENCY_BENCH)
+#define LATENCY_BENCH                                                       FALSE
+#endif
+
+/** Stimuli per distribution. */
+#define LATENCY_BENCH_BATCH                                                    16
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    LATENCY_STAGE_VARIO,        /**< Vario above the lift threshold. */
+    LATENCY_STAGE_STATE,        /**< Beeper state machine switched to lifting. */
+    LATENCY_STAGE_TONE,         /**< Tone output enabled. */
+    LATENCY_STAGE_COUNT
+} LatencyStage_t;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Add the stimulus of the running cycle to a measured sample.
+ * @brief Called by the pressure reader for every sample before it is sent
+ *        on. The stimulus is an altitude offset, so the sensor noise stays
+ *        in the signal.
+ */
+void LatencyBench_Inject(struct PressureData_s *data);
+
+/**
+ * Record the first vario above the lift threshold after the stimulus.
+ */
+void LatencyBench_MarkVario(float vario);
+
+/**
+ * Record a stage reached, only the first one after the stimulus counts.
+ */
+void LatencyBench_Mark(LatencyStage_t stage);
+
+/**
+ * I-class variant of LatencyBench_Mark().
+ */
+void LatencyBench_MarkI(LatencyStage_t stage);
+
+/**
+ * Configuration of the signal chain, for the $PVLAC report.
+ */
+void LatencyBench_SetChainConfig(const struct SignalChainConfig_s *config);
+
+/**
+ * Configuration of the beeper, the lift threshold is also the one of the
+ * vario stage.
+ */
+void LatencyBench_SetBeeperConfig(float liftThreshold, uint32_t updatePolicy);
+
+/**
+ * Format the next pending report sentence.
+ * @return false if nothing is pending.
+ */
+bool LatencyBench_FormatReport(char *buffer, size_t size);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -7,22 +7,31 @@
 /*******************************************************************************/
 /* INCLUDES                                                                    */
 /*******************************************************************************/
+#include "CycleProbe.h"
+#include "GpsProcessorThread.h"
+#include "LatencyBench.h"
 #include "NmeaGeneratorThread.h"
 #include "SignalProcessorThread.h"
 #include "SerialHandlerThread.h"
-#include "chprintf.h"
-#include "string.h"
+#include "ThreadStats.h"
+#include "TraceRing.h"
+#include "VarioKernels.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+/**
+ * Time in ms after which a message not yet sent is counted as late, the
+ * serial handler may be busy configuring the GPS receiver.
+ */
+#define MESSAGE_SENT_TIMEOUT                                                 1000
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
 struct NmeaData_s {
-    float baroAltitude;
-    float vario;
+    struct Lxwp0Data_s lxwp0;
+    struct ThermalCore_s thermalCore;
 };
 
 /*******************************************************************************/
@@ -34,11 +43,16 @@ struct NmeaData_s {
 /*******************************************************************************/
 SEMAPHORE_DECL(nmeaMessageSent, 0);
 char nmea[150];
+uint32_t nmeaLateMessages;
 
 EVENTSOURCE_DECL(nmeaMessageReady);
 
 static struct NmeaData_s nmeaData;
 
+/* Last valid QNH correction, the standard atmosphere until the first one. */
+static float altitudeScale = 1;
+static float altitudeOffset = 0;
+
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
@@ -46,35 +60,57 @@ static struct NmeaData_s nmeaData;
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
-static uint32_t calculateCrc(const char *pdata, size_t length)
-{
-    uint32_t crc = 0;
-    size_t i;
-    for (i = 0; i < length; i++)
-        crc ^= pdata[i];
-
-    return crc;
-}
-
 static void readMeasurementData(void) {
-    chMtxLock(&SignalProcessorMutex);
-    nmeaData.baroAltitude = SignalProcessingOutputData.baroAltitude;
-    nmeaData.vario = SignalProcessingOutputData.vario;
+    TRACE_RING_MUTEX_LOCK(&SignalProcessorMutex);
+    nmeaData.lxwp0.baroAltitude = SignalProcessingOutputData.baroAltitude;
+    nmeaData.lxwp0.vario = SignalProcessingOutputData.vario;
     chMtxUnlock(&SignalProcessorMutex);
+
+    /* Apply the QNH estimated from GPS altitude, the last valid one while the estimate is uncertain. */
+    chMtxLock(&GpsProcessorMutex);
+    if (GpsProcessingOutputData.qnhValid) {
+        altitudeScale = GpsProcessingOutputData.altitudeScale;
+        altitudeOffset = GpsProcessingOutputData.altitudeOffset;
+    }
+    nmeaData.lxwp0.baroAltitude = nmeaData.lxwp0.baroAltitude * altitudeScale + altitudeOffset;
+    nmeaData.lxwp0.windSpeed = GpsProcessingOutputData.windSpeed;
+    nmeaData.lxwp0.windDirection = GpsProcessingOutputData.windDirection;
+    nmeaData.lxwp0.windValid = GpsProcessingOutputData.windValid;
+    nmeaData.thermalCore = GpsProcessingOutputData.thermalCore;
+    chMtxUnlock(&GpsProcessorMutex);
 }
 
 static void createNmeaMessage(void) {
-    memset(nmea, 0, sizeof(nmea));
-    chsnprintf(nmea, sizeof(nmea), "$LXWP0,N,,%.2f,%.2f,,,,,,,,",
-            nmeaData.baroAltitude, nmeaData.vario);
-    uint32_t crc = calculateCrc(nmea+1, strlen(nmea)-1);
-    chsnprintf(nmea + strlen(nmea), sizeof(nmea) - strlen(nmea), "*%02X", crc);
+    CYCLE_PROBE_BEGIN(PROBE_NMEA_MESSAGE);
+    VarioKernels_FormatLxwp0(nmea, sizeof(nmea), &nmeaData.lxwp0);
+    CYCLE_PROBE_END(PROBE_NMEA_MESSAGE);
+}
 
-    nmea[strlen(nmea)] = '\0';
+/**
+ * Create proprietary thermal core message:
+ * $PVTHC,<bearing deg>,<distance m>,<climb m/s>*CS
+ */
+static void createThermalCoreMessage(void) {
+    VarioKernels_FormatThermalCore(
+            nmea,
+            sizeof(nmea),
+            nmeaData.thermalCore.bearing,
+            nmeaData.thermalCore.distance,
+            nmeaData.thermalCore.climb);
 }
 
+/**
+ * Hand the message to the serial handler and wait until it is sent. The
+ * buffer belongs to the serial handler until then, a late message is
+ * counted and still waited for.
+ */
 static void sendMessage(void) {
+    TRACE_RING_RECORD(TRACE_NMEA_READY, 0, 0);
     chEvtBroadcast(&nmeaMessageReady);
+    if (MSG_TIMEOUT == chSemWaitTimeout(&nmeaMessageSent, MS2ST(MESSAGE_SENT_TIMEOUT))) {
+        nmeaLateMessages++;
+        chSemWait(&nmeaMessageSent);
+    }
 }
 
 /*******************************************************************************/
@@ -91,7 +127,22 @@ THD_FUNCTION(NmeaGeneratorThread, arg)
         readMeasurementData();
         createNmeaMessage();
         sendMessage();
-        chSemWait(&nmeaMessageSent);
+
+        if (nmeaData.thermalCore.valid) {
+            createThermalCoreMessage();
+            sendMessage();
+        }
+
+#if LATENCY_BENCH
+        while (LatencyBench_FormatReport(nmea, sizeof(nmea))) {
+            sendMessage();
+        }
+#endif
+#if THREAD_STATS
+        while (ThreadStats_FormatReport(nmea, sizeof(nmea))) {
+            sendMessage();
+        }
+#endif
     }
 }
 
@@ -28,6 +28,8 @@
 /* DECLARATION OF GLOBAL VARIABLES                                             */
 /*******************************************************************************/
 extern char nmea[];
+/** Messages the serial handler sent later than MESSAGE_SENT_TIMEOUT. */
+extern uint32_t nmeaLateMessages;
 extern semaphore_t nmeaMessageSent;
 extern event_source_t nmeaMessageReady;
 
@@ -0,0 +1,343 @@
+/**
+ * @file NmeaParser.c
+ * @brief Incremental parser of the GPS sentences used by the vario.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "NmeaParser.h"
+
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define KNOTS_TO_MPS                                                  (0.514444f)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Field positions in the GGA sentence.
+ */
+typedef enum {
+    GGA_TIME       = 1,
+    GGA_LATITUDE   = 2,
+    GGA_NS         = 3,
+    GGA_LONGITUDE  = 4,
+    GGA_EW         = 5,
+    GGA_QUALITY    = 6,
+    GGA_SATELLITES = 7,
+    GGA_HDOP       = 8,
+    GGA_ALTITUDE   = 9
+} GgaField_t;
+
+/**
+ * Field positions in the RMC sentence.
+ */
+typedef enum {
+    RMC_TIME       = 1,
+    RMC_STATUS     = 2,
+    RMC_LATITUDE   = 3,
+    RMC_NS         = 4,
+    RMC_LONGITUDE  = 5,
+    RMC_EW         = 6,
+    RMC_SPEED      = 7,
+    RMC_TRACK      = 8
+} RmcField_t;
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Convert decimal number to fixed point.
+ * @param[in] s Zero terminated field.
+ * @param[in] decimals Number of fraction digits kept, the rest is truncated.
+ * @param[out] value Field value multiplied by 10^decimals.
+ * @return false if the field is empty or malformed.
+ */
+static bool parseFixedPoint(const char *s, int decimals, int32_t *value)
+{
+    bool negative = false;
+    bool fraction = false;
+    bool digits = false;
+    int32_t v = 0;
+
+    if ('-' == *s) {
+        negative = true;
+        s++;
+    }
+
+    for (; '\0' != *s; s++) {
+        if ('.' == *s) {
+            if (fraction)
+                return false;
+            fraction = true;
+        } else if (('0' <= *s) && (*s <= '9')) {
+            if (fraction) {
+                if (0 == decimals)
+                    continue;
+                decimals--;
+            }
+            v = v * 10 + (*s - '0');
+            digits = true;
+        } else {
+            return false;
+        }
+    }
+
+    for (; 0 < decimals; decimals--)
+        v *= 10;
+
+    *value = negative ? -v : v;
+    return digits;
+}
+
+static bool parseFloat(const char *s, int decimals, float scale, float *value)
+{
+    int32_t v;
+    if (!parseFixedPoint(s, decimals, &v))
+        return false;
+
+    *value = v * scale;
+    return true;
+}
+
+/**
+ * Convert hhmmss.sss time to ms of day.
+ */
+static bool parseTime(const char *s, uint32_t *time)
+{
+    int32_t v;
+    if (!parseFixedPoint(s, 3, &v) || (v < 0))
+        return false;
+
+    uint32_t hhmmss = v / 1000;
+    *time = (hhmmss / 10000) * 3600000UL +
+            ((hhmmss / 100) % 100) * 60000UL +
+            (hhmmss % 100) * 1000UL +
+            v % 1000;
+    return true;
+}
+
+/**
+ * Convert (d)ddmm.mmmmm coordinate to 1e-7 degrees.
+ * @brief Coordinate is cleared if the field is empty, so the hemisphere
+ *        field does not flip a stale value.
+ */
+static bool parseCoordinate(const char *s, int32_t *coordinate)
+{
+    int32_t v;
+    if (!parseFixedPoint(s, 5, &v) || (v < 0)) {
+        *coordinate = 0;
+        return false;
+    }
+
+    int32_t degrees = v / 10000000L;
+    int32_t minutes = v % 10000000L;
+    *coordinate = degrees * 10000000L + (minutes * 5 + 1) / 3;
+    return true;
+}
+
+static void parseGgaField(struct NmeaParser_s *parser)
+{
+    struct GpsFix_s *fix = &parser->pending;
+    const char *s = parser->field;
+    int32_t v;
+
+    switch (parser->fieldIndex) {
+    case GGA_TIME:
+        parseTime(s, &fix->time);
+        break;
+    case GGA_LATITUDE:
+        parseCoordinate(s, &fix->latitude);
+        break;
+    case GGA_NS:
+        if ('S' == s[0])
+            fix->latitude = -fix->latitude;
+        break;
+    case GGA_LONGITUDE:
+        parseCoordinate(s, &fix->longitude);
+        break;
+    case GGA_EW:
+        if ('W' == s[0])
+            fix->longitude = -fix->longitude;
+        break;
+    case GGA_QUALITY:
+        fix->quality = parseFixedPoint(s, 0, &v) ? (uint8_t)v : 0;
+        break;
+    case GGA_SATELLITES:
+        fix->satellites = parseFixedPoint(s, 0, &v) ? (uint8_t)v : 0;
+        break;
+    case GGA_HDOP:
+        if (!parseFloat(s, 2, 0.01f, &fix->hdop))
+            fix->hdop = 99.99f;
+        break;
+    case GGA_ALTITUDE:
+        if (!parseFloat(s, 2, 0.01f, &fix->altitude))
+            fix->quality = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void parseRmcField(struct NmeaParser_s *parser)
+{
+    struct GpsFix_s *fix = &parser->pending;
+    const char *s = parser->field;
+
+    switch (parser->fieldIndex) {
+    case RMC_TIME:
+        parseTime(s, &fix->time);
+        break;
+    case RMC_STATUS:
+        fix->velocityValid = ('A' == s[0]);
+        break;
+    case RMC_LATITUDE:
+        parseCoordinate(s, &fix->latitude);
+        break;
+    case RMC_NS:
+        if ('S' == s[0])
+            fix->latitude = -fix->latitude;
+        break;
+    case RMC_LONGITUDE:
+        parseCoordinate(s, &fix->longitude);
+        break;
+    case RMC_EW:
+        if ('W' == s[0])
+            fix->longitude = -fix->longitude;
+        break;
+    case RMC_SPEED:
+        if (parseFloat(s, 2, 0.01f * KNOTS_TO_MPS, &fix->groundSpeed))
+            break;
+        fix->velocityValid = false;
+        break;
+    case RMC_TRACK:
+        /* Track is empty when standing still. */
+        if (!parseFloat(s, 2, 0.01f, &fix->track))
+            fix->track = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void parseField(struct NmeaParser_s *parser)
+{
+    parser->field[parser->fieldLength] = '\0';
+
+    if (0 == parser->fieldIndex) {
+        /* Skip talker identifier, GP, GN and GL are all accepted. */
+        if (5 != parser->fieldLength)
+            parser->sentence = NMEA_SENTENCE_OTHER;
+        else if (0 == strcmp(parser->field + 2, "GGA"))
+            parser->sentence = NMEA_SENTENCE_GGA;
+        else if (0 == strcmp(parser->field + 2, "RMC"))
+            parser->sentence = NMEA_SENTENCE_RMC;
+        else
+            parser->sentence = NMEA_SENTENCE_OTHER;
+    } else if (NMEA_SENTENCE_GGA == parser->sentence) {
+        parseGgaField(parser);
+    } else if (NMEA_SENTENCE_RMC == parser->sentence) {
+        parseRmcField(parser);
+    }
+
+    parser->fieldIndex++;
+    parser->fieldLength = 0;
+}
+
+static int hexValue(char c)
+{
+    if (('0' <= c) && (c <= '9'))
+        return c - '0';
+    if (('A' <= c) && (c <= 'F'))
+        return c - 'A' + 10;
+    if (('a' <= c) && (c <= 'f'))
+        return c - 'a' + 10;
+    return -1;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void NmeaParser_Init(struct NmeaParser_s *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = NMEA_PARSER_IDLE;
+    parser->sentence = NMEA_SENTENCE_NONE;
+}
+
+NmeaSentence_t NmeaParser_Feed(struct NmeaParser_s *parser, char c)
+{
+    if ('$' == c) {
+        parser->state = NMEA_PARSER_FIELD;
+        parser->sentence = NMEA_SENTENCE_OTHER;
+        parser->fieldIndex = 0;
+        parser->fieldLength = 0;
+        parser->checksum = 0;
+        parser->pending = parser->fix;
+        return NMEA_SENTENCE_NONE;
+    }
+
+    switch (parser->state) {
+    case NMEA_PARSER_FIELD:
+        if ('*' == c) {
+            parseField(parser);
+            parser->receivedChecksum = 0;
+            parser->fieldLength = 0;
+            parser->state = NMEA_PARSER_CHECKSUM;
+            break;
+        }
+
+        parser->checksum ^= (uint8_t)c;
+        if (',' == c) {
+            parseField(parser);
+        } else if (parser->fieldLength < NMEA_PARSER_FIELD_LENGTH - 1) {
+            parser->field[parser->fieldLength++] = c;
+        } else {
+            /* Field too long for any sentence we parse. */
+            parser->state = NMEA_PARSER_IDLE;
+        }
+        break;
+    case NMEA_PARSER_CHECKSUM: {
+        int v = hexValue(c);
+        if (v < 0) {
+            parser->state = NMEA_PARSER_IDLE;
+            break;
+        }
+
+        parser->receivedChecksum = (parser->receivedChecksum << 4) | v;
+        if (2 > ++parser->fieldLength)
+            break;
+
+        parser->state = NMEA_PARSER_IDLE;
+        if (parser->receivedChecksum != parser->checksum)
+            break;
+
+        if (NMEA_SENTENCE_OTHER != parser->sentence)
+            parser->fix = parser->pending;
+        return parser->sentence;
+    }
+    default:
+        break;
+    }
+
+    return NMEA_SENTENCE_NONE;
+}
+
+/******************************* END OF FILE ***********************************/
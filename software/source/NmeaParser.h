@@ -0,0 +1,93 @@
+/**
+ * @file NmeaParser.h
+ * @brief Incremental parser of the GPS sentences used by the vario.
+ * @author Molnar Zoltan
+ */
+
+#ifndef NMEAPARSER_H
+#define NMEAPARSER_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define NMEA_PARSER_FIELD_LENGTH                                               16
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    NMEA_SENTENCE_NONE,
+    NMEA_SENTENCE_GGA,
+    NMEA_SENTENCE_RMC,
+    NMEA_SENTENCE_OTHER
+} NmeaSentence_t;
+
+typedef enum {
+    NMEA_PARSER_IDLE,
+    NMEA_PARSER_FIELD,
+    NMEA_PARSER_CHECKSUM
+} NmeaParserState_t;
+
+/**
+ * GPS fix merged from the GGA and RMC sentences.
+ */
+struct GpsFix_s {
+    uint32_t time;          /**< UTC time of day in ms. */
+    int32_t latitude;       /**< Latitude in 1e-7 degrees, north positive. */
+    int32_t longitude;      /**< Longitude in 1e-7 degrees, east positive. */
+    float altitude;         /**< Altitude above mean sea level in m. */
+    float hdop;             /**< Horizontal dilution of precision. */
+    float groundSpeed;      /**< Speed over ground in m/s. */
+    float track;            /**< True track over ground in degrees. */
+    uint8_t quality;        /**< GGA fix quality, 0 if no position fix. */
+    uint8_t satellites;     /**< Number of satellites used in the fix. */
+    bool velocityValid;     /**< RMC status is active. */
+};
+
+struct NmeaParser_s {
+    NmeaParserState_t state;
+    NmeaSentence_t sentence;
+    char field[NMEA_PARSER_FIELD_LENGTH];
+    size_t fieldLength;
+    size_t fieldIndex;
+    uint8_t checksum;
+    uint8_t receivedChecksum;
+    struct GpsFix_s pending;    /**< Fix updated by the sentence in progress. */
+    struct GpsFix_s fix;        /**< Fix of the last valid sentence. */
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Reset parser state and clear the stored fix.
+ */
+void NmeaParser_Init(struct NmeaParser_s *parser);
+
+/**
+ * Process one received character.
+ * @brief Fields are converted as they arrive, so no sentence buffer is
+ *        needed. The fix is updated only if the checksum is correct.
+ * @return Type of the sentence completed by this character, or
+ *         NMEA_SENTENCE_NONE.
+ */
+NmeaSentence_t NmeaParser_Feed(struct NmeaParser_s *parser, char c);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
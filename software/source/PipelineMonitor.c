@@ -0,0 +1,174 @@
+/**
+ * @file PipelineMonitor.c
+ * @brief Progress deadlines of the measurement pipeline, gate of the
+ *        watchdog.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "PipelineMonitor.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char * const stageNames[PIPELINE_STAGE_COUNT] = {
+    "produced",
+    "processed",
+    "beeper",
+    "sentence"
+};
+
+static const uint16_t stageDeadlines[PIPELINE_STAGE_COUNT] = {
+    PIPELINE_SAMPLE_DEADLINE,
+    PIPELINE_SAMPLE_DEADLINE,
+    PIPELINE_BEEPER_DEADLINE,
+    PIPELINE_SENTENCE_DEADLINE
+};
+
+/* Stages whose stall resets the vario. */
+static const bool stageGatesWatchdog[PIPELINE_STAGE_COUNT] = {
+    true,
+    true,
+    true,
+    false
+};
+
+struct PipelineStage_s pipelineStages[PIPELINE_STAGE_COUNT];
+bool pipelineWatchdogReset;
+
+/* The 16 bit system time extended by the checks, under the system lock. */
+static systime_t uptimeBase;
+static uint32_t uptimeTicks;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t ticksToMs(uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * 1000) / CH_CFG_ST_FREQUENCY);
+}
+
+/**
+ * Extend the 16 bit system time, called at least once per wrap by the checks.
+ */
+static uint32_t extendTimeI(void) {
+    systime_t now = chVTGetSystemTimeX();
+
+    uptimeTicks += (systime_t)(now - uptimeBase);
+    uptimeBase = now;
+
+    return uptimeTicks;
+}
+
+/**
+ * Record a miss once per stall, until the stage makes progress again.
+ */
+static void recordMiss(struct PipelineStage_s *stage, PipelineStage_t index, uint32_t elapsed, uint32_t uptime) {
+    if (stage->late)
+        return;
+
+    stage->late = true;
+    stage->misses++;
+    stage->lastMissTime = uptime;
+#if defined(VARIO_SIM)
+    SimHal_Log("deadline %s %u", stageNames[index], (unsigned)elapsed);
+#else
+    (void)index;
+    (void)elapsed;
+#endif
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void PipelineMonitor_Init(void) {
+    systime_t now = chVTGetSystemTime();
+    size_t i;
+
+#if !defined(VARIO_SIM)
+    pipelineWatchdogReset = (0 != (RCC->CSR & RCC_CSR_IWDGRSTF));
+    RCC->CSR |= RCC_CSR_RMVF;
+#endif
+
+    chSysLock();
+    uptimeBase = now;
+    uptimeTicks = now;
+    for (i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        pipelineStages[i].deadline = stageDeadlines[i];
+        pipelineStages[i].lastProgress = now;
+    }
+    chSysUnlock();
+}
+
+void PipelineMonitor_Progress(PipelineStage_t stage) {
+    chSysLock();
+    pipelineStages[stage].lastProgress = extendTimeI();
+    pipelineStages[stage].progress++;
+    chSysUnlock();
+}
+
+bool PipelineMonitor_Check(void) {
+    bool onTime = true;
+    size_t i;
+
+    uint32_t uptime = PipelineMonitor_Uptime();
+
+    for (i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        struct PipelineStage_s *stage = &pipelineStages[i];
+
+        chSysLock();
+        uint32_t elapsedTicks = extendTimeI() - stage->lastProgress;
+        uint32_t progress = stage->progress;
+        chSysUnlock();
+
+        uint32_t elapsed = ticksToMs(elapsedTicks);
+        uint32_t deadline = stage->deadline + ((0 == progress) ? PIPELINE_STARTUP_GRACE : 0);
+
+        if ((0 != progress) && (stage->maxGap < elapsed))
+            stage->maxGap = elapsed;
+
+        if (elapsed <= deadline) {
+            stage->late = false;
+        } else {
+            recordMiss(stage, (PipelineStage_t)i, elapsed, uptime);
+            if (stageGatesWatchdog[i])
+                onTime = false;
+        }
+    }
+
+    return onTime;
+}
+
+uint32_t PipelineMonitor_Uptime(void) {
+    uint32_t ticks;
+
+    chSysLock();
+    ticks = extendTimeI();
+    chSysUnlock();
+
+    return ticksToMs(ticks);
+}
+
+const char *PipelineMonitor_Name(PipelineStage_t stage) {
+    return (stage < PIPELINE_STAGE_COUNT) ? stageNames[stage] : "";
+}
+
+/******************************* END OF FILE ***********************************/
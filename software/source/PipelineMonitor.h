@@ -0,0 +1,107 @@
+/**
+ * @file PipelineMonitor.h
+ * @brief Progress deadlines of the measurement pipeline, gate of the
+ *        watchdog.
+ * @author Molnar Zoltan
+ *
+ * Every stage of the pipeline reports its progress, the main thread feeds
+ * the IWDG only while each stage of the audio vario made progress within
+ * its deadline. A stalled SPI transfer or a blocked chMsgSend stops the
+ * stages behind it and resets the vario instead of freezing it. The NMEA
+ * output is telemetry, its misses are recorded but never reset the beeper.
+ * A miss is counted and time stamped once per stall, the first stage that
+ * missed points to the cause.
+ * The records are read from pipelineStages with the debugger or the shell,
+ * the reset cause tells whether the previous run ended with a stall.
+ */
+
+#ifndef PIPELINEMONITOR_H
+#define PIPELINEMONITOR_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+/** Deadlines in ms, well above the period of the stages. */
+#if !defined(PIPELINE_SAMPLE_DEADLINE)
+#define PIPELINE_SAMPLE_DEADLINE                                              250
+#endif
+#if !defined(PIPELINE_BEEPER_DEADLINE)
+#define PIPELINE_BEEPER_DEADLINE                                              500
+#endif
+#if !defined(PIPELINE_SENTENCE_DEADLINE)
+#define PIPELINE_SENTENCE_DEADLINE                                           3000
+#endif
+
+/**
+ * Added to the deadlines until the first progress of a stage, covers the
+ * sensor startup and the filling of the regression buffer.
+ */
+#define PIPELINE_STARTUP_GRACE                                               5000
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    PIPELINE_SAMPLE_PRODUCED,   /**< Pressure sample measured or simulated. */
+    PIPELINE_SAMPLE_PROCESSED,  /**< Sample taken by the signal chain. */
+    PIPELINE_BEEPER_UPDATED,    /**< Beeper read the latest vario. */
+    PIPELINE_SENTENCE_SENT,     /**< NMEA sentence handled by the serial handler, does not gate the watchdog. */
+    PIPELINE_STAGE_COUNT
+} PipelineStage_t;
+
+struct PipelineStage_s {
+    uint32_t progress;          /**< Progress counter. */
+    uint32_t lastProgress;      /**< Extended system time, ticks. */
+    uint16_t deadline;          /**< ms. */
+    uint32_t maxGap;            /**< Longest time between two progresses seen by the checks, ms. */
+    bool late;                  /**< Deadline missed and no progress since. */
+    uint32_t misses;
+    uint32_t lastMissTime;      /**< Uptime at the last miss, ms. */
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+extern struct PipelineStage_s pipelineStages[PIPELINE_STAGE_COUNT];
+
+/** The previous run ended with a watchdog reset. */
+extern bool pipelineWatchdogReset;
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Start the deadlines, called when the watchdog is started.
+ */
+void PipelineMonitor_Init(void);
+
+/**
+ * Report the progress of a stage.
+ */
+void PipelineMonitor_Progress(PipelineStage_t stage);
+
+/**
+ * Check the deadlines and record the new misses.
+ * @return true if every stage gating the watchdog is on time.
+ */
+bool PipelineMonitor_Check(void);
+
+/**
+ * Uptime in ms, extended from the system time by the checks.
+ */
+uint32_t PipelineMonitor_Uptime(void);
+
+const char *PipelineMonitor_Name(PipelineStage_t stage);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
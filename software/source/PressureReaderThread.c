@@ -8,6 +8,10 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "PressureReaderThread.h"
+#include "CycleProbe.h"
+#include "TraceRing.h"
+#include "LatencyBench.h"
+#include "PipelineMonitor.h"
 #include "ms5611.h"
 
 /*******************************************************************************/
@@ -49,8 +53,16 @@ THD_FUNCTION(PressureReaderThread, arg)
 
     while (1) {
         struct PressureData_s data = {0};
+        CYCLE_PROBE_BEGIN(PROBE_MS5611_MEASURE);
         MS5611_Measure(&data.pressure, &data.temperature);
+        CYCLE_PROBE_END(PROBE_MS5611_MEASURE);
+        CYCLE_PROBE_SAMPLE();
         data.timestamp = chVTGetSystemTime();
+#if LATENCY_BENCH
+        LatencyBench_Inject(&data);
+#endif
+        TRACE_RING_RECORD(TRACE_SAMPLE_SEND, 0, (uint16_t)data.pressure);
+        PipelineMonitor_Progress(PIPELINE_SAMPLE_PRODUCED);
         chMsgSend(pSignalProcessorThread, (msg_t)&data);
     }
 }
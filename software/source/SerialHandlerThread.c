@@ -8,13 +8,24 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "NmeaGeneratorThread.h"
+#include "PipelineMonitor.h"
 #include "SerialHandlerThread.h"
+#include "TraceRing.h"
+#include "gps.h"
 #include "hal.h"
 #include "chprintf.h"
 
+#include <string.h>
+
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+#define NMEA_HEADER_LENGTH                                                      6
+/* Header of a grouped sentence up to the part number, $GPGSV,3,1, */
+#define NMEA_GROUP_HEADER_LENGTH                                               16
+#define NMEA_GROUP_HEADER_FIELDS                                                3
+#define NMEA_TYPE_OFFSET                                                        3
+#define PENDING_MESSAGE_TIMEOUT                                               100
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -23,14 +34,258 @@
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+typedef enum {
+    FILTER_IDLE,
+    FILTER_HEADER,
+    FILTER_BODY
+} NmeaFilterState_t;
+
+struct NmeaFilter_s {
+    NmeaFilterState_t state;
+    char header[NMEA_GROUP_HEADER_LENGTH];
+    size_t headerLength;
+    size_t ruleIndex;
+    bool forward;
+};
 
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
 /*******************************************************************************/
+/**
+ * GPS sentences forwarded to the Kobo. XCSoar takes position, altitude and
+ * fix quality from GGA and speed and track from RMC, the satellite sentences
+ * are only used for the status pages.
+ */
+static const struct NmeaFilterRule_s nmeaFilterRules[] = {
+    {"GGA", NMEA_FORWARD, false},
+    {"RMC", NMEA_FORWARD, false},
+    {"GSA", 5,            false},
+    {"GSV", 10,           true},
+    {"GLL", NMEA_DROP,    false},
+    {"VTG", NMEA_DROP,    false},
+    {"",    NMEA_FORWARD, false}
+};
+
+const size_t nmeaFilterRuleCount = sizeof(nmeaFilterRules)/sizeof(nmeaFilterRules[0]);
+struct NmeaFilterStatistics_s nmeaFilterStatistics[sizeof(nmeaFilterRules)/sizeof(nmeaFilterRules[0])];
+
+MUTEX_DECL(GpsDataMutex);
+EVENTSOURCE_DECL(gpsEvent);
+
+struct GpsFix_s GpsData;
+
+/* Kobo link handover, see SerialHandler_AcquireKobo(). */
+static SEMAPHORE_DECL(koboGranted, 0);
+static volatile bool koboRequested;
+static volatile bool koboMuted;
+
+static uint8_t decimationCounters[sizeof(nmeaFilterRules)/sizeof(nmeaFilterRules[0])];
+static bool groupForwarded[sizeof(nmeaFilterRules)/sizeof(nmeaFilterRules[0])];
+static struct NmeaFilter_s gpsFilter;
+static struct NmeaParser_s gpsParser;
 
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
+static size_t findFilterRule(const char *header)
+{
+    size_t i;
+    for (i = 0; i < nmeaFilterRuleCount - 1; i++) {
+        if (0 == strncmp(header + NMEA_TYPE_OFFSET, nmeaFilterRules[i].type, 3))
+            break;
+    }
+
+    return i;
+}
+
+/**
+ * Part number of a grouped sentence, 1 if it is not grouped or the field
+ * can not be read.
+ */
+static uint8_t readPartNumber(const struct NmeaFilter_s *filter)
+{
+    size_t i;
+    size_t fields = 0;
+    uint8_t part = 0;
+
+    if (!nmeaFilterRules[filter->ruleIndex].grouped)
+        return 1;
+
+    for (i = NMEA_HEADER_LENGTH; i < filter->headerLength; i++) {
+        char c = filter->header[i];
+        if (',' == c)
+            fields++;
+        else if ((NMEA_GROUP_HEADER_FIELDS - 1 == fields) && ('0' <= c) && (c <= '9'))
+            part = (uint8_t)(part * 10 + (c - '0'));
+    }
+
+    return ((NMEA_GROUP_HEADER_FIELDS == fields) && (0 != part)) ? part : 1;
+}
+
+/**
+ * The header is complete at the type, a grouped sentence is held back until
+ * its part number is read.
+ */
+static bool isHeaderComplete(const struct NmeaFilter_s *filter)
+{
+    size_t i;
+    size_t fields = 0;
+
+    if (filter->headerLength < NMEA_HEADER_LENGTH)
+        return false;
+    if (!nmeaFilterRules[filter->ruleIndex].grouped || (NMEA_GROUP_HEADER_LENGTH == filter->headerLength))
+        return true;
+
+    for (i = NMEA_HEADER_LENGTH; i < filter->headerLength; i++) {
+        if (',' == filter->header[i])
+            fields++;
+    }
+
+    return NMEA_GROUP_HEADER_FIELDS == fields;
+}
+
+/**
+ * Decimate a sentence type, the later parts of a group follow the decision
+ * taken on its first part.
+ */
+static bool isSentenceForwarded(size_t ruleIndex, uint8_t part)
+{
+    uint8_t decimation = nmeaFilterRules[ruleIndex].decimation;
+    if (NMEA_DROP == decimation)
+        return false;
+
+    if (1 < part)
+        return groupForwarded[ruleIndex];
+
+    bool forward = (decimation <= ++decimationCounters[ruleIndex]);
+    if (forward)
+        decimationCounters[ruleIndex] = 0;
+    groupForwarded[ruleIndex] = forward;
+
+    return forward;
+}
+
+static void startSentence(struct NmeaFilter_s *filter)
+{
+    size_t ruleIndex = filter->ruleIndex;
+    struct NmeaFilterStatistics_s *stat = &nmeaFilterStatistics[ruleIndex];
+
+    filter->forward = isSentenceForwarded(ruleIndex, readPartNumber(filter)) && !koboMuted;
+    filter->state = FILTER_BODY;
+
+    stat->receivedSentences++;
+    stat->receivedBytes += filter->headerLength;
+    if (filter->forward) {
+        stat->forwardedSentences++;
+        stat->forwardedBytes += filter->headerLength;
+        sdWrite(&SD1, (const uint8_t *)filter->header, filter->headerLength);
+    }
+}
+
+/**
+ * Give up the sentence in progress. A truncated header is accounted as an
+ * unknown sentence, a forwarded body is terminated so the next message on
+ * the Kobo link starts on a new line.
+ */
+static void abortGpsSentence(struct NmeaFilter_s *filter)
+{
+    if (FILTER_HEADER == filter->state) {
+        struct NmeaFilterStatistics_s *stat = &nmeaFilterStatistics[nmeaFilterRuleCount - 1];
+        stat->receivedSentences++;
+        stat->receivedBytes += filter->headerLength;
+    } else if ((FILTER_BODY == filter->state) && filter->forward) {
+        chprintf((BaseSequentialStream*)&SD1, "\r\n");
+    }
+    filter->state = FILTER_IDLE;
+}
+
+static void filterGpsCharacter(struct NmeaFilter_s *filter, char c)
+{
+    if (('$' == c) && (FILTER_IDLE != filter->state))
+        abortGpsSentence(filter);
+
+    switch (filter->state) {
+    case FILTER_IDLE:
+        if ('$' == c) {
+            filter->header[0] = c;
+            filter->headerLength = 1;
+            filter->state = FILTER_HEADER;
+        }
+        break;
+    case FILTER_HEADER:
+        filter->header[filter->headerLength++] = c;
+        if (NMEA_HEADER_LENGTH == filter->headerLength)
+            filter->ruleIndex = findFilterRule(filter->header);
+        if (isHeaderComplete(filter))
+            startSentence(filter);
+        else if ('\n' == c)
+            abortGpsSentence(filter);
+        break;
+    case FILTER_BODY: {
+        struct NmeaFilterStatistics_s *stat = &nmeaFilterStatistics[filter->ruleIndex];
+        stat->receivedBytes++;
+        if (filter->forward) {
+            stat->forwardedBytes++;
+            sdPut(&SD1, (uint8_t)c);
+        }
+        if ('\n' == c)
+            filter->state = FILTER_IDLE;
+        break;
+    }
+    default:
+        filter->state = FILTER_IDLE;
+        break;
+    }
+}
+
+static void publishGpsData(NmeaSentence_t sentence)
+{
+    chMtxLock(&GpsDataMutex);
+    GpsData = gpsParser.fix;
+    chMtxUnlock(&GpsDataMutex);
+
+    if (NMEA_SENTENCE_GGA == sentence)
+        chEvtBroadcastFlags(&gpsEvent, GPS_POSITION_UPDATED);
+    else if (NMEA_SENTENCE_RMC == sentence)
+        chEvtBroadcastFlags(&gpsEvent, GPS_VELOCITY_UPDATED);
+}
+
+static void processGpsCharacter(char c)
+{
+    filterGpsCharacter(&gpsFilter, c);
+
+    NmeaSentence_t sentence = NmeaParser_Feed(&gpsParser, c);
+    if ((NMEA_SENTENCE_GGA == sentence) || (NMEA_SENTENCE_RMC == sentence))
+        publishGpsData(sentence);
+}
+
+static bool isGpsSentenceInProgress(const struct NmeaFilter_s *filter)
+{
+    return (FILTER_BODY == filter->state) && filter->forward;
+}
+
+#if TRACE_RING
+/**
+ * A trace frame written to an empty queue blocks for a few characters at
+ * most, the GPS input is read again before it overflows.
+ */
+static bool isKoboOutputEmpty(void)
+{
+    chSysLock();
+    bool empty = oqIsEmptyI(&SD1.oqueue);
+    chSysUnlock();
+
+    return empty;
+}
+#endif
+
+static void sendNmeaMessage(void)
+{
+    if (!koboMuted)
+        chprintf((BaseSequentialStream*)&SD1, "%s\n\r", nmea);
+    PipelineMonitor_Progress(PIPELINE_SENTENCE_SENT);
+    chSemSignal(&nmeaMessageSent);
+}
 
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL FUNCTIONS                                              */
@@ -39,47 +294,93 @@ THD_FUNCTION(SerialHandlerThread, arg)
 {
     (void)arg;
 
+    size_t i;
+    for (i = 0; i < nmeaFilterRuleCount; i++)
+        nmeaFilterStatistics[i].type = nmeaFilterRules[i].type;
+
+    NmeaParser_Init(&gpsParser);
+
     /* Start serial interface to Kobo.*/
     static SerialConfig koboConfig = {9600,0,0,0};
     sdStart(&SD1, &koboConfig);
 
-    /* Start serial interface to GPS module.*/
-    static SerialConfig gpsConfig  = {9600,0,0,0};
-    sdStart(&SD2, &gpsConfig);
-
     event_listener_t gpsListener;
     eventflags_t flags;
 
     chEvtRegisterMaskWithFlags(
-            (event_source_t *)chnGetEventSource(&SD2),
+            (event_source_t *)chnGetEventSource(GPS_SERIAL),
             &gpsListener,
             EVENT_MASK(0),
             CHN_INPUT_AVAILABLE);
 
+    /* Listen before the GPS configuration, it blocks for seconds when the
+     * receiver does not answer, a message broadcast meanwhile stays pending.*/
     event_listener_t nmeaListener;
     chEvtRegisterMask(&nmeaMessageReady, &nmeaListener, EVENT_MASK(1));
 
+    /* Start serial interface to GPS module and configure the receiver.*/
+    GPS_Start();
+
+    bool nmeaMessagePending = false;
+
     while (1) {
-        eventmask_t evt = chEvtWaitAny(ALL_EVENTS);
+        eventmask_t evt = chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(PENDING_MESSAGE_TIMEOUT));
 
         if (evt & EVENT_MASK(0)) {
             flags = chEvtGetAndClearFlags(&gpsListener);
             if (flags & CHN_INPUT_AVAILABLE) {
+                uint16_t count = 0;
                 msg_t c;
                 do {
-                    c = chnGetTimeout(&SD2, TIME_IMMEDIATE);
-                    if ( c != STM_TIMEOUT )
-                        chprintf((BaseSequentialStream*)&SD1, "%c", (char)c);
+                    c = chnGetTimeout(GPS_SERIAL, TIME_IMMEDIATE);
+                    if ( c != STM_TIMEOUT ) {
+                        processGpsCharacter((char)c);
+                        count++;
+                    }
                 }
                 while (c != STM_TIMEOUT);
+                TRACE_RING_RECORD(TRACE_SERIAL_INPUT, 0, count);
+                (void)count;
+            }
+        }
+        if (evt & EVENT_MASK(1))
+            nmeaMessagePending = true;
+
+        /* Do not break a forwarded GPS sentence with our own message.*/
+        if (nmeaMessagePending) {
+            if ((0 == evt) && isGpsSentenceInProgress(&gpsFilter))
+                abortGpsSentence(&gpsFilter);
+
+            if (!isGpsSentenceInProgress(&gpsFilter)) {
+                sendNmeaMessage();
+                nmeaMessagePending = false;
             }
         }
-        if (evt & EVENT_MASK(1)) {
-            chprintf((BaseSequentialStream*)&SD1, "%s\n\r", nmea);
-            chSemSignal(&nmeaMessageSent);
+
+        /* Hand the link over between two sentences.*/
+        if (koboRequested && !koboMuted && !isGpsSentenceInProgress(&gpsFilter)) {
+            koboMuted = true;
+            chSemSignal(&koboGranted);
         }
+
+#if TRACE_RING
+        if (!koboMuted && !nmeaMessagePending && !isGpsSentenceInProgress(&gpsFilter) &&
+            TraceRing_IsDumpDue() && isKoboOutputEmpty())
+            TraceRing_DumpFrame((BaseSequentialStream*)&SD1);
+#endif
     }
 }
 
-/******************************* END OF FILE ***********************************/
+void SerialHandler_AcquireKobo(void)
+{
+    koboRequested = true;
+    chSemWait(&koboGranted);
+}
+
+void SerialHandler_ReleaseKobo(void)
+{
+    koboRequested = false;
+    koboMuted = false;
+}
 
+/******************************* END OF FILE ***********************************/
@@ -11,10 +11,13 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "ch.h"
+#include "NmeaParser.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+#define NMEA_DROP                                                               0
+#define NMEA_FORWARD                                                            1
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -27,16 +30,62 @@ typedef enum {
     LK8EX1_READY_TO_SEND = (1 << 0)
 } SerialEvent_t;
 
+typedef enum {
+    GPS_POSITION_UPDATED = (1 << 0),
+    GPS_VELOCITY_UPDATED = (1 << 1)
+} GpsEventFlags_t;
+
+/**
+ * Forwarding rule of a GPS sentence type.
+ * @brief decimation is NMEA_DROP, NMEA_FORWARD or N to forward every Nth
+ *        sentence. An empty type matches every sentence not listed before.
+ *        A grouped sentence carries the total and part number fields, it is
+ *        decimated per group so a forwarded group stays complete.
+ */
+struct NmeaFilterRule_s {
+    char type[4];
+    uint8_t decimation;
+    bool grouped;
+};
+
+/**
+ * Traffic counters of a GPS sentence type.
+ */
+struct NmeaFilterStatistics_s {
+    const char *type;
+    uint32_t receivedSentences;
+    uint32_t receivedBytes;
+    uint32_t forwardedSentences;
+    uint32_t forwardedBytes;
+};
+
 /*******************************************************************************/
 /* DECLARATION OF GLOBAL VARIABLES                                             */
 /*******************************************************************************/
 extern event_source_t serialEvent;
+extern mutex_t GpsDataMutex;
+extern struct GpsFix_s GpsData;
+extern event_source_t gpsEvent;
+extern struct NmeaFilterStatistics_s nmeaFilterStatistics[];
+extern const size_t nmeaFilterRuleCount;
 
 /*******************************************************************************/
 /* DECLARATION OF GLOBAL FUNCTIONS                                             */
 /*******************************************************************************/
 THD_FUNCTION(SerialHandlerThread, arg);
 
+/**
+ * Take the Kobo link over from the NMEA output.
+ * @brief Returns between two sentences, GPS and NMEA sentences are dropped
+ *        until SerialHandler_ReleaseKobo().
+ */
+void SerialHandler_AcquireKobo(void);
+
+/**
+ * Give the Kobo link back to the NMEA output.
+ */
+void SerialHandler_ReleaseKobo(void);
+
 #endif
 
 /******************************* END OF FILE ***********************************/
@@ -0,0 +1,194 @@
+/**
+ * @file SignalChain.c
+ * @brief RTOS independent vario signal chain, from pressure samples to the
+ *        beeper decision.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "SignalChain.h"
+#include "CycleProbe.h"
+#include "VarioKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Update the onset detector with the latest fast and regression vario.
+ * @brief The sums only grow while the fast vario leads the regression vario
+ *        by more than ONSET_DRIFT, so noise around a steady climb does not
+ *        accumulate. The onset lasts until the regression vario catches up.
+ * @return The onset detected by this update, otherwise ONSET_NONE.
+ */
+static ClimbOnset_t detectOnset(struct OnsetDetector_s *detector, float fastVario, float vario) {
+    detector->earlyVario += ONSET_SMOOTHING * (fastVario - detector->earlyVario);
+    float lead = detector->earlyVario - vario;
+
+    if (ONSET_NONE != detector->onset) {
+        if (fabsf(lead) < ONSET_DRIFT) {
+            detector->onset = ONSET_NONE;
+            detector->liftSum = 0;
+            detector->sinkSum = 0;
+        }
+        return ONSET_NONE;
+    }
+
+    detector->liftSum = fmaxf(0, detector->liftSum + lead - ONSET_DRIFT);
+    detector->sinkSum = fmaxf(0, detector->sinkSum - lead - ONSET_DRIFT);
+
+    if (ONSET_THRESHOLD < detector->liftSum) {
+        detector->onset = ONSET_LIFT;
+        return ONSET_LIFT;
+    }
+    if (ONSET_THRESHOLD < detector->sinkSum) {
+        detector->onset = ONSET_SINK;
+        return ONSET_SINK;
+    }
+
+    return ONSET_NONE;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void SignalChain_Init(struct SignalChain_s *chain, const struct SignalChainConfig_s *config) {
+    memset(chain, 0, sizeof(*chain));
+    chain->config = *config;
+    if (SIGNAL_CHAIN_MAX_BUFFER_LENGTH < chain->config.bufferLength)
+        chain->config.bufferLength = SIGNAL_CHAIN_MAX_BUFFER_LENGTH;
+}
+
+bool SignalChain_Process(
+        struct SignalChain_s *chain,
+        uint32_t pressure,
+        uint32_t timestamp,
+        struct SignalChainOutput_s *output) {
+    size_t bufferLength = chain->config.bufferLength;
+
+    if (0 == chain->sampleCount) {
+        chain->pressure = pressure;
+        chain->pressureRate = 0;
+        chain->lastTimestamp = timestamp;
+        chain->sampleCount++;
+        return false;
+    }
+
+    /* The time base is only advanced once the buffer is full. */
+    uint32_t samplingTime = timestamp - chain->lastTimestamp;
+
+    CYCLE_PROBE_BEGIN(PROBE_ALPHA_BETA);
+    float filteredPressure = VarioKernels_AlphaBetaFilter(
+            chain->config.alpha,
+            chain->config.beta,
+            &chain->pressure,
+            &chain->pressureRate,
+            pressure,
+            samplingTime);
+    CYCLE_PROBE_END(PROBE_ALPHA_BETA);
+
+    CYCLE_PROBE_BEGIN(PROBE_ALTITUDE);
+    float altitude = VarioKernels_PressureToAltitude(filteredPressure);
+    CYCLE_PROBE_END(PROBE_ALTITUDE);
+
+    chain->altitudeBuffer[chain->sampleIndex++ % bufferLength] = altitude;
+
+    if (chain->sampleCount < bufferLength) {
+        chain->sampleCount++;
+        return false;
+    }
+
+    CYCLE_PROBE_BEGIN(PROBE_SLOPE);
+    float vario = VarioKernels_Slope(
+            chain->altitudeBuffer,
+            bufferLength,
+            chain->sampleIndex % bufferLength,
+            chain->sampleCount,
+            samplingTime / 1000.0);
+    CYCLE_PROBE_END(PROBE_SLOPE);
+
+    chain->lastTimestamp = timestamp;
+
+    float fastVario = VarioKernels_PressureRateToVario(filteredPressure, chain->pressureRate);
+
+    output->newOnset = detectOnset(&chain->onsetDetector, fastVario, vario);
+    output->vario = vario;
+    output->baroAltitude = altitude;
+    output->filteredPressure = filteredPressure;
+    output->earlyVario = chain->onsetDetector.earlyVario;
+    output->onset = chain->onsetDetector.onset;
+
+    return true;
+}
+
+float SignalChain_SelectVario(const struct SignalChainOutput_s *output) {
+    if ((ONSET_LIFT == output->onset) && (output->vario < output->earlyVario))
+        return output->earlyVario;
+    if ((ONSET_SINK == output->onset) && (output->earlyVario < output->vario))
+        return output->earlyVario;
+    return output->vario;
+}
+
+BeepControlState_t SignalChain_UpdateBeepState(
+        const struct BeepThresholds_s *thresholds,
+        BeepControlState_t state,
+        float vario) {
+    switch(state) {
+    case BEEP_LIFTING:
+        if (vario < thresholds->liftOff)
+            state = BEEP_DISABLED;
+        break;
+    case BEEP_SINKING:
+        if (thresholds->sinkOff < vario)
+            state = BEEP_DISABLED;
+        break;
+    case BEEP_DISABLED:
+        if (thresholds->lift < vario)
+            state = BEEP_LIFTING;
+        if (vario < thresholds->sink)
+            state = BEEP_SINKING;
+        break;
+    default:
+        break;
+    }
+
+    return state;
+}
+
+int32_t SignalChain_ToneStep(float vario) {
+    int32_t step = (int32_t)(vario * TONE_STEPS_PER_MPS +
+            ((0 < vario) ? 0.5f : -0.5f));
+
+    if (TONE_MAX_STEP < step)
+        step = TONE_MAX_STEP;
+    if (step < -TONE_MAX_STEP)
+        step = -TONE_MAX_STEP;
+
+    return step;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,156 @@
+/**
+ * @file SignalChain.h
+ * @brief RTOS independent vario signal chain, from pressure samples to the
+ *        beeper decision.
+ * @author Molnar Zoltan
+ */
+
+#ifndef SIGNALCHAIN_H
+#define SIGNALCHAIN_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define SIGNAL_CHAIN_DEFAULT_ALPHA                                          (0.2f)
+#define SIGNAL_CHAIN_DEFAULT_BETA                                         (0.004f)
+#define SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH                                    100
+
+/** Size of the altitude buffer, host tools may raise it to tune longer windows. */
+#if !defined(SIGNAL_CHAIN_MAX_BUFFER_LENGTH)
+#define SIGNAL_CHAIN_MAX_BUFFER_LENGTH         SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH
+#endif
+
+#define BEEP_DEFAULT_LIFT_THRESHOLD                                         (0.4f)
+#define BEEP_DEFAULT_LIFT_OFF_THRESHOLD                                     (0.0f)
+#define BEEP_DEFAULT_SINK_THRESHOLD                                        (-1.2f)
+#define BEEP_DEFAULT_SINK_OFF_THRESHOLD                                    (-1.0f)
+
+/**
+ * Onset detector, smoothing of the early vario and drift and threshold of
+ * the CUSUM of its lead in m/s. Shared with the lane kernel of the tuner.
+ */
+#define ONSET_SMOOTHING                                                     (0.2f)
+#define ONSET_DRIFT                                                         (0.3f)
+#define ONSET_THRESHOLD                                                     (1.5f)
+
+/** Tone steps are quantized to 0.1 m/s up to +-6 m/s. */
+#define TONE_STEPS_PER_MPS                                                     10
+#define TONE_MAX_VARIO                                                          6
+#define TONE_MAX_STEP                         (TONE_MAX_VARIO * TONE_STEPS_PER_MPS)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    ONSET_NONE,
+    ONSET_LIFT,
+    ONSET_SINK
+} ClimbOnset_t;
+
+typedef enum {
+    BEEP_LIFTING,
+    BEEP_SINKING,
+    BEEP_DISABLED
+} BeepControlState_t;
+
+struct SignalChainConfig_s {
+    float alpha;
+    float beta;
+    size_t bufferLength;        /**< Samples in the regression, at most SIGNAL_CHAIN_MAX_BUFFER_LENGTH. */
+};
+
+/**
+ * Two sided CUSUM on the difference of the fast and the regression vario.
+ */
+struct OnsetDetector_s {
+    float earlyVario;
+    float liftSum;
+    float sinkSum;
+    ClimbOnset_t onset;
+};
+
+struct SignalChain_s {
+    struct SignalChainConfig_s config;
+    float pressure;             /**< Alpha-beta filtered pressure. */
+    float pressureRate;         /**< Pa/ms. */
+    uint32_t lastTimestamp;
+    float altitudeBuffer[SIGNAL_CHAIN_MAX_BUFFER_LENGTH];
+    size_t sampleCount;
+    size_t sampleIndex;
+    struct OnsetDetector_s onsetDetector;
+};
+
+struct SignalChainOutput_s {
+    float vario;
+    float baroAltitude;
+    float filteredPressure;
+    float earlyVario;           /**< Fast, noisier vario from the alpha-beta filter. */
+    ClimbOnset_t onset;         /**< Set while vario lags behind a detected change. */
+    ClimbOnset_t newOnset;      /**< Onset detected by this sample, otherwise ONSET_NONE. */
+};
+
+struct BeepThresholds_s {
+    float lift;
+    float liftOff;
+    float sink;
+    float sinkOff;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Reset the chain, the next sample starts a new filter run.
+ */
+void SignalChain_Init(struct SignalChain_s *chain, const struct SignalChainConfig_s *config);
+
+/**
+ * Process one pressure sample.
+ * @param[in] pressure Compensated pressure in Pa.
+ * @param[in] timestamp Sample time in ms, may wrap.
+ * @return true if the output is valid, which takes a full altitude buffer.
+ */
+bool SignalChain_Process(
+        struct SignalChain_s *chain,
+        uint32_t pressure,
+        uint32_t timestamp,
+        struct SignalChainOutput_s *output);
+
+/**
+ * Select the vario the beeper follows, during a detected climb onset the
+ * fast vario leads until the regression vario catches up with it.
+ */
+float SignalChain_SelectVario(const struct SignalChainOutput_s *output);
+
+/**
+ * Step the beeper state machine, thresholds have hysteresis.
+ */
+BeepControlState_t SignalChain_UpdateBeepState(
+        const struct BeepThresholds_s *thresholds,
+        BeepControlState_t state,
+        float vario);
+
+/**
+ * Quantize vario to the nearest tone step.
+ * @return -TONE_MAX_STEP .. TONE_MAX_STEP.
+ */
+int32_t SignalChain_ToneStep(float vario);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
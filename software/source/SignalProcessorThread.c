@@ -7,20 +7,21 @@
 /*******************************************************************************/
 /* INCLUDES                                                                    */
 /*******************************************************************************/
+#include "ConfigStore.h"
+#include "LatencyBench.h"
+#include "PipelineMonitor.h"
 #include "PressureReaderThread.h"
+#include "SignalChain.h"
 #include "SignalProcessorThread.h"
+#include "TraceRing.h"
 #include "chprintf.h"
 #include "hal.h"
 
-#include <math.h>
 #include <stdint.h>
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
-#define ALPHA                                                               (0.2)
-#define BETA                                                              (0.004)
-#define BUFLENGTH                                                             100
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
@@ -38,6 +39,14 @@ EVENTSOURCE_DECL(signalProcessorEvent);
 
 struct SignalProcessingOutputData_s SignalProcessingOutputData;
 
+static struct SignalChainConfig_s signalChainConfig = {
+    SIGNAL_CHAIN_DEFAULT_ALPHA,
+    SIGNAL_CHAIN_DEFAULT_BETA,
+    SIGNAL_CHAIN_DEFAULT_BUFFER_LENGTH
+};
+
+static struct SignalChain_s signalChain;
+
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
 /*******************************************************************************/
@@ -50,77 +59,37 @@ static void waitForMeasurementData(struct PressureData_s *pdata) {
     msg_t msg = chMsgGet(psender);
     *pdata = *(struct PressureData_s *)msg;
     chMsgRelease(psender, 0);
+    TRACE_RING_RECORD(TRACE_SAMPLE_RECEIVE, 0, (uint16_t)pdata->pressure);
 }
 
-static systime_t calculateElapsedTimeInMs(systime_t t1, systime_t t2) {
-    systime_t dt = t2 - t1;
-    if (t2 < t1)
-        dt += (systime_t)(-1);
-
-    return ST2MS(dt);
-}
-
-static float convertPressureToAltitude(float pressure) {
-    return 44330 * (1 - pow ((pressure / 101325.0), 0.1902));
-}
-
-static float ab_filter(
-        float alpha,
-        float beta,
-        float *xk_1,
-        float *vk_1,
-        int32_t x_raw,
-        float samplingTime) {
-    float xk = *xk_1 + (*vk_1 * samplingTime);
-    float vk = *vk_1;
-
-    float rk = x_raw - xk;
-
-    xk += alpha * rk;
-    vk += beta * rk / samplingTime;
-
-    *xk_1 = xk;
-    *vk_1 = vk;
-
-    return xk;
+/**
+ * Apply the stored filter parameters, values out of range are ignored.
+ */
+static void loadSettings(void) {
+    int32_t value;
+
+    if (ConfigStore_Get(CONFIG_KEY_FILTER_ALPHA, &value) && (0 < value) && (value <= 10000))
+        signalChainConfig.alpha = value / 10000.0f;
+    if (ConfigStore_Get(CONFIG_KEY_FILTER_BETA, &value) && (0 <= value) && (value < 1000000))
+        signalChainConfig.beta = value / 1000000.0f;
+    if (ConfigStore_Get(CONFIG_KEY_REGRESSION_LENGTH, &value) &&
+        (2 <= value) && (value <= SIGNAL_CHAIN_MAX_BUFFER_LENGTH))
+        signalChainConfig.bufferLength = (size_t)value;
 }
 
-static float calculateSlope(
-        float *buffer,
-        size_t bufferLength,
-        size_t startIndex,
-        size_t sampleCount,
-        float dt) {
-    float x_avg = 0;
-    float y_avg = 0;
-    size_t i;
-    for (i = 0; i < sampleCount; i++) {
-        size_t j;
-        if (startIndex + i < bufferLength)
-            j = startIndex + i;
-        else
-            j = i - bufferLength + startIndex;
-
-        x_avg += i * dt;
-        y_avg += buffer[j];
-    }
+/**
+ * Extend the 16 bit system time to the 32 bit ms time base of the chain.
+ * @brief Ticks are accumulated before the conversion, so no rounding error
+ *        builds up and the wrap of systime_t is handled by the subtraction.
+ */
+static uint32_t getTimestampMs(systime_t timestamp) {
+    static systime_t lastTicks = 0;
+    static uint32_t ticks = 0;
 
-    x_avg /= sampleCount;
-    y_avg /= sampleCount;
-
-    float num = 0;
-    float den = 0;
-    for (i = 0; i < sampleCount; i++) {
-        size_t j;
-        if (startIndex + i < bufferLength)
-            j = startIndex + i;
-        else
-            j = i - bufferLength + startIndex;
-        num += (i*dt - x_avg) * (buffer[j] - y_avg);
-        den += (i*dt - x_avg) * (i*dt - x_avg);
-    }
+    ticks += (systime_t)(timestamp - lastTicks);
+    lastTicks = timestamp;
 
-    return num/den;
+    return (uint32_t)(((uint64_t)ticks * 1000) / CH_CFG_ST_FREQUENCY);
 }
 
 /*******************************************************************************/
@@ -131,63 +100,43 @@ THD_FUNCTION(SignalProcessorThread, arg)
     (void)arg;
 
     chEvtObjectInit(&signalProcessorEvent);
+    loadSettings();
+    SignalChain_Init(&signalChain, &signalChainConfig);
+#if LATENCY_BENCH
+    LatencyBench_SetChainConfig(&signalChainConfig);
+#endif
 
     while (1) {
-        static float lastPressure = 0;
-        static float lastPressureChangingSpeed = 0;
-        static systime_t lastTimestamp = 0;
-        static float altitudeBuffer[BUFLENGTH] = {0};
-        static size_t sampleCount = 0;
-        static size_t sampleIndex = 0;
-
         struct PressureData_s rawData;
-        waitForMeasurementData(&rawData);
-
-        if (0 == sampleCount) {
-            lastPressure = rawData.pressure;
-            lastTimestamp = rawData.timestamp;
-            lastPressureChangingSpeed = 0;
-            sampleCount++;
-            continue;
-        }
+        struct SignalChainOutput_s output;
 
-        float rawPressure = rawData.pressure;
-        systime_t actualTimestamp = rawData.timestamp;
-        systime_t samplingTime = calculateElapsedTimeInMs(lastTimestamp, actualTimestamp);
-
-        float filteredPressure = ab_filter(
-                ALPHA,
-                BETA,
-                &lastPressure,
-                &lastPressureChangingSpeed,
-                rawPressure,
-                samplingTime);
-
-        float altitude = convertPressureToAltitude(filteredPressure);
-
-        altitudeBuffer[sampleIndex++ % BUFLENGTH] = altitude;
+        waitForMeasurementData(&rawData);
 
-        if (sampleCount < BUFLENGTH) {
-            sampleCount++;
+        bool outputReady = SignalChain_Process(&signalChain, rawData.pressure, getTimestampMs(rawData.timestamp), &output);
+        PipelineMonitor_Progress(PIPELINE_SAMPLE_PROCESSED);
+        if (!outputReady)
             continue;
-        }
-
-        float vario = calculateSlope(
-                altitudeBuffer,
-                BUFLENGTH,
-                sampleIndex % BUFLENGTH,
-                sampleCount,
-                samplingTime / 1000.0);
-
-        lastTimestamp = rawData.timestamp;
 
-        chMtxLock(&SignalProcessorMutex);
-        SignalProcessingOutputData.vario = vario;
-        SignalProcessingOutputData.baroAltitude = altitude;
-        SignalProcessingOutputData.filteredPressure = filteredPressure;
+        eventflags_t onsetFlags = 0;
+        if (ONSET_LIFT == output.newOnset)
+            onsetFlags = EARLY_LIFT;
+        if (ONSET_SINK == output.newOnset)
+            onsetFlags = EARLY_SINK;
+
+        TRACE_RING_MUTEX_LOCK(&SignalProcessorMutex);
+        SignalProcessingOutputData.pressure = rawData.pressure;
+        SignalProcessingOutputData.vario = output.vario;
+        SignalProcessingOutputData.baroAltitude = output.baroAltitude;
+        SignalProcessingOutputData.filteredPressure = output.filteredPressure;
+        SignalProcessingOutputData.earlyVario = output.earlyVario;
+        SignalProcessingOutputData.onset = output.onset;
         chMtxUnlock(&SignalProcessorMutex);
 
-        chEvtBroadcastFlags(&signalProcessorEvent, CALCULATION_FINISHED);
+#if LATENCY_BENCH
+        LatencyBench_MarkVario(SignalChain_SelectVario(&output));
+#endif
+        TRACE_RING_RECORD(TRACE_CALCULATION_FINISHED, (uint8_t)onsetFlags, 0);
+        chEvtBroadcastFlags(&signalProcessorEvent, CALCULATION_FINISHED | onsetFlags);
     }
 }
 
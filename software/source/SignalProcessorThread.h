@@ -11,6 +11,7 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "ch.h"
+#include "SignalChain.h"
 
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
@@ -24,13 +25,18 @@
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
 struct SignalProcessingOutputData_s {
+    uint32_t pressure;      /**< Raw sample of the sensor, Pa. */
     float vario;
     float baroAltitude;
     float filteredPressure;
+    float earlyVario;       /**< Fast, noisier vario from the alpha-beta filter. */
+    ClimbOnset_t onset;     /**< Set while vario lags behind a detected change. */
 };
 
 typedef enum {
-    CALCULATION_FINISHED = (1 << 0)
+    CALCULATION_FINISHED = (1 << 0),
+    EARLY_LIFT           = (1 << 1),
+    EARLY_SINK           = (1 << 2)
 } SignalProcessorEventFlags_t;
 
 /*******************************************************************************/
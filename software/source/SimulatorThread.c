@@ -1,22 +1,80 @@
 /**
  * @file SimulatorThread.c
- * @brief Thread to simulate processed data.
+ * @brief Thread generating scripted pressure samples in place of the sensor.
  * @author Molnar Zoltan
+ *
+ * A scenario is a looped script of flight segments and a sensor model. The
+ * flight model integrates the vertical speed of the segments into an
+ * altitude, the sensor model turns it into raw D1 and D2 conversions with
+ * noise, spikes and temperature drift, and the conversions go through the
+ * same compensation and message as the samples of the pressure reader. The
+ * sample period can be set well below the conversion time of the MS5611 to
+ * load test the processing chain.
  */
 
 /*******************************************************************************/
 /* INCLUDES                                                                    */
 /*******************************************************************************/
-#include "SignalProcessorThread.h"
+#include "CycleProbe.h"
+#include "LatencyBench.h"
+#include "PipelineMonitor.h"
+#include "PressureReaderThread.h"
+#include "SimulatorThread.h"
+#include "TraceRing.h"
+#include "VarioKernels.h"
 #include "hal.h"
 
+#include <math.h>
+
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+#define SAMPLE_TIME                               (SIMULATOR_SAMPLE_PERIOD / 1e6f)
+
+/* Sink of the glider while circling, m/s. */
+#define CIRCLING_SINK                                                     (-1.0f)
+#define CIRCLE_RADIUS                                                     (25.0f)
+/* Time of a full circle, s. */
+#define CIRCLE_PERIOD                                                     (20.0f)
+/* Correlation time of the turbulence, s. */
+#define GUST_TIME                                                          (1.0f)
+
+/* Temperature of the sensor at the start, 0.01 degC. */
+#define START_TEMPERATURE                                                    2500
+/*
+ * Lowest temperature of the sensor model, 0.01 degC. The conversions only
+ * invert the first order compensation, the second order one starts below.
+ */
+#define MIN_TEMPERATURE                                                      2000
 
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+typedef enum {
+    SEGMENT_GLIDE,              /**< Constant vertical speed. */
+    SEGMENT_THERMAL             /**< Circling in a thermal while centering the core. */
+} SegmentKind_t;
+
+struct ScenarioSegment_s {
+    SegmentKind_t kind;
+    uint16_t duration;          /**< s, 0 ends the script. */
+    int16_t climb;              /**< cm/s, vertical speed of a glide, core of a thermal. */
+    uint16_t radius;            /**< m, core radius of a thermal. */
+    uint16_t turbulence;        /**< cm/s RMS of the gusts. */
+};
+
+struct SensorModel_s {
+    uint16_t noise;             /**< 0.01 Pa RMS of the white noise. */
+    uint16_t spikeRate;         /**< Spikes per 10000 samples. */
+    uint16_t spikeSize;         /**< Pa. */
+    int16_t temperatureDrift;   /**< 0.01 degC per minute, restarts with the script loop. */
+};
+
+struct Scenario_s {
+    const struct ScenarioSegment_s *segments;
+    struct SensorModel_s sensor;
+    uint16_t altitude;          /**< m, at the start of the script. */
+};
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -25,6 +83,48 @@
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
 /*******************************************************************************/
+/*
+ * Thermal day: glides in turbulent air between thermals of different
+ * strength and size, and a strong sink on the way.
+ */
+static const struct ScenarioSegment_s thermalDay[] = {
+        {SEGMENT_GLIDE,   30, -100,  0,  30},
+        {SEGMENT_THERMAL, 90,  250, 60,  50},
+        {SEGMENT_GLIDE,   20, -350,  0,  80},
+        {SEGMENT_GLIDE,   20, -110,  0,  30},
+        {SEGMENT_THERMAL, 60,   90, 40,  20},
+        {SEGMENT_GLIDE,   15, -120,  0,  30},
+        {SEGMENT_THERMAL, 45,  500, 50, 100},
+        {SEGMENT_GLIDE,    0,    0,  0,   0}
+};
+
+/*
+ * Climb and sink steps in still air, repeatable input for load tests.
+ */
+static const struct ScenarioSegment_s steps[] = {
+        {SEGMENT_GLIDE, 20,    0, 0, 0},
+        {SEGMENT_GLIDE, 20,  150, 0, 0},
+        {SEGMENT_GLIDE, 20,    0, 0, 0},
+        {SEGMENT_GLIDE, 20, -300, 0, 0},
+        {SEGMENT_GLIDE,  0,    0, 0, 0}
+};
+
+static const struct Scenario_s scenarios[] = {
+        {thermalDay, {120, 5, 40,  -10}, 1200},
+        {steps,      {120, 0,  0,    0},  500},
+        {steps,      {  0, 0,  0,    0},  500}
+};
+
+/* Example calibration of the MS5611 datasheet. */
+static const struct Ms5611Calibration_s calibration = {
+    40127, 36924, 23317, 23282, 33464, 28312
+};
+
+struct SimulatorStatistics_s SimulatorStatistics;
+
+extern thread_t *pSignalProcessorThread;
+
+static uint32_t randomState = 1;
 
 /*******************************************************************************/
 /* DECLARATION OF LOCAL FUNCTIONS                                              */
@@ -33,6 +133,77 @@
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
 /*******************************************************************************/
+static uint32_t nextRandom(void) {
+    randomState = randomState * 1664525UL + 1013904223UL;
+    return randomState >> 8;
+}
+
+/**
+ * Approximately normal with unit variance, the sum of four uniform values
+ * is cheap without an FPU and close enough for noise.
+ */
+static float gaussianRandom(void) {
+    uint32_t sum = nextRandom() + nextRandom() + nextRandom() + nextRandom();
+    return (sum / 16777216.0f - 2.0f) * 1.7320508f;
+}
+
+/**
+ * Vertical speed of the glider in a segment.
+ * @param[in] time Time since the start of the segment, s.
+ */
+static float segmentClimb(const struct ScenarioSegment_s *segment, float time) {
+    float climb = segment->climb / 100.0f;
+
+    if (SEGMENT_GLIDE == segment->kind)
+        return climb;
+
+    /* The circle starts a core radius off and is centered by the end. */
+    float offset = segment->radius * (1.0f - time / segment->duration);
+    float angle = 2 * (float)M_PI * time / CIRCLE_PERIOD;
+    float distance2 = offset * offset + CIRCLE_RADIUS * CIRCLE_RADIUS +
+            2 * offset * CIRCLE_RADIUS * cosf(angle);
+    float radius2 = (float)segment->radius * segment->radius;
+
+    return climb * expf(-distance2 / radius2) + CIRCLING_SINK;
+}
+
+/**
+ * First order Gauss-Markov gust with the RMS of the segment.
+ */
+static float updateGust(float gust, const struct ScenarioSegment_s *segment) {
+    float sigma = segment->turbulence / 100.0f;
+    return gust * (1.0f - SAMPLE_TIME / GUST_TIME) +
+            sigma * sqrtf(2.0f * SAMPLE_TIME / GUST_TIME) * gaussianRandom();
+}
+
+static float altitudeToPressure(float altitude) {
+    return 101325.0f * powf(1.0f - altitude / 44330.0f, 5.255877f);
+}
+
+/**
+ * Raw conversions of a pressure and a temperature, the inverse of the first
+ * order compensation of the datasheet.
+ */
+static void encodeConversions(int32_t pressure, int32_t temperature, uint32_t *d1, uint32_t *d2) {
+    int64_t dT = (int64_t)(temperature - 2000) * (1 << 23) / calibration.c6;
+    int64_t off = ((int64_t)calibration.c2 << 16) + ((calibration.c4 * dT) >> 7);
+    int64_t sens = ((int64_t)calibration.c1 << 15) + ((calibration.c3 * dT) >> 8);
+
+    *d2 = (uint32_t)(dT + ((int64_t)calibration.c5 << 8));
+    *d1 = (uint32_t)(((((int64_t)pressure << 15) + off) << 21) / sens);
+}
+
+/**
+ * Measured pressure of the sensor model.
+ */
+static int32_t sensePressure(const struct SensorModel_s *sensor, float altitude) {
+    float pressure = altitudeToPressure(altitude) + sensor->noise / 100.0f * gaussianRandom();
+
+    if ((nextRandom() % 10000) < sensor->spikeRate)
+        pressure += (nextRandom() & 1) ? sensor->spikeSize : -sensor->spikeSize;
+
+    return (int32_t)(pressure + 0.5f);
+}
 
 /*******************************************************************************/
 /* DEFINITION OF GLOBAL FUNCTIONS                                              */
@@ -41,35 +212,66 @@ THD_FUNCTION(SimulatorThread, arg)
 {
     (void)arg;
 
-    chEvtObjectInit(&signalProcessorEvent);
+    chRegSetThreadName("SimulatorThread");
 
-    chThdSleepMilliseconds(2000);
+    const struct Scenario_s *scenario = &scenarios[SIMULATOR_SCENARIO];
+    const struct ScenarioSegment_s *segment = scenario->segments;
+    float altitude = scenario->altitude;
+    float segmentTime = 0;
+    float gust = 0;
+    uint64_t elapsed = 0;                   /* us since the start of the script loop */
 
-    float vario = 0;
-    while(1) {
-        while(vario < 7) {
-            vario += 1.0/100.0;
-            chMtxLock(&SignalProcessorMutex);
-            SignalProcessingOutputData.vario = vario;
-            chMtxUnlock(&SignalProcessorMutex);
+    /* Let the signal processor start, like the sensor start up does. */
+    chThdSleepMilliseconds(250);
 
-            chEvtBroadcastFlags(&signalProcessorEvent, CALCULATION_FINISHED);
-            chThdSleepMilliseconds(20);
+    systime_t previous = chVTGetSystemTime();
+    while (1) {
+        struct PressureData_s data = {0};
+        uint32_t d1, d2;
+
+        if (segment->duration <= segmentTime) {
+            segment++;
+            segmentTime = 0;
+            if (0 == segment->duration) {
+                segment = scenario->segments;
+                elapsed = 0;
+                SimulatorStatistics.scriptLoops++;
+            }
         }
-#if 1
-        while((-6) < vario) {
-            vario -= 1.0/100.0;
-            chMtxLock(&SignalProcessorMutex);
-            SignalProcessingOutputData.vario = vario;
-            chMtxUnlock(&SignalProcessorMutex);
-
-            chEvtBroadcastFlags(&signalProcessorEvent, CALCULATION_FINISHED);
-            chThdSleepMilliseconds(20);
+
+        gust = updateGust(gust, segment);
+        altitude += (segmentClimb(segment, segmentTime) + gust) * SAMPLE_TIME;
+        segmentTime += SAMPLE_TIME;
+        elapsed += SIMULATOR_SAMPLE_PERIOD;
+
+        int32_t temperature = START_TEMPERATURE +
+                (int32_t)(scenario->sensor.temperatureDrift * (int64_t)elapsed / 60000000);
+        if (temperature < MIN_TEMPERATURE)
+            temperature = MIN_TEMPERATURE;
+        encodeConversions(sensePressure(&scenario->sensor, altitude), temperature, &d1, &d2);
+
+        /* Sleep to the end of the conversion, a late wake up is an overrun. */
+        systime_t next = previous + US2ST(SIMULATOR_SAMPLE_PERIOD);
+        if ((systime_t)(chVTGetSystemTime() - previous) < (systime_t)(next - previous)) {
+            chThdSleepUntilWindowed(previous, next);
+        } else {
+            next = chVTGetSystemTime();
+            SimulatorStatistics.overruns++;
         }
+        previous = next;
+
+        VarioKernels_CompensateMs5611(&calibration, d1, d2, &data.pressure, &data.temperature);
+        CYCLE_PROBE_SAMPLE();
+        data.timestamp = chVTGetSystemTime();
+#if LATENCY_BENCH
+        LatencyBench_Inject(&data);
 #endif
+        TRACE_RING_RECORD(TRACE_SAMPLE_SEND, 0, (uint16_t)data.pressure);
+        PipelineMonitor_Progress(PIPELINE_SAMPLE_PRODUCED);
+        chMsgSend(pSignalProcessorThread, (msg_t)&data);
+        SimulatorStatistics.samples++;
     }
 }
 
 
 /******************************* END OF FILE ***********************************/
-
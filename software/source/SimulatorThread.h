@@ -1,6 +1,6 @@
 /**
  * @file SimulatorThread.h
- * @brief Thread to simulate processed data.
+ * @brief Thread generating scripted pressure samples in place of the sensor.
  * @author Molnar Zoltan
  */
 
@@ -15,6 +15,18 @@
 /*******************************************************************************/
 /* DEFINED CONSTANTS                                                           */
 /*******************************************************************************/
+/** Sample period in us, rounded to system ticks. */
+#if !defined(SIMULATOR_SAMPLE_PERIOD)
+#define SIMULATOR_SAMPLE_PERIOD                                             20000
+#endif
+
+/**
+ * Scenario script: 0 thermal day, 1 climb and sink steps, 2 the steps
+ * without sensor noise. See SimulatorThread.c.
+ */
+#if !defined(SIMULATOR_SCENARIO)
+#define SIMULATOR_SCENARIO                                                      0
+#endif
 
 /*******************************************************************************/
 /* MACRO DEFINITIONS                                                           */
@@ -23,17 +35,29 @@
 /*******************************************************************************/
 /* TYPE DEFINITIONS                                                            */
 /*******************************************************************************/
+/**
+ * Load test counters, only written by the simulator thread.
+ */
+struct SimulatorStatistics_s {
+    uint32_t samples;
+    uint32_t overruns;          /**< Samples sent after their slot, the chain could not keep up. */
+    uint32_t scriptLoops;
+};
 
 /*******************************************************************************/
 /* DECLARATION OF GLOBAL VARIABLES                                             */
 /*******************************************************************************/
+extern struct SimulatorStatistics_s SimulatorStatistics;
 
 /*******************************************************************************/
 /* DECLARATION OF GLOBAL FUNCTIONS                                             */
 /*******************************************************************************/
+/**
+ * Generate raw MS5611 conversions from the selected scenario, compensate
+ * them and send them to the signal processor like the pressure reader.
+ */
 THD_FUNCTION(SimulatorThread, arg);
 
 #endif
 
 /******************************* END OF FILE ***********************************/
-
@@ -0,0 +1,222 @@
+/**
+ * @file ThermalMap.c
+ * @brief Climb rate map around the current position.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ThermalMap.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define DEG_TO_RAD                                             (0.01745329252f)
+#define RAD_TO_DEG                                               (57.2957795f)
+#define METERS_PER_E7_DEGREE                                      (0.0111319f)
+
+#define THERMAL_MAP_DECAY                                                (0.99f)
+#define THERMAL_MAP_RENORMALIZE_LIMIT                                     (1e6f)
+#define THERMAL_MAP_MAX_ORIGIN_DISTANCE                                (20000.0f)
+#define THERMAL_MIN_CONFIDENCE                                           (0.05f)
+#define THERMAL_MIN_CLIMB                                                 (0.2f)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#define HALF_SIZE                                         (THERMAL_MAP_SIZE / 2)
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static int32_t wrapIndex(int32_t v)
+{
+    int32_t i = v % THERMAL_MAP_SIZE;
+    return (i < 0) ? i + THERMAL_MAP_SIZE : i;
+}
+
+static struct ThermalCell_s *getCell(struct ThermalMap_s *map, int32_t x, int32_t y)
+{
+    return &map->cells[wrapIndex(y)][wrapIndex(x)];
+}
+
+static void clearColumn(struct ThermalMap_s *map, int32_t x)
+{
+    int32_t column = wrapIndex(x);
+    int32_t row;
+    for (row = 0; row < THERMAL_MAP_SIZE; row++) {
+        map->cells[row][column].weight = 0;
+        map->cells[row][column].climbSum = 0;
+    }
+}
+
+static void clearRow(struct ThermalMap_s *map, int32_t y)
+{
+    memset(map->cells[wrapIndex(y)], 0, sizeof(map->cells[0]));
+}
+
+static void setOrigin(struct ThermalMap_s *map, int32_t latitude, int32_t longitude)
+{
+    memset(map->cells, 0, sizeof(map->cells));
+    map->originLatitude = latitude;
+    map->originLongitude = longitude;
+    map->longitudeScale = METERS_PER_E7_DEGREE * cosf(latitude * 1e-7f * DEG_TO_RAD);
+    map->centerX = 0;
+    map->centerY = 0;
+    map->sampleWeight = 1;
+    map->started = true;
+}
+
+/**
+ * Move the window to the new centre cell and clear the cells entering it.
+ */
+static void moveWindow(struct ThermalMap_s *map, int32_t x, int32_t y)
+{
+    int32_t dx = x - map->centerX;
+    int32_t dy = y - map->centerY;
+    int32_t i;
+
+    if ((THERMAL_MAP_SIZE <= dx) || (dx <= -THERMAL_MAP_SIZE) ||
+        (THERMAL_MAP_SIZE <= dy) || (dy <= -THERMAL_MAP_SIZE)) {
+        memset(map->cells, 0, sizeof(map->cells));
+    } else {
+        for (i = 0; i < dx; i++)
+            clearColumn(map, map->centerX - HALF_SIZE + THERMAL_MAP_SIZE + i);
+        for (i = 0; i < -dx; i++)
+            clearColumn(map, x - HALF_SIZE + i);
+        for (i = 0; i < dy; i++)
+            clearRow(map, map->centerY - HALF_SIZE + THERMAL_MAP_SIZE + i);
+        for (i = 0; i < -dy; i++)
+            clearRow(map, y - HALF_SIZE + i);
+    }
+
+    map->centerX = x;
+    map->centerY = y;
+}
+
+static void renormalize(struct ThermalMap_s *map)
+{
+    float scale = 1 / map->sampleWeight;
+    int32_t row, column;
+    for (row = 0; row < THERMAL_MAP_SIZE; row++) {
+        for (column = 0; column < THERMAL_MAP_SIZE; column++) {
+            map->cells[row][column].weight *= scale;
+            map->cells[row][column].climbSum *= scale;
+        }
+    }
+    map->sampleWeight = 1;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void ThermalMap_Init(struct ThermalMap_s *map)
+{
+    memset(map, 0, sizeof(*map));
+}
+
+void ThermalMap_Update(
+        struct ThermalMap_s *map,
+        int32_t latitude,
+        int32_t longitude,
+        float climb) {
+    if (!map->started)
+        setOrigin(map, latitude, longitude);
+
+    map->y = (latitude - map->originLatitude) * METERS_PER_E7_DEGREE;
+    map->x = (longitude - map->originLongitude) * map->longitudeScale;
+
+    /* Keep coordinates small enough for float precision. */
+    if ((THERMAL_MAP_MAX_ORIGIN_DISTANCE < fabsf(map->x)) ||
+        (THERMAL_MAP_MAX_ORIGIN_DISTANCE < fabsf(map->y))) {
+        setOrigin(map, latitude, longitude);
+        map->x = 0;
+        map->y = 0;
+    }
+
+    moveWindow(map,
+            (int32_t)floorf(map->x / THERMAL_MAP_CELL_SIZE),
+            (int32_t)floorf(map->y / THERMAL_MAP_CELL_SIZE));
+
+    map->sampleWeight /= THERMAL_MAP_DECAY;
+    if (THERMAL_MAP_RENORMALIZE_LIMIT < map->sampleWeight)
+        renormalize(map);
+
+    struct ThermalCell_s *cell = getCell(map, map->centerX, map->centerY);
+    cell->weight += map->sampleWeight;
+    cell->climbSum += map->sampleWeight * climb;
+}
+
+void ThermalMap_FindCore(const struct ThermalMap_s *map, struct ThermalCore_s *core)
+{
+    int32_t x, y;
+    float totalWeight = 0;
+    float totalClimb = 0;
+
+    core->valid = false;
+    if (!map->started)
+        return;
+
+    for (y = 0; y < THERMAL_MAP_SIZE; y++) {
+        for (x = 0; x < THERMAL_MAP_SIZE; x++) {
+            totalWeight += map->cells[y][x].weight;
+            totalClimb += map->cells[y][x].climbSum;
+        }
+    }
+
+    if (totalWeight <= 0)
+        return;
+
+    float mean = totalClimb / totalWeight;
+    float threshold = (mean < THERMAL_MIN_CLIMB) ? THERMAL_MIN_CLIMB : mean;
+    float sum = 0, sumX = 0, sumY = 0, sumClimb = 0;
+
+    for (y = map->centerY - HALF_SIZE; y < map->centerY - HALF_SIZE + THERMAL_MAP_SIZE; y++) {
+        for (x = map->centerX - HALF_SIZE; x < map->centerX - HALF_SIZE + THERMAL_MAP_SIZE; x++) {
+            const struct ThermalCell_s *cell = &map->cells[wrapIndex(y)][wrapIndex(x)];
+            float confidence = cell->weight / map->sampleWeight;
+            if (confidence < THERMAL_MIN_CONFIDENCE)
+                continue;
+
+            float climb = cell->climbSum / cell->weight;
+            if (climb <= threshold)
+                continue;
+
+            float w = (climb - mean) * confidence;
+            sum += w;
+            sumX += w * (x + 0.5f) * THERMAL_MAP_CELL_SIZE;
+            sumY += w * (y + 0.5f) * THERMAL_MAP_CELL_SIZE;
+            sumClimb += w * climb;
+        }
+    }
+
+    if (sum <= 0)
+        return;
+
+    float dx = sumX / sum - map->x;
+    float dy = sumY / sum - map->y;
+    core->distance = sqrtf(dx * dx + dy * dy);
+    core->bearing = atan2f(dx, dy) * RAD_TO_DEG;
+    if (core->bearing < 0)
+        core->bearing += 360.0f;
+    core->climb = sumClimb / sum;
+    core->valid = true;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,102 @@
+/**
+ * @file ThermalMap.h
+ * @brief Climb rate map around the current position.
+ * @author Molnar Zoltan
+ */
+
+#ifndef THERMALMAP_H
+#define THERMALMAP_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define THERMAL_MAP_SIZE                                                       12
+#define THERMAL_MAP_CELL_SIZE                                               25.0f
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Exponentially weighted climb rate of a cell. Both fields are scaled with
+ * the weight of the latest sample, see ThermalMap_s::sampleWeight.
+ */
+struct ThermalCell_s {
+    float weight;
+    float climbSum;
+};
+
+/**
+ * Pilot centred grid stored as a torus: world cell (x, y) lives in
+ * cells[y mod SIZE][x mod SIZE], so moving the window only clears the rows
+ * and columns entering it.
+ */
+struct ThermalMap_s {
+    struct ThermalCell_s cells[THERMAL_MAP_SIZE][THERMAL_MAP_SIZE];
+    int32_t originLatitude;     /**< Reference point in 1e-7 degrees. */
+    int32_t originLongitude;
+    float longitudeScale;       /**< Meters per 1e-7 degrees longitude. */
+    int32_t centerX;            /**< World cell of the pilot. */
+    int32_t centerY;
+    float x;                    /**< Pilot position in m from origin. */
+    float y;
+    float sampleWeight;         /**< Grows instead of decaying all cells. */
+    bool started;
+};
+
+/**
+ * Estimated thermal core relative to the pilot.
+ */
+struct ThermalCore_s {
+    float bearing;      /**< True bearing in degrees. */
+    float distance;     /**< Distance in m. */
+    float climb;        /**< Average climb rate in the core in m/s. */
+    bool valid;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Clear the map.
+ */
+void ThermalMap_Init(struct ThermalMap_s *map);
+
+/**
+ * Add a climb rate sample at the given position.
+ * @brief Older samples decay by a constant factor per call. Instead of
+ *        scaling every cell, the weight of new samples grows and the map is
+ *        renormalized when it gets large, so the cost is constant apart from
+ *        the rare renormalization and the clearing of cells that scroll in.
+ * @param[in] latitude Latitude in 1e-7 degrees.
+ * @param[in] longitude Longitude in 1e-7 degrees.
+ * @param[in] climb Climb rate in m/s.
+ */
+void ThermalMap_Update(
+        struct ThermalMap_s *map,
+        int32_t latitude,
+        int32_t longitude,
+        float climb);
+
+/**
+ * Estimate the thermal core as the climb weighted centroid of the cells
+ * climbing better than the map average.
+ */
+void ThermalMap_FindCore(const struct ThermalMap_s *map, struct ThermalCore_s *core);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
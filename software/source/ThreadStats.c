@@ -0,0 +1,267 @@
+/**
+ * @file ThreadStats.c
+ * @brief Per thread CPU load and stack watermarks.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ThreadStats.h"
+
+#if THREAD_STATS
+#include "chprintf.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if defined(VARIO_SIM)
+/* The simulator clock counts us of host time. */
+#define STATS_CLOCK_TICKS_PER_MS                                             1000
+#else
+/* DWT cycle counter. */
+#define STATS_CLOCK_TICKS_PER_MS                               (STM32_HCLK / 1000)
+#endif
+
+#if THREAD_STATS_PERIOD * 1000ULL * STATS_CLOCK_TICKS_PER_MS > 4000000000ULL
+#error "THREAD_STATS_PERIOD overflows the cycle counts"
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+/* Stack pointer saved at the last switch out, the top of the used stack. */
+#if defined(VARIO_SIM)
+#define SAVED_STACK_POINTER(tp)                 ((const uint8_t *)(tp)->p_ctx.esp)
+#else
+#define SAVED_STACK_POINTER(tp)                 ((const uint8_t *)(tp)->p_ctx.r13)
+#endif
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+#if !defined(VARIO_SIM)
+/* Stacks of the startup code, see the linker script. */
+extern uint8_t __main_stack_base__[];
+extern uint8_t __main_stack_end__[];
+extern uint8_t __main_thread_stack_base__[];
+extern uint8_t __main_thread_stack_end__[];
+#endif
+
+/* Written by the switch hook, under the system lock. */
+static uint32_t switchTime;
+static uint32_t switchCount;
+
+static bool requested;
+static systime_t lastCheck;
+static uint32_t sinceReport;                /* System ticks. */
+
+static struct ThreadStatsReport_s report;
+static size_t reportPending;
+static volatile uint32_t reportSequence;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t readClock(void) {
+#if defined(VARIO_SIM)
+    return SimHal_Microseconds();
+#else
+    return chSysGetRealtimeCounterX();
+#endif
+}
+
+static size_t countFill(const uint8_t *base, const uint8_t *end) {
+    const uint8_t *p = base;
+
+    while ((p < end) && (CH_DBG_STACK_FILL_VALUE == *p))
+        p++;
+
+    return (size_t)(p - base);
+}
+
+static size_t formatStack(char *buffer, size_t size, size_t unused) {
+    if (SIZE_MAX == unused)
+        return (size_t)chsnprintf(buffer, size, ",");
+    return (size_t)chsnprintf(buffer, size, ",%u", (unsigned)unused);
+}
+
+static void formatLine(char *buffer, size_t size, const struct ThreadStatsReport_s *data, size_t line) {
+    size_t length;
+
+    if (0 == line) {
+        length = (size_t)chsnprintf(buffer, size, "$PVTHS,%u,%u,%u",
+                (unsigned)(data->cycles / STATS_CLOCK_TICKS_PER_MS),
+                (unsigned)ThreadStats_Permille(data->idleCycles, data->cycles),
+                (unsigned)data->switches);
+        if (length < size)
+            formatStack(buffer + length, size - length, data->irqStackUnused);
+        return;
+    }
+
+    const struct ThreadStatsEntry_s *entry = &data->threads[line - 1];
+    length = (size_t)chsnprintf(buffer, size, "$PVTHR,%s,%u,%u",
+            (NULL != entry->name) ? entry->name : "",
+            (unsigned)entry->priority,
+            (unsigned)ThreadStats_Permille(entry->cycles, data->cycles));
+    if (length < size)
+        formatStack(buffer + length, size - length, entry->stackUnused);
+}
+
+static void appendChecksum(char *buffer, size_t size) {
+    uint8_t crc = 0;
+    size_t length;
+
+    for (length = 1; ('\0' != buffer[length]) && (length < size); length++)
+        crc ^= (uint8_t)buffer[length];
+
+    chsnprintf(buffer + length, size - length, "*%02X", crc);
+}
+
+/**
+ * Collect the cycles and stacks of all threads and restart the period.
+ */
+static void takeReport(struct ThreadStatsReport_s *data) {
+    thread_t *tp;
+
+    data->cycles = 0;
+    data->idleCycles = 0;
+    data->threadCount = 0;
+
+    /* The running thread is only charged at its next switch. */
+    chSysLock();
+    uint32_t now = readClock();
+    chThdGetSelfX()->statsCycles += now - switchTime;
+    switchTime = now;
+    data->switches = switchCount;
+    switchCount = 0;
+    chSysUnlock();
+
+    /* Threads are static, the registry walk is complete. */
+    tp = chRegFirstThread();
+    do {
+        chSysLock();
+        uint32_t cycles = tp->statsCycles;
+        tp->statsCycles = 0;
+        chSysUnlock();
+
+        data->cycles += cycles;
+        if (IDLEPRIO == tp->p_prio)
+            data->idleCycles += cycles;
+
+        if (data->threadCount < THREAD_STATS_MAX_THREADS) {
+            struct ThreadStatsEntry_s *entry = &data->threads[data->threadCount++];
+            entry->name = tp->p_name;
+            entry->priority = tp->p_prio;
+            entry->cycles = cycles;
+            entry->stackUnused = ThreadStats_StackUnused(tp);
+        }
+
+        tp = chRegNextThread(tp);
+    } while (NULL != tp);
+
+#if defined(VARIO_SIM)
+    data->irqStackUnused = SIZE_MAX;
+#else
+    data->irqStackUnused = countFill(__main_stack_base__, __main_stack_end__);
+#endif
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+uint32_t ThreadStats_Permille(uint32_t part, uint32_t whole) {
+    if (0 == whole)
+        return 0;
+    return (uint32_t)(((uint64_t)part * 1000 + whole / 2) / whole);
+}
+
+void ThreadStats_Init(void) {
+    chSysLock();
+    switchTime = readClock();
+    switchCount = 0;
+    chSysUnlock();
+
+    lastCheck = chVTGetSystemTime();
+}
+
+void ThreadStats_SwitchHook(thread_t *ntp, thread_t *otp) {
+    uint32_t now = readClock();
+
+    (void)ntp;
+
+    otp->statsCycles += now - switchTime;
+    switchTime = now;
+    switchCount++;
+}
+
+void ThreadStats_Request(void) {
+    requested = true;
+}
+
+uint32_t ThreadStats_ReportSequence(void) {
+    return reportSequence;
+}
+
+void ThreadStats_GetReport(struct ThreadStatsReport_s *copy) {
+    chSysLock();
+    *copy = report;
+    chSysUnlock();
+}
+
+size_t ThreadStats_StackUnused(const thread_t *tp) {
+    if (&ch.mainthread == tp) {
+#if defined(VARIO_SIM)
+        /* The main thread runs on the host stack. */
+        return SIZE_MAX;
+#else
+        /* Filled by the startup code with the same pattern. */
+        return countFill(__main_thread_stack_base__, __main_thread_stack_end__);
+#endif
+    }
+
+    /*
+     * The working area starts with the thread structure and the stack grows
+     * down towards it. The deepest use is always below the saved stack
+     * pointer, even if it is stale for the running thread.
+     */
+    return countFill((const uint8_t *)(tp + 1), SAVED_STACK_POINTER(tp));
+}
+
+bool ThreadStats_FormatReport(char *buffer, size_t size) {
+    systime_t now = chVTGetSystemTime();
+
+    sinceReport += (systime_t)(now - lastCheck);
+    lastCheck = now;
+
+    if ((0 == reportPending) &&
+            (requested || (S2ST(THREAD_STATS_PERIOD) <= sinceReport))) {
+        requested = false;
+        sinceReport = 0;
+        takeReport(&report);
+        reportSequence++;
+        reportPending = report.threadCount + 1;
+    }
+
+    if (0 == reportPending)
+        return false;
+
+    formatLine(buffer, size, &report, report.threadCount + 1 - reportPending--);
+    appendChecksum(buffer, size);
+#if defined(VARIO_SIM)
+    SimHal_Log("threads %s", buffer);
+#endif
+    return true;
+}
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,122 @@
+/**
+ * @file ThreadStats.h
+ * @brief Per thread CPU load and stack watermarks.
+ * @author Molnar Zoltan
+ *
+ * Built with THREAD_STATS (USE_THREAD_STATS=yes). The context switch hook
+ * of chconf.h charges the cycles since the previous switch to the thread
+ * switched out, the idle thread gives the idle time. Interrupts are charged
+ * to the thread they interrupted. The kernel fills the working areas with
+ * CH_DBG_STACK_FILL_VALUE, the untouched bytes at their bottom are the
+ * stack never used. Results are sent with the NMEA output every
+ * THREAD_STATS_PERIOD seconds, or with the next message on request:
+ *   $PVTHS,<period ms>,<idle 0.1%>,<context switches>,<irq stack free>*CS
+ *   $PVTHR,<name>,<priority>,<cpu 0.1%>,<stack free>*CS
+ *       one per thread in registry order, stack free in bytes, a stack
+ *       that can not be scanned is left empty.
+ */
+
+#ifndef THREADSTATS_H
+#define THREADSTATS_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if !defined(THREAD_STATS)
+#define THREAD_STATS                                                        FALSE
+#endif
+
+/** Report period in s, the 32 bit cycle counts limit it below a minute. */
+#if !defined(THREAD_STATS_PERIOD)
+#define THREAD_STATS_PERIOD                                                    10
+#endif
+
+/** Threads in a report, further ones are left out. */
+#define THREAD_STATS_MAX_THREADS                                               12
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+struct ThreadStatsEntry_s {
+    const char *name;
+    tprio_t priority;
+    uint32_t cycles;
+    size_t stackUnused;         /**< SIZE_MAX if the stack can not be scanned. */
+};
+
+/**
+ * Snapshot of a period.
+ */
+struct ThreadStatsReport_s {
+    uint32_t cycles;            /**< All threads, the length of the period. */
+    uint32_t idleCycles;
+    uint32_t switches;
+    size_t irqStackUnused;
+    size_t threadCount;
+    struct ThreadStatsEntry_s threads[THREAD_STATS_MAX_THREADS];
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Start the accounting, called after chSysInit().
+ */
+void ThreadStats_Init(void);
+
+/**
+ * Charge the running time to the thread switched out.
+ * @brief Called by the context switch hook in the locked state, declared
+ *        again in chconf.h.
+ */
+void ThreadStats_SwitchHook(thread_t *ntp, thread_t *otp);
+
+/**
+ * Share of a cycle count in 0.1 %.
+ */
+uint32_t ThreadStats_Permille(uint32_t part, uint32_t whole);
+
+/**
+ * Report with the next NMEA message instead of waiting for the period.
+ */
+void ThreadStats_Request(void);
+
+/**
+ * Number of reports taken, changes when a new report is available.
+ */
+uint32_t ThreadStats_ReportSequence(void);
+
+/**
+ * Copy of the latest report, the one sent with the NMEA output.
+ */
+void ThreadStats_GetReport(struct ThreadStatsReport_s *copy);
+
+/**
+ * Unused bytes at the bottom of the stack of a thread.
+ * @return SIZE_MAX if the stack can not be scanned.
+ */
+size_t ThreadStats_StackUnused(const thread_t *tp);
+
+/**
+ * Format the next pending report sentence, starts a new report when the
+ * period is over or one was requested.
+ * @return false if nothing is pending.
+ */
+bool ThreadStats_FormatReport(char *buffer, size_t size);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
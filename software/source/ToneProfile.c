@@ -0,0 +1,145 @@
+/**
+ * @file ToneProfile.c
+ * @brief Piecewise linear vario tone profiles.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ToneProfile.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * The profiles own a whole flash page, so it can be erased and rewritten
+ * without touching code or other data. The linker script of the board
+ * places the .tone_profiles section in the last page of the flash.
+ */
+union ToneProfilePage_u {
+    struct ToneProfile_s profiles[TONE_PROFILE_COUNT];
+    uint8_t page[TONE_PROFILE_PAGE_SIZE];
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+/* Volatile, the content is changed by flash programming. */
+static const volatile union ToneProfilePage_u toneProfilePage
+        __attribute__((aligned(TONE_PROFILE_PAGE_SIZE), section(".tone_profiles"))) = {
+    .profiles = {
+        {
+            "LINEAR",
+            4,
+            {
+                {-600,  150, 100,   0},
+                {   0,  400, 350,   0},
+                {   1,  600, 350, 230},
+                { 600, 1500, 100,  60}
+            }
+        },
+        {
+            "SOFT",
+            6,
+            {
+                {-600,  150, 150,   0},
+                {   0,  300, 400,   0},
+                {   1,  500, 400, 300},
+                { 100,  650, 300, 200},
+                { 300,  900, 180, 110},
+                { 600, 1200, 120,  80}
+            }
+        },
+        {
+            "FAST",
+            5,
+            {
+                {-600,  200,  80,   0},
+                {   0,  500, 250,   0},
+                {   1,  700, 250, 150},
+                { 200, 1100, 150,  90},
+                { 600, 1800,  70,  40}
+            }
+        }
+    }
+};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static bool isProfileValid(const volatile struct ToneProfile_s *profile)
+{
+    size_t i;
+
+    /* Erased flash reads as all ones. */
+    if ((profile->pointCount < 2) || (TONE_PROFILE_MAX_POINTS < profile->pointCount))
+        return false;
+
+    for (i = 0; i < profile->pointCount; i++) {
+        if ((0 < i) && (profile->points[i].vario <= profile->points[i - 1].vario))
+            return false;
+        if ((TONE_PROFILE_MAX_DURATION < profile->points[i].beepDuration) ||
+            (TONE_PROFILE_MAX_DURATION < profile->points[i].silenceDuration))
+            return false;
+    }
+
+    return true;
+}
+
+static uint16_t interpolate(int32_t x, int32_t x0, int32_t x1, int32_t y0, int32_t y1)
+{
+    return (uint16_t)(y0 + (y1 - y0) * (x - x0) / (x1 - x0));
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+const volatile struct ToneProfile_s *ToneProfile_Get(size_t index)
+{
+    if (TONE_PROFILE_COUNT <= index)
+        return NULL;
+
+    const volatile struct ToneProfile_s *profile = &toneProfilePage.profiles[index];
+    return isProfileValid(profile) ? profile : NULL;
+}
+
+void ToneProfile_Evaluate(
+        const volatile struct ToneProfile_s *profile,
+        int32_t vario,
+        struct ToneCurvePoint_s *tone) {
+    const volatile struct ToneCurvePoint_s *first = &profile->points[0];
+    const volatile struct ToneCurvePoint_s *last = &profile->points[profile->pointCount - 1];
+    size_t i;
+
+    if (vario <= first->vario) {
+        *tone = *first;
+    } else if (last->vario <= vario) {
+        *tone = *last;
+    } else {
+        for (i = 1; profile->points[i].vario < vario; i++)
+            ;
+
+        const volatile struct ToneCurvePoint_s *p0 = &profile->points[i - 1];
+        const volatile struct ToneCurvePoint_s *p1 = &profile->points[i];
+        tone->frequency = interpolate(vario, p0->vario, p1->vario, p0->frequency, p1->frequency);
+        tone->beepDuration = interpolate(vario, p0->vario, p1->vario, p0->beepDuration, p1->beepDuration);
+        tone->silenceDuration = interpolate(vario, p0->vario, p1->vario, p0->silenceDuration, p1->silenceDuration);
+    }
+
+    tone->vario = (int16_t)vario;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,77 @@
+/**
+ * @file ToneProfile.h
+ * @brief Piecewise linear vario tone profiles.
+ * @author Molnar Zoltan
+ */
+
+#ifndef TONEPROFILE_H
+#define TONEPROFILE_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define TONE_PROFILE_PAGE_SIZE                                               1024
+#define TONE_PROFILE_COUNT                                                      3
+#define TONE_PROFILE_MAX_POINTS                                                 8
+#define TONE_PROFILE_NAME_LENGTH                                               12
+/** Longest beep or silence in ms, fits the 16 bit count of the beep timer. */
+#define TONE_PROFILE_MAX_DURATION                                             655
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Breakpoint of a tone curve, values between breakpoints are interpolated
+ * linearly and held constant outside of them.
+ */
+struct ToneCurvePoint_s {
+    int16_t vario;              /**< cm/s. */
+    uint16_t frequency;         /**< Hz. */
+    uint16_t beepDuration;      /**< ms. */
+    uint16_t silenceDuration;   /**< ms, 0 is a continuous tone. */
+};
+
+struct ToneProfile_s {
+    char name[TONE_PROFILE_NAME_LENGTH];
+    uint32_t pointCount;
+    struct ToneCurvePoint_s points[TONE_PROFILE_MAX_POINTS];
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Get a profile from the profile flash page.
+ * @return NULL if the slot is empty or its content is invalid, a beep or
+ *         silence longer than TONE_PROFILE_MAX_DURATION is invalid.
+ */
+const volatile struct ToneProfile_s *ToneProfile_Get(size_t index);
+
+/**
+ * Evaluate the tone curves of a profile.
+ * @param[in] vario Vertical speed in cm/s.
+ * @param[out] tone Interpolated tone, its vario field is set to the input.
+ */
+void ToneProfile_Evaluate(
+        const volatile struct ToneProfile_s *profile,
+        int32_t vario,
+        struct ToneCurvePoint_s *tone);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
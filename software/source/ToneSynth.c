@@ -0,0 +1,223 @@
+/**
+ * @file ToneSynth.c
+ * @brief DMA driven beeper tone synthesis.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ToneSynth.h"
+
+#include <math.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define PI                                                          (3.14159265f)
+#define ENVELOPE_ONE                                                      (32767)
+
+/* Word offset of ARR, the burst writes ARR, RCR (reserved on TIM4) and CCR1. */
+#define TIM_DCR_BASE_ARR                                                      11
+#define TIM_DMA_BURST_LENGTH                                                   3
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * One PWM period as transferred by a DMA burst.
+ */
+struct ToneSample_s {
+    uint16_t arr;
+    uint16_t reserved;
+    uint16_t ccr;
+};
+
+struct ToneSynthState_s {
+    /* Set by the control thread. */
+    uint16_t targetPeriod;
+    uint16_t targetVolume;
+    uint32_t beepTime;
+    uint32_t silenceTime;
+
+    /* Owned by the refill interrupt. */
+    int32_t period;             /**< Current period, 8 fractional bits. */
+    int32_t volume;             /**< Current volume, 8 fractional bits. */
+    uint32_t phase;             /**< Time in the beep cycle in us. */
+    uint32_t envelopeTime;      /**< Position on the attack curve in us. */
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static PWMConfig synthPwmConfig = {
+        TONE_SYNTH_PWM_CLK,
+        TONE_SYNTH_IDLE_PERIOD,
+        NULL,
+        {
+                {PWM_OUTPUT_ACTIVE_HIGH, NULL},
+                {PWM_OUTPUT_DISABLED, NULL},
+                {PWM_OUTPUT_DISABLED, NULL},
+                {PWM_OUTPUT_DISABLED, NULL}
+        },
+        /* HW dependent part.*/
+        0,
+        STM32_TIM_DIER_UDE,
+};
+
+static struct ToneSample_s sampleBuffer[2 * TONE_SYNTH_HALF_BUFFER_SIZE];
+static uint16_t envelopeTable[TONE_SYNTH_ENVELOPE_SIZE];
+static struct ToneSynthState_s synth;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Raised cosine from 0 to ENVELOPE_ONE, used for attack and, backwards,
+ * for release.
+ */
+static void buildEnvelopeTable(void)
+{
+    int32_t i;
+    for (i = 0; i < TONE_SYNTH_ENVELOPE_SIZE; i++) {
+        float x = (float)i / (TONE_SYNTH_ENVELOPE_SIZE - 1);
+        envelopeTable[i] = (uint16_t)(ENVELOPE_ONE * 0.5f * (1 - cosf(PI * x)) + 0.5f);
+    }
+}
+
+/**
+ * Advance the cadence by one PWM period.
+ * @return true if the tone should sound at full envelope.
+ */
+static bool updateCadence(uint32_t period)
+{
+    if (0 == synth.targetPeriod)
+        return false;
+
+    if (0 == synth.silenceTime)
+        return true;
+
+    /* Start the release early enough to end with the beep. */
+    bool gate = (synth.phase + TONE_SYNTH_ENVELOPE_TIME < synth.beepTime);
+
+    synth.phase += period;
+    if (synth.beepTime + synth.silenceTime <= synth.phase)
+        synth.phase = 0;
+
+    return gate;
+}
+
+static uint32_t updateEnvelope(bool gate, uint32_t period)
+{
+    if (gate) {
+        synth.envelopeTime += period;
+        if (TONE_SYNTH_ENVELOPE_TIME < synth.envelopeTime)
+            synth.envelopeTime = TONE_SYNTH_ENVELOPE_TIME;
+    } else {
+        synth.envelopeTime = (period < synth.envelopeTime) ? synth.envelopeTime - period : 0;
+    }
+
+    return envelopeTable[synth.envelopeTime * (TONE_SYNTH_ENVELOPE_SIZE - 1) /
+                         TONE_SYNTH_ENVELOPE_TIME];
+}
+
+static void fillSamples(struct ToneSample_s *samples)
+{
+    size_t i;
+    for (i = 0; i < TONE_SYNTH_HALF_BUFFER_SIZE; i++) {
+        /* The pitch is held while silent so the release keeps it. */
+        if (0 != synth.targetPeriod)
+            synth.period += (((int32_t)synth.targetPeriod << 8) - synth.period) >> TONE_SYNTH_GLIDE_SHIFT;
+        synth.volume += (((int32_t)synth.targetVolume << 8) - synth.volume) >> TONE_SYNTH_VOLUME_SHIFT;
+
+        uint32_t period = (uint32_t)synth.period >> 8;
+        uint32_t gain = updateEnvelope(updateCadence(period), period);
+        uint32_t duty = ((period * gain) >> 15) * ((uint32_t)synth.volume >> 8) / TONE_SYNTH_MAX_VOLUME;
+
+        samples[i].arr = (uint16_t)(period - 1);
+        samples[i].ccr = (uint16_t)duty;
+    }
+}
+
+static void dmaCallback(void *p, uint32_t flags)
+{
+    (void)p;
+
+    if (flags & STM32_DMA_ISR_HTIF)
+        fillSamples(&sampleBuffer[0]);
+
+    if (flags & STM32_DMA_ISR_TCIF)
+        fillSamples(&sampleBuffer[TONE_SYNTH_HALF_BUFFER_SIZE]);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void ToneSynth_Start(void)
+{
+    buildEnvelopeTable();
+
+    synth.period = (int32_t)TONE_SYNTH_IDLE_PERIOD << 8;
+    fillSamples(&sampleBuffer[0]);
+    fillSamples(&sampleBuffer[TONE_SYNTH_HALF_BUFFER_SIZE]);
+
+    pwmStart(TONE_SYNTH_PWM, &synthPwmConfig);
+    pwmEnableChannel(TONE_SYNTH_PWM, 0, 0);
+
+    dmaStreamAllocate(TONE_SYNTH_DMA_STREAM, TONE_SYNTH_DMA_IRQ_PRIORITY, dmaCallback, NULL);
+    dmaStreamSetPeripheral(TONE_SYNTH_DMA_STREAM, &(TONE_SYNTH_PWM)->tim->DMAR);
+    dmaStreamSetMemory0(TONE_SYNTH_DMA_STREAM, sampleBuffer);
+    dmaStreamSetTransactionSize(TONE_SYNTH_DMA_STREAM,
+            2 * TONE_SYNTH_HALF_BUFFER_SIZE * TIM_DMA_BURST_LENGTH);
+    dmaStreamSetMode(TONE_SYNTH_DMA_STREAM,
+            STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MINC |
+            STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD |
+            STM32_DMA_CR_CIRC | STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE |
+            STM32_DMA_CR_PL(TONE_SYNTH_DMA_PRIORITY));
+
+    (TONE_SYNTH_PWM)->tim->DCR = STM32_TIM_DCR_DBA(TIM_DCR_BASE_ARR) |
+                                 STM32_TIM_DCR_DBL(TIM_DMA_BURST_LENGTH - 1);
+    dmaStreamEnable(TONE_SYNTH_DMA_STREAM);
+}
+
+void ToneSynth_SetToneI(uint16_t period, uint32_t beepTime, uint32_t silenceTime, bool restart)
+{
+    if (restart) {
+        synth.phase = 0;
+        /* Do not glide from an old pitch that is no longer audible. */
+        if ((0 != period) && (0 == synth.envelopeTime))
+            synth.period = (int32_t)period << 8;
+    }
+    synth.targetPeriod = period;
+    synth.beepTime = beepTime;
+    synth.silenceTime = silenceTime;
+}
+
+void ToneSynth_SetTone(uint16_t period, uint32_t beepTime, uint32_t silenceTime, bool restart)
+{
+    chSysLock();
+    ToneSynth_SetToneI(period, beepTime, silenceTime, restart);
+    chSysUnlock();
+}
+
+void ToneSynth_SetVolumeI(uint16_t volume)
+{
+    synth.targetVolume = volume;
+}
+
+void ToneSynth_SetVolume(uint16_t volume)
+{
+    chSysLock();
+    ToneSynth_SetVolumeI(volume);
+    chSysUnlock();
+}
+
+/******************************* END OF FILE ***********************************/
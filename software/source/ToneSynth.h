@@ -0,0 +1,90 @@
+/**
+ * @file ToneSynth.h
+ * @brief DMA driven beeper tone synthesis.
+ * @author Molnar Zoltan
+ */
+
+#ifndef TONESYNTH_H
+#define TONESYNTH_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define TONE_SYNTH_PWM                                                     &PWMD4
+#define TONE_SYNTH_PWM_CLK                                              (1000000)
+#define TONE_SYNTH_DMA_STREAM                                  STM32_DMA1_STREAM7
+#define TONE_SYNTH_DMA_PRIORITY                                                 2
+#define TONE_SYNTH_DMA_IRQ_PRIORITY                                             7
+
+/** PWM periods per buffer half, the refill interrupt rate is tone / this. */
+#define TONE_SYNTH_HALF_BUFFER_SIZE                                            32
+#define TONE_SYNTH_ENVELOPE_SIZE                                               32
+/** Attack and release time in us. */
+#define TONE_SYNTH_ENVELOPE_TIME                                             8000
+/** Period used while silent to keep the stream running, in PWM ticks. */
+#define TONE_SYNTH_IDLE_PERIOD                                               1000
+/** Frequency glide speed, the period moves 1 / 2^n of the way per period. */
+#define TONE_SYNTH_GLIDE_SHIFT                                                  4
+/** Volume ramp speed, the volume moves 1 / 2^n of the way per period. */
+#define TONE_SYNTH_VOLUME_SHIFT                                                 5
+/** Volume is given in 1/100 percents of PWM duty cycle. */
+#define TONE_SYNTH_MAX_VOLUME                                               10000
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Start the tone timer and its DMA stream, initially silent.
+ * @brief TIM4 update events trigger a DMA burst to DMAR, which loads the
+ *        preloaded ARR and CCR1 of the next PWM period from a circular
+ *        buffer. The buffer halves are refilled from the half and full
+ *        transfer interrupts, so no CPU time is spent per PWM period.
+ *        The envelope table is generated here once.
+ */
+void ToneSynth_Start(void);
+
+/**
+ * Set tone and cadence.
+ * @param[in] period PWM period in ticks of TONE_SYNTH_PWM_CLK, 0 is silence.
+ * @param[in] beepTime Length of a beep in us.
+ * @param[in] silenceTime Pause between beeps in us, 0 is a continuous tone.
+ * @param[in] restart Start the cadence with a new beep.
+ */
+void ToneSynth_SetTone(uint16_t period, uint32_t beepTime, uint32_t silenceTime, bool restart);
+
+/**
+ * Set tone and cadence from a locked context, see ToneSynth_SetTone().
+ */
+void ToneSynth_SetToneI(uint16_t period, uint32_t beepTime, uint32_t silenceTime, bool restart);
+
+/**
+ * Set volume, changes are ramped.
+ * @param[in] volume PWM duty cycle at full envelope in 1/100 percents.
+ */
+void ToneSynth_SetVolume(uint16_t volume);
+
+/**
+ * Set volume from a locked context, see ToneSynth_SetVolume().
+ */
+void ToneSynth_SetVolumeI(uint16_t volume);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,76 @@
+/**
+ * @file TraceFormat.h
+ * @brief RTOS independent format of the trace ring dumps, shared by the
+ *        firmware and the host decoder.
+ * @author Molnar Zoltan
+ *
+ * A dump is a sequence of frames on the serial link, between NMEA
+ * sentences:
+ *   0xA5 0x5A <type> <length> <payload: length bytes> <check>
+ * check is the XOR of type, length and the payload. Multi byte fields are
+ * little endian. A dump is a header frame, one thread frame per thread,
+ * the event frames from the oldest to the newest record and an end frame:
+ *   H  version u8, clock Hz u32, records u16, overwritten u32
+ *   T  thread id u16, priority u8, name (rest of the payload)
+ *   E  records of TRACE_RECORD_SIZE bytes:
+ *      time u32 (clock ticks), event u8, arg u8, value u16
+ *   Z  empty
+ * Thread ids are the low 16 bits of the thread_t addresses.
+ */
+
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define TRACE_FORMAT_VERSION                                                    1
+
+#define TRACE_SYNC_0                                                         0xA5
+#define TRACE_SYNC_1                                                         0x5A
+
+#define TRACE_FRAME_HEADER                                                    'H'
+#define TRACE_FRAME_THREAD                                                    'T'
+#define TRACE_FRAME_EVENTS                                                    'E'
+#define TRACE_FRAME_END                                                       'Z'
+
+#define TRACE_RECORD_SIZE                                                       8
+/** Records per event frame. */
+#define TRACE_RECORDS_PER_FRAME                                                16
+#define TRACE_MAX_PAYLOAD                 (TRACE_RECORD_SIZE * TRACE_RECORDS_PER_FRAME)
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Trace events, the value is the event specific field of the record.
+ */
+typedef enum {
+    TRACE_SWITCH = 1,           /**< Thread switched in, value is its id. */
+    TRACE_ISR_BEEP_TIMER,       /**< Beep cadence timer interrupt. */
+    TRACE_ISR_BUTTON,           /**< Button edge, arg is the pad level. */
+    TRACE_SERIAL_INPUT,         /**< GPS USART input handled, value is the byte count. */
+    TRACE_SAMPLE_SEND,          /**< Pressure sample sent, value is the low 16 bits of the Pa. */
+    TRACE_SAMPLE_RECEIVE,       /**< Pressure sample received, value as above. */
+    TRACE_CALCULATION_FINISHED, /**< Broadcast of the results, arg is the onset flags. */
+    TRACE_NMEA_READY,           /**< NMEA sentence handed to the serial handler. */
+    TRACE_MUTEX_CONTENDED,      /**< SignalProcessorMutex found locked, value is the owner. */
+    TRACE_MUTEX_ACQUIRED,       /**< SignalProcessorMutex locked after a contention. */
+    TRACE_EVENT_COUNT
+} TraceEvent_t;
+
+struct TraceRecord_s {
+    uint32_t time;
+    uint8_t event;
+    uint8_t arg;
+    uint16_t value;
+};
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,253 @@
+/**
+ * @file TraceRing.c
+ * @brief Binary trace of thread switches, interrupts and the sample path.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "TraceRing.h"
+
+#if TRACE_RING
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if defined(VARIO_SIM)
+/* The simulator clock counts us of host time. */
+#define TRACE_CLOCK_HZ                                                    1000000
+#else
+/* DWT cycle counter. */
+#define TRACE_CLOCK_HZ                                                 STM32_HCLK
+#endif
+
+#if (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) != 0
+#error "TRACE_RING_SIZE is not a power of two"
+#endif
+
+/* Longest thread name sent, the rest is cut. */
+#define TRACE_NAME_LENGTH                                                      24
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#define THREAD_ID(tp)                                  ((uint16_t)(uintptr_t)(tp))
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+typedef enum {
+    DUMP_IDLE,
+    DUMP_THREADS,
+    DUMP_EVENTS,
+    DUMP_END
+} DumpState_t;
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+/* Written from any context, under the system lock. */
+static struct TraceRecord_s ring[TRACE_RING_SIZE];
+static uint32_t recorded;                   /* Since the last dump, may exceed the ring. */
+static bool frozen;
+
+/* Frame payload of the dump, static to spare the serial handler stack. */
+static uint8_t framePayload[TRACE_MAX_PAYLOAD];
+
+static bool requested;
+static systime_t lastCheck;
+static uint32_t sinceDump;                  /* System ticks. */
+
+/* Dump in progress, written a frame at a time by the serial handler. */
+static DumpState_t dumpState;
+static thread_t *dumpThread;
+static uint32_t dumpFirst;
+static uint32_t dumpCount;
+static uint32_t dumpNext;
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static uint32_t readClock(void) {
+#if defined(VARIO_SIM)
+    return SimHal_Microseconds();
+#else
+    return chSysGetRealtimeCounterX();
+#endif
+}
+
+static void recordX(TraceEvent_t event, uint8_t arg, uint16_t value) {
+    if (frozen)
+        return;
+
+    struct TraceRecord_s *record = &ring[recorded++ & (TRACE_RING_SIZE - 1)];
+    record->time = readClock();
+    record->event = (uint8_t)event;
+    record->arg = arg;
+    record->value = value;
+}
+
+static size_t put16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    return 2;
+}
+
+static size_t put32(uint8_t *buffer, uint32_t value) {
+    put16(buffer, (uint16_t)value);
+    put16(buffer + 2, (uint16_t)(value >> 16));
+    return 4;
+}
+
+static void writeFrame(BaseSequentialStream *stream, uint8_t type, const uint8_t *payload, size_t length) {
+    uint8_t header[4] = {TRACE_SYNC_0, TRACE_SYNC_1, type, (uint8_t)length};
+    uint8_t check = type ^ (uint8_t)length;
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        check ^= payload[i];
+
+    streamWrite(stream, header, sizeof(header));
+    if (0 < length)
+        streamWrite(stream, payload, length);
+    streamWrite(stream, &check, 1);
+}
+
+/**
+ * Freeze the ring and write the header frame.
+ */
+static void writeHeader(BaseSequentialStream *stream) {
+    size_t length = 0;
+
+    chSysLock();
+    frozen = true;
+    dumpCount = (TRACE_RING_SIZE < recorded) ? TRACE_RING_SIZE : recorded;
+    dumpFirst = recorded - dumpCount;
+    chSysUnlock();
+    dumpNext = 0;
+
+    framePayload[length++] = TRACE_FORMAT_VERSION;
+    length += put32(framePayload + length, TRACE_CLOCK_HZ);
+    length += put16(framePayload + length, (uint16_t)dumpCount);
+    length += put32(framePayload + length, dumpFirst);
+    writeFrame(stream, TRACE_FRAME_HEADER, framePayload, length);
+}
+
+static void writeThread(BaseSequentialStream *stream, const thread_t *tp) {
+    size_t length = put16(framePayload, THREAD_ID(tp));
+    framePayload[length++] = (uint8_t)tp->p_prio;
+    if (NULL != tp->p_name) {
+        size_t nameLength = strlen(tp->p_name);
+        if (TRACE_NAME_LENGTH < nameLength)
+            nameLength = TRACE_NAME_LENGTH;
+        memcpy(framePayload + length, tp->p_name, nameLength);
+        length += nameLength;
+    }
+    writeFrame(stream, TRACE_FRAME_THREAD, framePayload, length);
+}
+
+/**
+ * Write the next TRACE_RECORDS_PER_FRAME records at most.
+ */
+static void writeEvents(BaseSequentialStream *stream) {
+    size_t length = 0;
+
+    while ((dumpNext < dumpCount) && (length < TRACE_MAX_PAYLOAD)) {
+        const struct TraceRecord_s *record = &ring[(dumpFirst + dumpNext) & (TRACE_RING_SIZE - 1)];
+        length += put32(framePayload + length, record->time);
+        framePayload[length++] = record->event;
+        framePayload[length++] = record->arg;
+        length += put16(framePayload + length, record->value);
+        dumpNext++;
+    }
+    writeFrame(stream, TRACE_FRAME_EVENTS, framePayload, length);
+}
+
+/**
+ * Write the end frame and start the ring over.
+ */
+static void writeEnd(BaseSequentialStream *stream) {
+    writeFrame(stream, TRACE_FRAME_END, NULL, 0);
+
+    chSysLock();
+    recorded = 0;
+    frozen = false;
+    chSysUnlock();
+
+    requested = false;
+    sinceDump = 0;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void TraceRing_Record(TraceEvent_t event, uint8_t arg, uint16_t value) {
+    syssts_t status = chSysGetStatusAndLockX();
+    recordX(event, arg, value);
+    chSysRestoreStatusX(status);
+}
+
+void TraceRing_SwitchHook(thread_t *ntp) {
+    recordX(TRACE_SWITCH, 0, THREAD_ID(ntp));
+}
+
+void TraceRing_MutexLock(mutex_t *mtx) {
+    if (chMtxTryLock(mtx))
+        return;
+
+    /* The owner may unlock in between, it is only read for the record. */
+    TraceRing_Record(TRACE_MUTEX_CONTENDED, 0, THREAD_ID(mtx->m_owner));
+    chMtxLock(mtx);
+    TraceRing_Record(TRACE_MUTEX_ACQUIRED, 0, 0);
+}
+
+void TraceRing_Request(void) {
+    requested = true;
+}
+
+bool TraceRing_IsDumpDue(void) {
+    systime_t now = chVTGetSystemTime();
+
+    sinceDump += (systime_t)(now - lastCheck);
+    lastCheck = now;
+
+    if (requested || (DUMP_IDLE != dumpState))
+        return true;
+
+    return (0 < TRACE_RING_PERIOD) && (S2ST(TRACE_RING_PERIOD) <= sinceDump);
+}
+
+void TraceRing_DumpFrame(BaseSequentialStream *stream) {
+    switch (dumpState) {
+    case DUMP_IDLE:
+        writeHeader(stream);
+        dumpThread = chRegFirstThread();
+        dumpState = DUMP_THREADS;
+        break;
+    case DUMP_THREADS:
+        writeThread(stream, dumpThread);
+        dumpThread = chRegNextThread(dumpThread);
+        if (NULL == dumpThread)
+            dumpState = (dumpNext < dumpCount) ? DUMP_EVENTS : DUMP_END;
+        break;
+    case DUMP_EVENTS:
+        writeEvents(stream);
+        if (dumpCount == dumpNext)
+            dumpState = DUMP_END;
+        break;
+    case DUMP_END:
+    default:
+        writeEnd(stream);
+        dumpState = DUMP_IDLE;
+        break;
+    }
+}
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,103 @@
+/**
+ * @file TraceRing.h
+ * @brief Binary trace of thread switches, interrupts and the sample path.
+ * @author Molnar Zoltan
+ *
+ * Built with TRACE_RING (USE_TRACE_RING=yes). The last TRACE_RING_SIZE
+ * events are kept in RAM with a cycle timestamp. Every TRACE_RING_PERIOD
+ * seconds, or on request, the serial handler writes them to SD1 in the
+ * framed format of TraceFormat.h, and the ring starts over. The dump is
+ * written a frame at a time between the NMEA sentences, so the GPS input
+ * is still read meanwhile. The ring is frozen from the header frame to the
+ * end frame, events are not recorded while a dump is written. Decode a
+ * capture of the Kobo link with host/TraceDecode.c.
+ */
+
+#ifndef TRACERING_H
+#define TRACERING_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "TraceFormat.h"
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#if !defined(TRACE_RING)
+#define TRACE_RING                                                          FALSE
+#endif
+
+/** Records in the ring, a power of two. */
+#if !defined(TRACE_RING_SIZE)
+#define TRACE_RING_SIZE                                                       128
+#endif
+
+/** Dump period in s, 0 dumps only on request. */
+#if !defined(TRACE_RING_PERIOD)
+#define TRACE_RING_PERIOD                                                      30
+#endif
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#if TRACE_RING
+#define TRACE_RING_RECORD(event, arg, value)  TraceRing_Record(event, arg, value)
+#define TRACE_RING_MUTEX_LOCK(mtx)                          TraceRing_MutexLock(mtx)
+#else
+#define TRACE_RING_RECORD(event, arg, value)
+#define TRACE_RING_MUTEX_LOCK(mtx)                                  chMtxLock(mtx)
+#endif
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+#if TRACE_RING
+/**
+ * Record an event, from any context.
+ */
+void TraceRing_Record(TraceEvent_t event, uint8_t arg, uint16_t value);
+
+/**
+ * Record a thread switch, called by the context switch hook in the locked
+ * state, declared again in chconf.h.
+ */
+void TraceRing_SwitchHook(thread_t *ntp);
+
+/**
+ * Lock a mutex, a contention is recorded with the owner and the time the
+ * lock is acquired.
+ */
+void TraceRing_MutexLock(mutex_t *mtx);
+
+/**
+ * Dump with the next chance instead of waiting for the period.
+ */
+void TraceRing_Request(void);
+
+/**
+ * @return true if the period is over, a dump was requested or a dump is in
+ *         progress.
+ */
+bool TraceRing_IsDumpDue(void);
+
+/**
+ * Write the next frame of the dump to a stream. The first frame freezes
+ * the ring, after the end frame it starts over.
+ */
+void TraceRing_DumpFrame(BaseSequentialStream *stream);
+#endif
+
+#endif
+
+/******************************* END OF FILE ***********************************/
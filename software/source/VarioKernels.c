@@ -0,0 +1,278 @@
+/**
+ * @file VarioKernels.c
+ * @brief RTOS independent signal chain kernels.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "VarioKernels.h"
+
+#include <math.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define MPS_TO_KPH                                                         (3.6f)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Output cursor of the sentence formatter, the end is reserved for the
+ * terminating zero.
+ */
+struct NmeaWriter_s {
+    char *buffer;
+    size_t size;
+    size_t length;
+};
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+static const char hexDigits[] = "0123456789ABCDEF";
+static const int32_t powersOfTen[] = {1, 10, 100, 1000};
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+static void writerInit(struct NmeaWriter_s *writer, char *buffer, size_t size) {
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->length = 0;
+    if (0 < size)
+        buffer[0] = '\0';
+}
+
+static void appendChar(struct NmeaWriter_s *writer, char c) {
+    if (writer->length + 1 < writer->size) {
+        writer->buffer[writer->length++] = c;
+        writer->buffer[writer->length] = '\0';
+    }
+}
+
+static void appendString(struct NmeaWriter_s *writer, const char *s) {
+    while ('\0' != *s)
+        appendChar(writer, *s++);
+}
+
+/**
+ * Append the decimal digits of a value, padded with zeros to minDigits.
+ */
+static void appendUnsigned(struct NmeaWriter_s *writer, uint32_t value, size_t minDigits) {
+    char digits[10];
+    size_t count = 0;
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while ((0 != value) || (count < minDigits));
+
+    while (0 < count)
+        appendChar(writer, digits[--count]);
+}
+
+static void appendInt(struct NmeaWriter_s *writer, int32_t value) {
+    if (value < 0) {
+        appendChar(writer, '-');
+        appendUnsigned(writer, (uint32_t)-value, 1);
+    } else {
+        appendUnsigned(writer, (uint32_t)value, 1);
+    }
+}
+
+/**
+ * Append a value rounded to the given number of decimals, 1..3.
+ */
+static void appendFixed(struct NmeaWriter_s *writer, float value, size_t decimals) {
+    int32_t scale = powersOfTen[decimals];
+    float scaled = value * scale;
+    int32_t fixed = (int32_t)(scaled + ((scaled < 0) ? -0.5f : 0.5f));
+
+    if (fixed < 0) {
+        appendChar(writer, '-');
+        fixed = -fixed;
+    }
+    appendUnsigned(writer, (uint32_t)(fixed / scale), 1);
+    appendChar(writer, '.');
+    appendUnsigned(writer, (uint32_t)(fixed % scale), decimals);
+}
+
+/**
+ * Append the checksum of the characters between '$' and the end.
+ */
+static void appendChecksum(struct NmeaWriter_s *writer) {
+    uint8_t crc = 0;
+    size_t i;
+    for (i = 1; i < writer->length; i++)
+        crc ^= (uint8_t)writer->buffer[i];
+
+    appendChar(writer, '*');
+    appendChar(writer, hexDigits[crc >> 4]);
+    appendChar(writer, hexDigits[crc & 0x0F]);
+}
+
+static int32_t roundToDegrees(float angle) {
+    return (int32_t)(angle + 0.5f) % 360;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+float VarioKernels_AlphaBetaFilter(
+        float alpha,
+        float beta,
+        float *position,
+        float *velocity,
+        float measurement,
+        float samplingTime) {
+    float xk = *position + (*velocity * samplingTime);
+    float vk = *velocity;
+
+    float rk = measurement - xk;
+
+    xk += alpha * rk;
+    vk += beta * rk / samplingTime;
+
+    *position = xk;
+    *velocity = vk;
+
+    return xk;
+}
+
+float VarioKernels_PressureToAltitude(float pressure) {
+    return 44330 * (1 - pow ((pressure / 101325.0), 0.1902));
+}
+
+float VarioKernels_PressureRateToVario(float pressure, float pressureRate) {
+    float altitudePerPascal = 44330 * 0.1902f * powf(pressure / 101325.0f, 0.1902f) / pressure;
+    return -altitudePerPascal * pressureRate * 1000;
+}
+
+float VarioKernels_Slope(
+        const float *buffer,
+        size_t bufferLength,
+        size_t startIndex,
+        size_t sampleCount,
+        float dt) {
+    float x_avg = 0;
+    float y_avg = 0;
+    size_t i;
+    for (i = 0; i < sampleCount; i++) {
+        size_t j;
+        if (startIndex + i < bufferLength)
+            j = startIndex + i;
+        else
+            j = i - bufferLength + startIndex;
+
+        x_avg += i * dt;
+        y_avg += buffer[j];
+    }
+
+    x_avg /= sampleCount;
+    y_avg /= sampleCount;
+
+    float num = 0;
+    float den = 0;
+    for (i = 0; i < sampleCount; i++) {
+        size_t j;
+        if (startIndex + i < bufferLength)
+            j = startIndex + i;
+        else
+            j = i - bufferLength + startIndex;
+        num += (i*dt - x_avg) * (buffer[j] - y_avg);
+        den += (i*dt - x_avg) * (i*dt - x_avg);
+    }
+
+    return num/den;
+}
+
+void VarioKernels_CompensateMs5611(
+        const struct Ms5611Calibration_s *calibration,
+        uint32_t d1,
+        uint32_t d2,
+        uint32_t *pP,
+        int32_t *pT) {
+    int64_t dT = (int64_t)d2 - ((uint64_t)calibration->c5 << 8);
+    int64_t TEMP = 2000 + ((dT * (int64_t)calibration->c6) >> 23);
+    int64_t OFF = ((uint64_t)calibration->c2 << 16) + (((int64_t)calibration->c4 * dT) >> 7);
+    int64_t SENS = ((int64_t)calibration->c1 << 15) + ((dT * (int64_t)(calibration->c3) >> 8));
+    int64_t T2 = 0;
+    int64_t OFF2 = 0;
+    int64_t SENS2 = 0;
+
+    /* Second order temperature compensation. */
+    if (TEMP < 2000) {
+        T2 = ((dT * dT) >> 31);
+        OFF2 = (5 * (TEMP - 2000) * (TEMP - 2000)) >> 1;
+        SENS2 = (5 * (TEMP - 2000) * (TEMP - 2000)) >> 2;
+
+        /* Very low temperature. */
+        if( TEMP < (-15)) {
+            OFF2 = OFF2 + (7 * (TEMP + 1500) * (TEMP + 1500));
+            SENS2 = SENS2 + ((11 * (TEMP + 1500) * (TEMP + 1500)) >> 2);
+        }
+    }
+
+    TEMP -= T2;
+    OFF -= OFF2;
+    SENS -= SENS2;
+
+    /* Calculate temperature and temperature compensated pressure */
+    *pT = (int32_t)TEMP;
+    *pP = (uint32_t)(((((int64_t)d1 * SENS) >> 21) - OFF) >> 15);
+}
+
+size_t VarioKernels_FormatLxwp0(char *buffer, size_t size, const struct Lxwp0Data_s *data) {
+    struct NmeaWriter_s writer;
+    writerInit(&writer, buffer, size);
+
+    appendString(&writer, "$LXWP0,N,,");
+    appendFixed(&writer, data->baroAltitude, 2);
+    appendChar(&writer, ',');
+    appendFixed(&writer, data->vario, 2);
+    appendString(&writer, ",,,,,,,");
+    if (data->windValid) {
+        /* Wind direction and speed (km/h) are the last two fields. */
+        appendInt(&writer, roundToDegrees(data->windDirection));
+        appendChar(&writer, ',');
+        appendFixed(&writer, data->windSpeed * MPS_TO_KPH, 1);
+    } else {
+        appendChar(&writer, ',');
+    }
+    appendChecksum(&writer);
+
+    return writer.length;
+}
+
+size_t VarioKernels_FormatThermalCore(
+        char *buffer,
+        size_t size,
+        float bearing,
+        float distance,
+        float climb) {
+    struct NmeaWriter_s writer;
+    writerInit(&writer, buffer, size);
+
+    appendString(&writer, "$PVTHC,");
+    appendInt(&writer, roundToDegrees(bearing));
+    appendChar(&writer, ',');
+    appendInt(&writer, (int32_t)(distance + 0.5f));
+    appendChar(&writer, ',');
+    appendFixed(&writer, climb, 1);
+    appendChecksum(&writer);
+
+    return writer.length;
+}
+
+/******************************* END OF FILE ***********************************/
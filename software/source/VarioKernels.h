@@ -0,0 +1,128 @@
+/**
+ * @file VarioKernels.h
+ * @brief RTOS independent signal chain kernels.
+ * @author Molnar Zoltan
+ */
+
+#ifndef VARIOKERNELS_H
+#define VARIOKERNELS_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * MS5611 factory calibration words C1..C6.
+ */
+struct Ms5611Calibration_s {
+    uint16_t c1;    /**< Pressure sensitivity | SENS T1 */
+    uint16_t c2;    /**< Pressure offset | OFF T1 */
+    uint16_t c3;    /**< Temperature coefficient of pressure sensitivity | TCS */
+    uint16_t c4;    /**< Temperature coefficient of pressure offset | TCO */
+    uint16_t c5;    /**< Reference temperature | T REF */
+    uint16_t c6;    /**< Temperature coefficient of the temperature | TEMPSENS */
+};
+
+struct Lxwp0Data_s {
+    float baroAltitude;     /**< m. */
+    float vario;            /**< m/s. */
+    float windSpeed;        /**< m/s. */
+    float windDirection;    /**< deg. */
+    bool windValid;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * One step of the alpha-beta filter.
+ * @param[in,out] position Filtered value.
+ * @param[in,out] velocity Rate of change of the filtered value per ms.
+ * @param[in] samplingTime Time since the previous measurement in ms.
+ * @return The new filtered value.
+ */
+float VarioKernels_AlphaBetaFilter(
+        float alpha,
+        float beta,
+        float *position,
+        float *velocity,
+        float measurement,
+        float samplingTime);
+
+/**
+ * Convert pressure in Pa to altitude in the standard atmosphere.
+ */
+float VarioKernels_PressureToAltitude(float pressure);
+
+/**
+ * Convert a pressure rate in Pa/ms to vertical speed in m/s.
+ */
+float VarioKernels_PressureRateToVario(float pressure, float pressureRate);
+
+/**
+ * Least squares slope of evenly sampled values in a ring buffer.
+ * @param[in] startIndex Index of the oldest sample.
+ * @param[in] dt Sampling time.
+ */
+float VarioKernels_Slope(
+        const float *buffer,
+        size_t bufferLength,
+        size_t startIndex,
+        size_t sampleCount,
+        float dt);
+
+/**
+ * MS5611 first and second order temperature compensation.
+ * @param[in] d1 Raw pressure conversion result.
+ * @param[in] d2 Raw temperature conversion result.
+ * @param[out] pP Compensated pressure in Pa.
+ * @param[out] pT Temperature in 1/100 degC.
+ */
+void VarioKernels_CompensateMs5611(
+        const struct Ms5611Calibration_s *calibration,
+        uint32_t d1,
+        uint32_t d2,
+        uint32_t *pP,
+        int32_t *pT);
+
+/**
+ * Format a LXWP0 sentence with checksum, without line ending.
+ * @brief Values are converted in fixed point and rounded to the printed
+ *        precision, the wind fields are left empty when invalid.
+ * @return Length of the sentence, the output is truncated to size - 1.
+ */
+size_t VarioKernels_FormatLxwp0(char *buffer, size_t size, const struct Lxwp0Data_s *data);
+
+/**
+ * Format a proprietary thermal core sentence with checksum:
+ * $PVTHC,<bearing deg>,<distance m>,<climb m/s>*CS
+ * @return Length of the sentence, the output is truncated to size - 1.
+ */
+size_t VarioKernels_FormatThermalCore(
+        char *buffer,
+        size_t size,
+        float bearing,
+        float distance,
+        float climb);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,273 @@
+/**
+ * @file WindEstimator.c
+ * @brief Wind estimation from the ground velocity while circling.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "WindEstimator.h"
+
+#include <math.h>
+#include <string.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define DEG_TO_RAD                                             (0.01745329252f)
+#define RAD_TO_DEG                                               (57.2957795f)
+#define MS_PER_DAY                                                 86400000UL
+
+#define WIND_SAMPLE_ANGLE                          (360.0f / WIND_SAMPLE_COUNT)
+#define WIND_MIN_GROUND_SPEED                                            (2.0f)
+#define WIND_MIN_TURN_RATE                                               (4.0f)
+#define WIND_MAX_STRAIGHT_TIME                                             3000
+#define WIND_MAX_FIX_INTERVAL                                              5000
+#define WIND_MIN_AIRSPEED                                                (4.0f)
+#define WIND_MAX_AIRSPEED                                               (30.0f)
+#define WIND_MAX_RELATIVE_RESIDUAL                                       (0.2f)
+#define WIND_SMOOTHING                                                  (0.25f)
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL CONSTANTS AND VARIABLES                                */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF LOCAL FUNCTIONS                                              */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Normalize angle difference into the (-180, 180] range.
+ */
+static float wrapAngle(float angle)
+{
+    while (180.0f < angle)
+        angle -= 360.0f;
+    while (angle <= -180.0f)
+        angle += 360.0f;
+    return angle;
+}
+
+static void addToSums(struct CircleFitSums_s *sums, const struct WindSample_s *s, float sign)
+{
+    float z = s->vx * s->vx + s->vy * s->vy;
+    sums->sx += sign * s->vx;
+    sums->sy += sign * s->vy;
+    sums->sxx += sign * s->vx * s->vx;
+    sums->syy += sign * s->vy * s->vy;
+    sums->sxy += sign * s->vx * s->vy;
+    sums->sz += sign * z;
+    sums->sxz += sign * s->vx * z;
+    sums->syz += sign * s->vy * z;
+}
+
+/**
+ * Rebuild the running sums from the ring to stop rounding errors of the
+ * add/remove updates from accumulating.
+ */
+static void recalculateSums(struct WindEstimator_s *estimator)
+{
+    size_t i;
+    memset(&estimator->sums, 0, sizeof(estimator->sums));
+    for (i = 0; i < estimator->count; i++)
+        addToSums(&estimator->sums, &estimator->samples[i], 1);
+}
+
+static void resetCircle(struct WindEstimator_s *estimator, float track)
+{
+    memset(&estimator->sums, 0, sizeof(estimator->sums));
+    estimator->count = 0;
+    estimator->index = 0;
+    estimator->turn = 0;
+    estimator->straightTime = 0;
+    estimator->sampleTrack = track;
+}
+
+static void addSample(struct WindEstimator_s *estimator, float groundSpeed, float track)
+{
+    struct WindSample_s *slot = &estimator->samples[estimator->index];
+
+    if (WIND_SAMPLE_COUNT == estimator->count)
+        addToSums(&estimator->sums, slot, -1);
+    else
+        estimator->count++;
+
+    slot->vx = groundSpeed * sinf(track * DEG_TO_RAD);
+    slot->vy = groundSpeed * cosf(track * DEG_TO_RAD);
+    addToSums(&estimator->sums, slot, 1);
+
+    if (WIND_SAMPLE_COUNT <= ++estimator->index) {
+        estimator->index = 0;
+        recalculateSums(estimator);
+    }
+}
+
+/**
+ * Solve the normal equations of the Kasa fit
+ * x^2 + y^2 + D*x + E*y + F = 0 with Cramer's rule.
+ * @return false if the samples are degenerate or the circle is implausible.
+ */
+static bool fitCircle(
+        const struct WindEstimator_s *estimator,
+        float *cx,
+        float *cy,
+        float *radius) {
+    const struct CircleFitSums_s *s = &estimator->sums;
+    float n = (float)estimator->count;
+
+    float a11 = s->sxx, a12 = s->sxy, a13 = s->sx;
+    float a22 = s->syy, a23 = s->sy;
+    float a33 = n;
+    float b1 = -s->sxz, b2 = -s->syz, b3 = -s->sz;
+
+    float c11 = a22 * a33 - a23 * a23;
+    float c12 = a13 * a23 - a12 * a33;
+    float c13 = a12 * a23 - a13 * a22;
+    float det = a11 * c11 + a12 * c12 + a13 * c13;
+    if (fabsf(det) < 1e-6f)
+        return false;
+
+    float c22 = a11 * a33 - a13 * a13;
+    float c23 = a12 * a13 - a11 * a23;
+    float c33 = a11 * a22 - a12 * a12;
+
+    float D = (c11 * b1 + c12 * b2 + c13 * b3) / det;
+    float E = (c12 * b1 + c22 * b2 + c23 * b3) / det;
+    float F = (c13 * b1 + c23 * b2 + c33 * b3) / det;
+
+    *cx = -D / 2;
+    *cy = -E / 2;
+    float r2 = (*cx) * (*cx) + (*cy) * (*cy) - F;
+    if (r2 <= 0)
+        return false;
+
+    *radius = sqrtf(r2);
+    if ((*radius < WIND_MIN_AIRSPEED) || (WIND_MAX_AIRSPEED < *radius))
+        return false;
+
+    float residual = 0;
+    size_t i;
+    for (i = 0; i < estimator->count; i++) {
+        float dx = estimator->samples[i].vx - *cx;
+        float dy = estimator->samples[i].vy - *cy;
+        float e = sqrtf(dx * dx + dy * dy) - *radius;
+        residual += e * e;
+    }
+
+    return sqrtf(residual / n) < WIND_MAX_RELATIVE_RESIDUAL * (*radius);
+}
+
+/**
+ * Track circling state.
+ * @return true if the glider is in a steady turn.
+ */
+static bool updateTurn(struct WindEstimator_s *estimator, uint32_t dt, float track)
+{
+    float dtrack = wrapAngle(track - estimator->lastTrack);
+    float rate = dtrack * 1000.0f / dt;
+
+    bool turning = (WIND_MIN_TURN_RATE <= fabsf(rate));
+    bool reversed = (0 != estimator->turn) && ((dtrack < 0) != (estimator->turn < 0));
+
+    if (turning && !reversed) {
+        estimator->turn += dtrack;
+        estimator->straightTime = 0;
+        return true;
+    }
+
+    estimator->straightTime += dt;
+    if (reversed || (WIND_MAX_STRAIGHT_TIME < estimator->straightTime))
+        resetCircle(estimator, track);
+
+    return false;
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+void WindEstimator_Init(struct WindEstimator_s *estimator)
+{
+    memset(estimator, 0, sizeof(*estimator));
+}
+
+bool WindEstimator_Update(
+        struct WindEstimator_s *estimator,
+        uint32_t time,
+        float groundSpeed,
+        float track) {
+    uint32_t dt = (time >= estimator->lastTime) ?
+            time - estimator->lastTime :
+            time + MS_PER_DAY - estimator->lastTime;
+
+    bool started = estimator->started;
+    estimator->started = true;
+    if (!started || (0 == dt) || (WIND_MAX_FIX_INTERVAL < dt) ||
+            (groundSpeed < WIND_MIN_GROUND_SPEED)) {
+        resetCircle(estimator, track);
+        estimator->lastTime = time;
+        estimator->lastTrack = track;
+        return false;
+    }
+
+    bool turning = updateTurn(estimator, dt, track);
+    estimator->lastTime = time;
+    estimator->lastTrack = track;
+    if (!turning)
+        return false;
+
+    if (0 == estimator->count ||
+            WIND_SAMPLE_ANGLE <= fabsf(wrapAngle(track - estimator->sampleTrack))) {
+        addSample(estimator, groundSpeed, track);
+        estimator->sampleTrack = track;
+    } else {
+        return false;
+    }
+
+    /* Wait until a full circle is covered. */
+    if ((WIND_SAMPLE_COUNT > estimator->count) || (fabsf(estimator->turn) < 360.0f))
+        return false;
+
+    float cx, cy, radius;
+    if (!fitCircle(estimator, &cx, &cy, &radius))
+        return false;
+
+    if (estimator->valid) {
+        estimator->windX += WIND_SMOOTHING * (cx - estimator->windX);
+        estimator->windY += WIND_SMOOTHING * (cy - estimator->windY);
+    } else {
+        estimator->windX = cx;
+        estimator->windY = cy;
+    }
+    estimator->airspeed = radius;
+    estimator->windTime = time;
+    estimator->valid = true;
+
+    return true;
+}
+
+float WindEstimator_GetSpeed(const struct WindEstimator_s *estimator)
+{
+    return sqrtf(estimator->windX * estimator->windX + estimator->windY * estimator->windY);
+}
+
+float WindEstimator_GetDirection(const struct WindEstimator_s *estimator)
+{
+    float direction = atan2f(-estimator->windX, -estimator->windY) * RAD_TO_DEG;
+    if (direction < 0)
+        direction += 360.0f;
+    return direction;
+}
+
+/******************************* END OF FILE ***********************************/
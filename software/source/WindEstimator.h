@@ -0,0 +1,108 @@
+/**
+ * @file WindEstimator.h
+ * @brief Wind estimation from the ground velocity while circling.
+ * @author Molnar Zoltan
+ */
+
+#ifndef WINDESTIMATOR_H
+#define WINDESTIMATOR_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define WIND_SAMPLE_COUNT                                                      24
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * Ground velocity in m/s, x points to east, y points to north.
+ */
+struct WindSample_s {
+    float vx;
+    float vy;
+};
+
+/**
+ * Running sums of the algebraic (Kasa) circle fit, z = vx^2 + vy^2.
+ */
+struct CircleFitSums_s {
+    float sx, sy;
+    float sxx, syy, sxy;
+    float sz, sxz, syz;
+};
+
+struct WindEstimator_s {
+    struct WindSample_s samples[WIND_SAMPLE_COUNT];
+    struct CircleFitSums_s sums;
+    size_t count;
+    size_t index;
+
+    uint32_t lastTime;
+    float lastTrack;
+    float sampleTrack;
+    float turn;
+    uint32_t straightTime;
+    bool started;
+
+    float windX;            /**< Air mass velocity to east in m/s. */
+    float windY;            /**< Air mass velocity to north in m/s. */
+    float airspeed;         /**< Radius of the last fitted circle. */
+    uint32_t windTime;      /**< Time of day of the last estimate in ms. */
+    bool valid;
+};
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL VARIABLES                                             */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Reset estimator, the wind estimate is cleared as well.
+ */
+void WindEstimator_Init(struct WindEstimator_s *estimator);
+
+/**
+ * Process a GPS velocity fix.
+ * @brief While circling the ground velocity vectors lie on a circle whose
+ *        centre is the wind vector. A new sample is stored every
+ *        360 / WIND_SAMPLE_COUNT degrees of turn, and once a full circle is
+ *        covered the circle is fitted on every new sample. Running time is
+ *        constant apart from a periodic re-summation of the sample ring.
+ * @param[in] time UTC time of day of the fix in ms.
+ * @param[in] groundSpeed Speed over ground in m/s.
+ * @param[in] track True track over ground in degrees.
+ * @return true if the wind estimate was updated.
+ */
+bool WindEstimator_Update(
+        struct WindEstimator_s *estimator,
+        uint32_t time,
+        float groundSpeed,
+        float track);
+
+/**
+ * Get wind speed in m/s.
+ */
+float WindEstimator_GetSpeed(const struct WindEstimator_s *estimator);
+
+/**
+ * Get the direction the wind blows from in degrees, 0 is north.
+ */
+float WindEstimator_GetDirection(const struct WindEstimator_s *estimator);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
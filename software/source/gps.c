@@ -0,0 +1,271 @@
+/**
+ * @file gps.c
+ * @brief u-blox GPS receiver driver interface.
+ * @author Molnar Zoltan
+ */
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "gps.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define UBX_SYNC_CHAR_1                                                      0xb5
+#define UBX_SYNC_CHAR_2                                                      0x62
+#define UBX_ACK_LENGTH                                                         10
+#define UBX_NMEA_CLASS                                                       0xf0
+#define UBX_UART1_PORT_ID                                                       1
+#define UBX_UART_MODE_8N1                                             0x000008d0
+#define UBX_PROTO_UBX                                                      0x0001
+#define UBX_PROTO_NMEA                                                     0x0002
+
+#define GPS_ACK_TIMEOUT                                                       500
+#define GPS_RETRY_COUNT                                                         3
+#define GPS_BAUDRATE_SWITCH_DELAY                                             100
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+#define LOW_BYTE(x)                                          ((uint8_t)((x) & 0xff))
+#define HIGH_BYTE(x)                                  ((uint8_t)(((x) >> 8) & 0xff))
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+/**
+ * UBX message classes and identifiers used by the driver.
+ * @{
+ */
+typedef enum ubx_class {
+    UBX_CLASS_ACK = 0x05,   /**< Acknowledge messages. */
+    UBX_CLASS_CFG = 0x06    /**< Configuration messages. */
+} ubx_class_t;
+
+typedef enum ubx_id {
+    UBX_ID_ACK_NAK  = 0x00, /**< Message not acknowledged. */
+    UBX_ID_ACK_ACK  = 0x01, /**< Message acknowledged. */
+    UBX_ID_CFG_PRT  = 0x00, /**< Port configuration. */
+    UBX_ID_CFG_MSG  = 0x01, /**< Message output rate. */
+    UBX_ID_CFG_RATE = 0x08  /**< Navigation and measurement rate. */
+} ubx_id_t;
+/** @} */
+
+/**
+ * Standard NMEA sentence identifiers in the UBX_NMEA_CLASS.
+ */
+typedef enum ubx_nmea_id {
+    UBX_NMEA_GGA = 0x00,
+    UBX_NMEA_GLL = 0x01,
+    UBX_NMEA_GSA = 0x02,
+    UBX_NMEA_GSV = 0x03,
+    UBX_NMEA_RMC = 0x04,
+    UBX_NMEA_VTG = 0x05
+} ubx_nmea_id_t;
+
+/*******************************************************************************/
+/* DEFINITIONS OF GLOBAL CONSTANTS AND VARIABLES                               */
+/*******************************************************************************/
+static const SerialConfig gpsDefaultConfig = {GPS_DEFAULT_BAUDRATE,0,0,0};
+static const SerialConfig gpsConfig = {GPS_BAUDRATE,0,0,0};
+
+/**
+ * Sentences XCSoar does not use. GGA and RMC are left enabled.
+ */
+static const ubx_nmea_id_t disabledSentences[] = {
+    UBX_NMEA_GLL,
+    UBX_NMEA_GSA,
+    UBX_NMEA_GSV,
+    UBX_NMEA_VTG
+};
+
+/*******************************************************************************/
+/* DEFINITION OF LOCAL FUNCTIONS                                               */
+/*******************************************************************************/
+/**
+ * Calculate the 8-bit Fletcher checksum of a UBX frame.
+ * @param[in] pdata Pointer to the class byte of the frame.
+ * @param[in] length Number of bytes from class byte to the end of payload.
+ * @return Checksum in CK_A | CK_B << 8 format.
+ */
+static uint16_t ubxChecksum(const uint8_t *pdata, size_t length)
+{
+    uint8_t ckA = 0;
+    uint8_t ckB = 0;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        ckA += pdata[i];
+        ckB += ckA;
+    }
+
+    return ((uint16_t)ckB << 8) | ckA;
+}
+
+/**
+ * Send UBX message to the receiver.
+ */
+static void gpsSendUbx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t length)
+{
+    uint8_t header[6] = {
+        UBX_SYNC_CHAR_1,
+        UBX_SYNC_CHAR_2,
+        cls,
+        id,
+        LOW_BYTE(length),
+        HIGH_BYTE(length)
+    };
+
+    uint16_t crc = ubxChecksum(header + 2, sizeof(header) - 2);
+    uint8_t ckA = LOW_BYTE(crc);
+    uint8_t ckB = HIGH_BYTE(crc);
+    size_t i;
+    for (i = 0; i < length; i++) {
+        ckA += payload[i];
+        ckB += ckA;
+    }
+    uint8_t trailer[2] = {ckA, ckB};
+
+    chnWrite(GPS_SERIAL, header, sizeof(header));
+    chnWrite(GPS_SERIAL, payload, length);
+    chnWrite(GPS_SERIAL, trailer, sizeof(trailer));
+}
+
+/**
+ * Wait for the acknowledge of a configuration message.
+ * @brief NMEA traffic received in the meantime is discarded.
+ * @return true if ACK-ACK arrived in time, false on ACK-NAK or timeout.
+ */
+static bool gpsWaitForAck(uint8_t cls, uint8_t id)
+{
+    uint8_t frame[UBX_ACK_LENGTH];
+    size_t index = 0;
+    systime_t start = chVTGetSystemTime();
+
+    while ((systime_t)(chVTGetSystemTime() - start) < MS2ST(GPS_ACK_TIMEOUT)) {
+        msg_t c = chnGetTimeout(GPS_SERIAL, MS2ST(10));
+        if (STM_TIMEOUT == c)
+            continue;
+
+        if ((1 == index) && (UBX_SYNC_CHAR_2 != c))
+            index = 0;
+
+        if ((0 == index) && (UBX_SYNC_CHAR_1 != c))
+            continue;
+
+        frame[index++] = (uint8_t)c;
+        if (UBX_ACK_LENGTH != index)
+            continue;
+
+        index = 0;
+        uint16_t crc = ubxChecksum(frame + 2, UBX_ACK_LENGTH - 4);
+        if ((UBX_CLASS_ACK == frame[2]) &&
+            (2 == frame[4]) && (0 == frame[5]) &&
+            (cls == frame[6]) && (id == frame[7]) &&
+            (LOW_BYTE(crc) == frame[8]) && (HIGH_BYTE(crc) == frame[9]))
+            return (UBX_ID_ACK_ACK == frame[3]);
+    }
+
+    return false;
+}
+
+/**
+ * Send configuration message and retry until it is acknowledged.
+ */
+static bool gpsConfigure(uint8_t id, const uint8_t *payload, uint16_t length)
+{
+    int i;
+    for (i = 0; i < GPS_RETRY_COUNT; i++) {
+        gpsSendUbx(UBX_CLASS_CFG, id, payload, length);
+        if (gpsWaitForAck(UBX_CLASS_CFG, id))
+            return true;
+    }
+
+    return false;
+}
+
+static bool gpsDisableSentence(ubx_nmea_id_t sentence)
+{
+    uint8_t payload[3] = {UBX_NMEA_CLASS, sentence, 0};
+    return gpsConfigure(UBX_ID_CFG_MSG, payload, sizeof(payload));
+}
+
+static bool gpsSetNavigationRate(uint16_t period)
+{
+    uint8_t payload[6] = {
+        LOW_BYTE(period), HIGH_BYTE(period),    /* Measurement period in ms. */
+        1, 0,                                   /* One solution per measurement. */
+        1, 0                                    /* Align to GPS time. */
+    };
+    return gpsConfigure(UBX_ID_CFG_RATE, payload, sizeof(payload));
+}
+
+/**
+ * Switch the UART of the receiver to the new baud rate.
+ * @brief The acknowledge may be sent on either baud rate, so it is not
+ *        waited for. The result is checked by the caller at the new speed.
+ */
+static void gpsSetBaudRate(uint32_t baudrate)
+{
+    uint32_t mode = UBX_UART_MODE_8N1;
+    uint16_t inProto = UBX_PROTO_UBX | UBX_PROTO_NMEA;
+    /* UBX output stays on for the acknowledges at the new baud rate. */
+    uint16_t outProto = UBX_PROTO_UBX | UBX_PROTO_NMEA;
+    uint8_t payload[20] = {
+        UBX_UART1_PORT_ID, 0,
+        0, 0,
+        LOW_BYTE(mode), HIGH_BYTE(mode), LOW_BYTE(mode >> 16), HIGH_BYTE(mode >> 16),
+        LOW_BYTE(baudrate), HIGH_BYTE(baudrate),
+        LOW_BYTE(baudrate >> 16), HIGH_BYTE(baudrate >> 16),
+        LOW_BYTE(inProto), HIGH_BYTE(inProto),
+        LOW_BYTE(outProto), HIGH_BYTE(outProto),
+        0, 0,
+        0, 0
+    };
+
+    gpsSendUbx(UBX_CLASS_CFG, UBX_ID_CFG_PRT, payload, sizeof(payload));
+    chThdSleepMilliseconds(GPS_BAUDRATE_SWITCH_DELAY);
+}
+
+static void gpsRestartSerial(const SerialConfig *config)
+{
+    sdStop(GPS_SERIAL);
+    sdStart(GPS_SERIAL, config);
+}
+
+/*******************************************************************************/
+/* DEFINITION OF GLOBAL FUNCTIONS                                              */
+/*******************************************************************************/
+bool GPS_Start(void)
+{
+    sdStart(GPS_SERIAL, &gpsDefaultConfig);
+
+    size_t i;
+    for (i = 0; i < sizeof(disabledSentences)/sizeof(disabledSentences[0]); i++) {
+        if (!gpsDisableSentence(disabledSentences[i]))
+            return false;
+    }
+
+    if (!gpsSetNavigationRate(GPS_NAVIGATION_PERIOD_MS))
+        return false;
+
+    gpsSetBaudRate(GPS_BAUDRATE);
+    gpsRestartSerial(&gpsConfig);
+
+    /* Check the link on the new baud rate. */
+    if (gpsSetNavigationRate(GPS_NAVIGATION_PERIOD_MS))
+        return true;
+
+    /* Receiver did not follow, fall back to the default baud rate. */
+    gpsRestartSerial(&gpsDefaultConfig);
+    if (!gpsSetNavigationRate(GPS_NAVIGATION_PERIOD_MS)) {
+        gpsRestartSerial(&gpsConfig);
+        gpsSetBaudRate(GPS_DEFAULT_BAUDRATE);
+        gpsRestartSerial(&gpsDefaultConfig);
+    }
+
+    return false;
+}
+
+/******************************* END OF FILE ***********************************/
@@ -0,0 +1,52 @@
+/**
+ * @file gps.h
+ * @brief u-blox GPS receiver driver interface.
+ * @author Molnar Zoltan
+ */
+
+#ifndef GPS_H
+#define GPS_H
+
+/*******************************************************************************/
+/* INCLUDES                                                                    */
+/*******************************************************************************/
+#include "ch.h"
+#include "hal.h"
+
+/*******************************************************************************/
+/* DEFINED CONSTANTS                                                           */
+/*******************************************************************************/
+#define GPS_SERIAL                                                           &SD2
+#define GPS_DEFAULT_BAUDRATE                                                 9600
+#define GPS_BAUDRATE                                                        38400
+#define GPS_NAVIGATION_PERIOD_MS                                              200
+
+/*******************************************************************************/
+/* MACRO DEFINITIONS                                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* TYPE DEFINITIONS                                                            */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATIONS OF GLOBAL VARIABLES                                           */
+/*******************************************************************************/
+
+/*******************************************************************************/
+/* DECLARATION OF GLOBAL FUNCTIONS                                             */
+/*******************************************************************************/
+/**
+ * Start GPS serial interface and configure the receiver.
+ * @brief Disable the NMEA sentences XCSoar does not use, set the navigation
+ *        rate and switch the receiver to GPS_BAUDRATE. Every command must be
+ *        acknowledged, otherwise the interface is left at (or returned to)
+ *        GPS_DEFAULT_BAUDRATE. The sentences disabled before the failure
+ *        stay disabled, the rest of the output is the receiver's default.
+ * @return true if the receiver accepted the complete configuration.
+ */
+bool GPS_Start(void);
+
+#endif
+
+/******************************* END OF FILE ***********************************/
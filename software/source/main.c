@@ -17,28 +17,53 @@
 #include "ch.h"
 #include "hal.h"
 #include "BeepControlThread.h"
+#include "ConfigStore.h"
+#include "CycleProbe.h"
+#include "DiagShell.h"
+#include "LatencyBench.h"
+#include "PipelineMonitor.h"
 #include "PressureReaderThread.h"
 #include "SignalProcessorThread.h"
 #include "SimulatorThread.h"
+#include "ThreadStats.h"
+#include "TraceRing.h"
 #include "SerialHandlerThread.h"
 #include "ButtonHandlerThread.h"
 #include "NmeaGeneratorThread.h"
+#include "GpsProcessorThread.h"
 
-#undef USE_SIMULATED_DATA
+/*
+ * USE_SIMULATED_DATA replaces the pressure reader with the scenario
+ * generator of SimulatorThread.c, see USE_SIMULATED_DATA in the Makefile.
+ */
 
 /*
  * Thread working area definitions.
  */
 static THD_WORKING_AREA(waBeepControl, 1024);
 #ifndef USE_SIMULATED_DATA
+#if LATENCY_BENCH
+/* The stimulus offsets every sample with two soft float powf calls. */
+static THD_WORKING_AREA(waPressureReader, 512);
+#else
 static THD_WORKING_AREA(waPressureReader, 128);
+#endif
+#else
+static THD_WORKING_AREA(waSimulator, 256);
+#endif
 static THD_WORKING_AREA(waSignalProcessor, 2048);
+#if TRACE_RING
+/* The trace dump writes its frames from the serial handler. */
+static THD_WORKING_AREA(waSerialHandler, 384);
 #else
-static THD_WORKING_AREA(waSimulator, 128);
+static THD_WORKING_AREA(waSerialHandler, 256);
 #endif
-static THD_WORKING_AREA(waSerialHandler, 128);
 static THD_WORKING_AREA(waButtonHandler, 1024);
 static THD_WORKING_AREA(waNmeaGenerator, 1024);
+static THD_WORKING_AREA(waGpsProcessor, 1024);
+#if DIAG_SHELL
+static THD_WORKING_AREA(waDiagShell, 1024);
+#endif
 
 /*
  * Thread references.
@@ -46,13 +71,17 @@ static THD_WORKING_AREA(waNmeaGenerator, 1024);
 thread_t *pBeepControlThread;
 #ifndef USE_SIMULATED_DATA
 thread_t *pPressureReaderThread;
-thread_t *pSignalProcessorThread;
 #else
 thread_t *pSimulatorThread;
 #endif
+thread_t *pSignalProcessorThread;
 thread_t *pSerialHandlerThread;
 thread_t *pButtonHandlerThread;
 thread_t *pNmeaGeneratorThread;
+thread_t *pGpsProcessorThread;
+#if DIAG_SHELL
+thread_t *pDiagShellThread;
+#endif
 
 /**
  * Watchdog configuration.
@@ -76,6 +105,24 @@ int main(void) {
      */
     halInit();
     chSysInit();
+#if CYCLE_PROBES
+    CycleProbe_Init();
+#endif
+#if THREAD_STATS
+    ThreadStats_Init();
+#endif
+
+    /*
+     * Load the persistent settings before any thread needs them.
+     */
+    ConfigStore_Init();
+
+#ifdef VARIO_SIM
+    /*
+     * Start the replay feeders of the simulated sensors, see sim/SimHal.c.
+     */
+    SimHal_Start();
+#endif
 
     /*
      * Wait 2 seconds here to prevent false startups caused by
@@ -95,21 +142,21 @@ int main(void) {
             NORMALPRIO + 5,
             PressureReaderThread,
             NULL);
-
-    pSignalProcessorThread = chThdCreateStatic (
-            waSignalProcessor,
-            sizeof (waSignalProcessor),
-            NORMALPRIO + 4,
-            SignalProcessorThread,
-            NULL);
 #else
     pSimulatorThread = chThdCreateStatic (
             waSimulator,
             sizeof(waSimulator),
-            NORMALPRIO + 4,
+            NORMALPRIO + 5,
             SimulatorThread,
             NULL);
 #endif
+
+    pSignalProcessorThread = chThdCreateStatic (
+            waSignalProcessor,
+            sizeof (waSignalProcessor),
+            NORMALPRIO + 4,
+            SignalProcessorThread,
+            NULL);
 #if 1
     pSerialHandlerThread = chThdCreateStatic (
             waSerialHandler,
@@ -134,6 +181,14 @@ int main(void) {
             NmeaGeneratorThread,
             NULL);
 #endif
+#if 1
+    pGpsProcessorThread = chThdCreateStatic (
+            waGpsProcessor,
+            sizeof(waGpsProcessor),
+            NORMALPRIO,
+            GpsProcessorThread,
+            NULL);
+#endif
 #if 1
     pButtonHandlerThread = chThdCreateStatic (
             waButtonHandler,
@@ -142,18 +197,30 @@ int main(void) {
             ButtonHandlerThread,
             NULL);
 #endif
+#if DIAG_SHELL
+    pDiagShellThread = chThdCreateStatic (
+            waDiagShell,
+            sizeof (waDiagShell),
+            DIAG_SHELL_PRIORITY,
+            DiagShellThread,
+            NULL);
+#endif
 
+    PipelineMonitor_Init();
     wdgStart(&WDGD1, &watchDogConfig);
 
     /*
-     * Blink heartbeat LED.
+     * Blink heartbeat LED, the watchdog is fed only while the stages of
+     * the audio vario meet their deadlines.
      */
     while (true) {
         palClearPad(GPIOB, GPIOB_LED);
         chThdSleepMilliseconds(500);
-        wdgReset(&WDGD1);
+        if (PipelineMonitor_Check())
+            wdgReset(&WDGD1);
         palSetPad(GPIOB, GPIOB_LED);
         chThdSleepMilliseconds(500);
-        wdgReset(&WDGD1);
+        if (PipelineMonitor_Check())
+            wdgReset(&WDGD1);
     }
 }
@@ -8,6 +8,7 @@
 /* INCLUDES                                                                    */
 /*******************************************************************************/
 #include "ms5611.h"
+#include "VarioKernels.h"
 #include "hal.h"
 
 /*******************************************************************************/
@@ -89,15 +90,8 @@ const SPIConfig ms5611_spi_cfg = {
 
 /**
  * Calibration constants for pressure calculation.
- * @{
  */
-static uint16_t C1 = 0;  /**< Pressure sensitivity | SENS T1 */
-static uint16_t C2 = 0;  /**< Pressure offset | OFF T1 */
-static uint16_t C3 = 0;  /**< Temperature coefficient of pressure sensitivity | TCS */
-static uint16_t C4 = 0;  /**< Temperature coefficient of pressure offset | TCO */
-static uint16_t C5 = 0;  /**< Reference temperature | T REF */
-static uint16_t C6 = 0;  /**< Temperature coefficient of the temperature | TEMPSENS */
-/** @} */
+static struct Ms5611Calibration_s calibration;
 
 /*******************************************************************************/
 /* DEFINITION OF LOCAL FUNCTIONS                                               */
@@ -191,51 +185,24 @@ void MS5611_Start (void)
 {
     ms5611Reset();
     chThdSleepMilliseconds(250);
-    C1 = ms5611ReadRegister(MS5611_PROM_C1);
-    C2 = ms5611ReadRegister(MS5611_PROM_C2);
-    C3 = ms5611ReadRegister(MS5611_PROM_C3);
-    C4 = ms5611ReadRegister(MS5611_PROM_C4);
-    C5 = ms5611ReadRegister(MS5611_PROM_C5);
-    C6 = ms5611ReadRegister(MS5611_PROM_C6);
+    calibration.c1 = ms5611ReadRegister(MS5611_PROM_C1);
+    calibration.c2 = ms5611ReadRegister(MS5611_PROM_C2);
+    calibration.c3 = ms5611ReadRegister(MS5611_PROM_C3);
+    calibration.c4 = ms5611ReadRegister(MS5611_PROM_C4);
+    calibration.c5 = ms5611ReadRegister(MS5611_PROM_C5);
+    calibration.c6 = ms5611ReadRegister(MS5611_PROM_C6);
 }
 
 void MS5611_Measure(uint32_t *pP, int32_t *pT)
 {
     uint32_t D1 = ms5611Convert(MS5611_PRESSURE);
     uint32_t D2 = ms5611Convert(MS5611_TEMP);
-    int64_t dT = (int64_t)D2 - ((uint64_t)C5 << 8);
-    int64_t TEMP = 2000 + ((dT * (int64_t)C6) >> 23);
-    int64_t OFF = ((uint64_t)C2 << 16) + (((int64_t)C4 * dT) >> 7);
-    int64_t SENS = ((int64_t)C1 << 15) + ((dT * (int64_t)(C3) >> 8));
-    int64_t T2 = 0;;
-    int64_t OFF2 = 0;
-    int64_t SENS2 = 0;
-
-    /* Second order temperature compensation. */
-    if (TEMP < 2000) {
-        T2 = ((dT * dT) >> 31);
-        OFF2 = (5 * (TEMP - 2000) * (TEMP - 2000)) >> 1;
-        SENS2 = (5 * (TEMP - 2000) * (TEMP - 2000)) >> 2;
-
-        /* Very low temperature. */
-        if( TEMP < (-15)) {
-            OFF2 = OFF2 + (7 * (TEMP + 1500) * (TEMP + 1500));
-            SENS2 = SENS2 + ((11 * (TEMP + 1500) * (TEMP + 1500)) >> 2);
-        }
-    }
-    else {
-        T2 = 0;
-        OFF2 = 0;
-        SENS2 = 0;
-    }
-
-    TEMP -= T2;
-    OFF -= OFF2;
-    SENS -= SENS2;
+    VarioKernels_CompensateMs5611(&calibration, D1, D2, pP, pT);
+}
 
-    /* Calculate temperature and temperature compensated pressure */
-    *pT = (int32_t)TEMP;
-    *pP = (uint32_t)(((((int64_t)D1 * SENS) >> 21) - OFF) >> 15);
+const struct Ms5611Calibration_s *MS5611_GetCalibration(void)
+{
+    return &calibration;
 }
 
 /******************************* END OF FILE ***********************************/
@@ -10,6 +10,7 @@
 /*******************************************************************************/
 /* INCLUDES                                                                    */
 /*******************************************************************************/
+#include "VarioKernels.h"
 #include "ch.h"
 #include "hal.h"
 
@@ -53,6 +54,11 @@ void MS5611_Start(void);
  */
 void MS5611_Measure(uint32_t *pP, int32_t *pT);
 
+/**
+ * Calibration constants read from the PROM by MS5611_Start().
+ */
+const struct Ms5611Calibration_s *MS5611_GetCalibration(void);
+
 #endif
 
 /******************************* END OF FILE ***********************************/